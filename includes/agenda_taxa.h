@@ -0,0 +1,152 @@
+#ifndef _AGENDA_TAXA_H
+#define _AGENDA_TAXA_H
+
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+// Interface para todas as agendas de taxa de aprendizagem
+//
+// 'epoca' é o progresso do treino medido em épocas, começando em 0 e
+// fracionário dentro de uma época (2.5 = metade da terceira época), então a
+// taxa pode mudar a cada passo do otimizador.
+class AgendaTaxa
+{
+public:
+    virtual ~AgendaTaxa() = default;
+
+    // Retorna a taxa a ser usada, a partir da taxa base passada ao train
+    virtual double taxa(double taxa_base, double epoca) const = 0;
+
+    virtual std::unique_ptr<AgendaTaxa> clone() const = 0;
+};
+
+// --- TAXA CONSTANTE (comportamento padrão) ---
+class TaxaConstante : public AgendaTaxa
+{
+public:
+    double taxa(double taxa_base, double) const override { return taxa_base; }
+
+    std::unique_ptr<AgendaTaxa> clone() const override
+    {
+        return std::make_unique<TaxaConstante>(*this);
+    }
+}; // TaxaConstante
+
+// --- DECAIMENTO EM DEGRAUS ---
+// Multiplica a taxa por 'fator' a cada 'intervalo' épocas
+class DecaimentoDegraus : public AgendaTaxa
+{
+public:
+    DecaimentoDegraus(double intervalo, double fator) : m_intervalo(intervalo), m_fator(fator) {}
+
+    double taxa(double taxa_base, double epoca) const override
+    {
+        return taxa_base * std::pow(m_fator, std::floor(epoca / m_intervalo));
+    }
+
+    std::unique_ptr<AgendaTaxa> clone() const override
+    {
+        return std::make_unique<DecaimentoDegraus>(*this);
+    }
+
+private:
+    double m_intervalo;
+    double m_fator;
+}; // DecaimentoDegraus
+
+// --- COSSENO ---
+// Desce de taxa_base até taxa_minima em meio período de cosseno ao longo
+// de 'epocas_totais' épocas, e fica na mínima depois disso
+class DecaimentoCosseno : public AgendaTaxa
+{
+public:
+    DecaimentoCosseno(double epocas_totais, double taxa_minima = 0.0)
+        : m_epocas_totais(epocas_totais), m_taxa_minima(taxa_minima) {}
+
+    double taxa(double taxa_base, double epoca) const override
+    {
+        double progresso = std::min(epoca / m_epocas_totais, 1.0);
+        return m_taxa_minima + 0.5 * (taxa_base - m_taxa_minima) * (1.0 + std::cos(M_PI * progresso));
+    }
+
+    std::unique_ptr<AgendaTaxa> clone() const override
+    {
+        return std::make_unique<DecaimentoCosseno>(*this);
+    }
+
+private:
+    double m_epocas_totais;
+    double m_taxa_minima;
+}; // DecaimentoCosseno
+
+// --- UM CICLO (one-cycle) ---
+// Sobe de taxa_base/fator_inicial até taxa_base durante 'fracao_subida' do
+// treino e depois desce em cosseno até taxa_base/fator_final
+class UmCiclo : public AgendaTaxa
+{
+public:
+    UmCiclo(double epocas_totais, double fracao_subida = 0.3,
+            double fator_inicial = 25.0, double fator_final = 1e4)
+        : m_epocas_totais(epocas_totais), m_fracao_subida(fracao_subida),
+          m_fator_inicial(fator_inicial), m_fator_final(fator_final) {}
+
+    double taxa(double taxa_base, double epoca) const override
+    {
+        double progresso = std::min(epoca / m_epocas_totais, 1.0);
+        double inicial = taxa_base / m_fator_inicial;
+        double final_ = taxa_base / m_fator_final;
+
+        if (progresso < m_fracao_subida)
+        {
+            double p = progresso / m_fracao_subida;
+            return inicial + 0.5 * (taxa_base - inicial) * (1.0 - std::cos(M_PI * p));
+        }
+
+        double p = (progresso - m_fracao_subida) / (1.0 - m_fracao_subida);
+        return final_ + 0.5 * (taxa_base - final_) * (1.0 + std::cos(M_PI * p));
+    }
+
+    std::unique_ptr<AgendaTaxa> clone() const override
+    {
+        return std::make_unique<UmCiclo>(*this);
+    }
+
+private:
+    double m_epocas_totais;
+    double m_fracao_subida;
+    double m_fator_inicial;
+    double m_fator_final;
+}; // UmCiclo
+
+// --- AQUECIMENTO (warmup) ---
+// Sobe linearmente de 0 até a taxa da agenda interna durante 'epocas_aquecimento'
+// épocas; depois disso, segue a agenda interna (deslocada pelo aquecimento)
+class Aquecimento : public AgendaTaxa
+{
+public:
+    Aquecimento(double epocas_aquecimento, std::unique_ptr<AgendaTaxa> depois = std::make_unique<TaxaConstante>())
+        : m_epocas_aquecimento(epocas_aquecimento), m_depois(std::move(depois)) {}
+
+    Aquecimento(const Aquecimento &other)
+        : m_epocas_aquecimento(other.m_epocas_aquecimento), m_depois(other.m_depois->clone()) {}
+
+    double taxa(double taxa_base, double epoca) const override
+    {
+        if (epoca < m_epocas_aquecimento)
+            return m_depois->taxa(taxa_base, 0.0) * (epoca + 1e-3) / m_epocas_aquecimento;
+
+        return m_depois->taxa(taxa_base, epoca - m_epocas_aquecimento);
+    }
+
+    std::unique_ptr<AgendaTaxa> clone() const override
+    {
+        return std::make_unique<Aquecimento>(*this);
+    }
+
+private:
+    double m_epocas_aquecimento;
+    std::unique_ptr<AgendaTaxa> m_depois;
+}; // Aquecimento
+
+#endif // _AGENDA_TAXA_H
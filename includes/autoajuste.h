@@ -0,0 +1,97 @@
+#ifndef _AUTOAJUSTE_H
+#define _AUTOAJUSTE_H
+
+#include "execucao.h"
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace nn
+{
+  using Matriz = std::vector<std::vector<double>>;
+  using Vetor = std::vector<double>;
+
+  /*
+  Kernels do produto matriz-vetor do forward (pesos em double):
+  POR_NEURONIO - cada neurônio de destino percorre a sua coluna de pesos
+                 (m_pesos[i][k][j] com k variando, um vetor diferente a cada
+                 passo). É o melhor para camadas minúsculas
+  POR_LINHA    - percorre as linhas de pesos em ordem, somando x[k] * linha
+                 num bloco de neurônios de destino (laço contínuo,
+                 vetorizado pelo compilador). Entradas zeradas são puladas
+  */
+  enum class KernelForward
+  {
+    POR_NEURONIO,
+    POR_LINHA
+  };
+
+  // Como calcular uma camada
+  struct PlanoCamada
+  {
+    KernelForward kernel = KernelForward::POR_NEURONIO;
+
+    // Neurônios de destino por bloco no POR_LINHA (0 = todos de uma vez)
+    size_t bloco = 0;
+
+    // Blocos paralelos (0 = decidido pelo grão mínimo do contexto)
+    size_t n_threads = 0;
+  };
+
+  /*
+  y = x * pesos + biases, como Sequencial::propagar_camada calcula os logits.
+
+  Todos os planos somam na mesma ordem (k crescente, bias no fim), então o
+  plano muda só o tempo, não o resultado.
+
+  Com 'ativacao' (uma func::funcao_vetor), cada bloco de y também é
+  ativado em 'ativado' assim que fica pronto (fusão da ativação).
+  */
+  void produto_camada(const PlanoCamada &plano, const Matriz &pesos, const Vetor &biases, const Vetor &x,
+                      Vetor &y, ContextoExecucao &contexto,
+                      void (*ativacao)(const double *, double *, size_t) = nullptr, double *ativado = nullptr);
+
+  /*
+  Autoajuste: escolhe o plano mais rápido para cada formato de camada
+  (entradas x saídas) nesta máquina.
+
+  Na primeira vez que um formato é pedido, os candidatos (kernel, tamanho
+  do bloco e número de threads, até o número de threads do contexto) são
+  medidos com pesos aleatórios, o que leva alguns milissegundos, e o
+  vencedor é gravado no arquivo de cache. Nas execuções seguintes, o plano
+  vem do cache, sem custo de medição.
+
+  O cache é indexado pelo modelo da CPU, pelo número de threads do contexto
+  e pelo formato da camada, então pode ser compartilhado entre máquinas
+  (ex.: num diretório home em rede). Fica em $NN_AUTOAJUSTE_ARQUIVO, se
+  definida, ou em $XDG_CACHE_HOME/rede_neural/autoajuste.txt (padrão
+  ~/.cache/...). Se não puder ser lido ou escrito, o autoajuste ainda
+  funciona, só mede de novo a cada execução.
+
+  Ex.:
+    rede.set_autoajuste(true); // ver Sequencial::set_autoajuste
+  */
+  namespace autoajuste
+  {
+    // Plano do cache ou, se ainda não houver, medido e gravado
+    PlanoCamada plano(size_t entradas, size_t saidas, const ContextoExecucao &contexto);
+
+    // Sempre mede (sem consultar nem gravar o cache)
+    PlanoCamada medir(size_t entradas, size_t saidas, const ContextoExecucao &contexto);
+
+    // "model name" de /proc/cpuinfo (ou "desconhecida")
+    std::string modelo_cpu();
+
+    // Arquivo de cache ("" se não houver onde gravar)
+    std::string caminho_cache();
+
+    // Esquece os planos já lidos nesta execução (o arquivo não é alterado)
+    void esquecer();
+
+    const char *nome_kernel(KernelForward kernel);
+  } // namespace autoajuste
+
+} // namespace nn
+
+#endif // _AUTOAJUSTE_H
@@ -5,83 +5,183 @@
 #include <string>
 #include <cmath>
 #include <numeric>
+#include <algorithm>
 #include <memory>
+#include <utility>
+#include <type_traits>
 
-namespace 
+#include "matematica.h"
+
+namespace
 {
     using Vetor = std::vector<double>;
 }
 
+// Visão (sem cópia) de um lote de amostras guardadas lado a lado na memória:
+// a amostra i ocupa dados[i * largura] até dados[(i + 1) * largura - 1]
+template <class T>
+struct VisaoLote
+{
+    T *dados;
+    size_t n_amostras;
+    size_t largura;
+
+    VisaoLote(T *dados, size_t n_amostras, size_t largura)
+        : dados(dados), n_amostras(n_amostras), largura(largura) {}
+
+    // Uma única amostra (ex.: um Vetor)
+    template <class V, class = decltype(std::declval<V &>().data())>
+    VisaoLote(V &vetor) : dados(vetor.data()), n_amostras(1), largura(vetor.size()) {}
+
+    // Visão de escrita -> visão de leitura
+    template <class U, class = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+    VisaoLote(const VisaoLote<U> &outra) : dados(outra.dados), n_amostras(outra.n_amostras), largura(outra.largura) {}
+
+    T *amostra(size_t i) const { return dados + i * largura; }
+};
+
+using LoteValores = VisaoLote<double>;
+using LoteConstante = VisaoLote<const double>;
+
 // Interface para todas as combinações de Ativação/Loss da camada de saída
+//
+// Todas as operações trabalham no lugar, sobre um lote inteiro por chamada
+// virtual. Os métodos por amostra (forward, backward, calcular_loss) são
+// apenas lotes de uma amostra.
 class CamadaSaida
 {
 public:
     virtual ~CamadaSaida() = default;
 
     // Calcula a saída ativada apartir dos logits (somas ponderadas)
-    virtual Vetor forward(const Vetor &logits) = 0;
+    virtual void forward_lote(LoteConstante logits, LoteValores saida) = 0;
 
     // Calcula o gradiente inicial (delta) para o backpropagation
-    virtual Vetor backward(const Vetor &saida_ativada, const Vetor &saida_esperada) = 0;
+    virtual void backward_lote(LoteConstante saida_ativada, LoteConstante saida_esperada, LoteValores delta) = 0;
+
+    // Soma dos losses das amostras do lote
+    virtual double calcular_loss_lote(LoteConstante saida_ativada, LoteConstante saida_esperada) = 0;
 
-    // Calcula o valor de loss para monitoramento
-    virtual double calcular_loss(const Vetor &saida_ativada, const Vetor &saida_esperada) = 0;
+    /*
+    Treino: ativa os logits, calcula o delta e o loss numa única passada
+    por amostra. Retorna a soma dos losses do lote.
+    */
+    virtual double forward_backward_lote(LoteConstante logits, LoteConstante saida_esperada,
+                                         LoteValores saida, LoteValores delta) = 0;
 
     virtual std::string get_tipo() const = 0;
 
     virtual std::unique_ptr<CamadaSaida> clone() const = 0;
-};
 
-// --- ESTRATÉGIA PARA CLASSIFICAÇÃO ---
-class SoftmaxCrossEntropy : public CamadaSaida
-{
-public:
-    Vetor forward(const Vetor &logits) override
+    // --- Por amostra ---
+    // O resultado é escrito em 'saida'/'delta', que já devem ter o tamanho certo
+
+    void forward(const Vetor &logits, Vetor &saida) { forward_lote(logits, saida); }
+
+    void backward(const Vetor &saida_ativada, const Vetor &saida_esperada, Vetor &delta)
+    {
+        backward_lote(saida_ativada, saida_esperada, delta);
+    }
+
+    double calcular_loss(const Vetor &saida_ativada, const Vetor &saida_esperada)
     {
-        Vetor ativacoes = logits;
-        if (ativacoes.empty())
-            return ativacoes;
+        return calcular_loss_lote(saida_ativada, saida_esperada);
+    }
 
-        double max_val = ativacoes[0];
+    // --- Inferência ---
 
-        for (size_t i = 1; i < ativacoes.size(); i++)
-            max_val = std::max(max_val, ativacoes[i]);
+    /*
+    Índice da maior saída, calculado direto dos logits. As ativações de saída
+    implementadas (softmax e linear) preservam a ordem dos valores, então a
+    ativação (e o exp do softmax) pode ser pulada quando só a classe importa.
+    */
+    virtual size_t argmax(const double *logits, size_t n) const
+    {
+        return std::max_element(logits, logits + n) - logits;
+    }
 
-        double sum = 0.0;
-        for (size_t i = 0; i < ativacoes.size(); i++)
+    // Os 'k' maiores índices, do maior para o menor (k <= n)
+    virtual void top_k(const double *logits, size_t n, size_t k, size_t *indices) const
+    {
+        // Inserção ordenada: k costuma ser pequeno (1 a 5)
+        size_t preenchidos = 0;
+        for (size_t i = 0; i < n; i++)
         {
-            ativacoes[i] = exp(ativacoes[i] - max_val);
-            sum += ativacoes[i];
+            size_t pos = preenchidos < k ? preenchidos++ : k;
+            while (pos > 0 && logits[indices[pos - 1]] < logits[i])
+            {
+                if (pos < k)
+                    indices[pos] = indices[pos - 1];
+                pos--;
+            }
+            if (pos < k)
+                indices[pos] = i;
         }
+    }
+};
 
-        for (size_t i = 0; i < ativacoes.size(); i++)
-            ativacoes[i] /= sum;
-
-        return ativacoes;
+// --- ESTRATÉGIA PARA CLASSIFICAÇÃO ---
+class SoftmaxCrossEntropy : public CamadaSaida
+{
+public:
+    void forward_lote(LoteConstante logits, LoteValores ativacoes) override
+    {
+        for (size_t a = 0; a < logits.n_amostras; a++)
+            softmax(logits.amostra(a), ativacoes.amostra(a), logits.largura);
     }
 
-    Vetor backward(const Vetor &saida_ativada, const Vetor &saida_esperada) override
+    void backward_lote(LoteConstante saida_ativada, LoteConstante saida_esperada, LoteValores delta) override
     {
-        Vetor delta = saida_ativada;
-        for (size_t i = 0; i < delta.size(); i++)
+        // Gradiente da entropia cruzada em relação aos logits do softmax
+        const size_t total = delta.n_amostras * delta.largura;
+        for (size_t i = 0; i < total; i++)
         {
-            delta[i] -= saida_esperada[i];
+            delta.dados[i] = saida_ativada.dados[i] - saida_esperada.dados[i];
         }
-        return delta;
     }
 
-    double calcular_loss(const Vetor &saida_ativada, const Vetor &saida_esperada) override
+    double calcular_loss_lote(LoteConstante saida_ativada, LoteConstante saida_esperada) override
     {
         // Perda de Entropia Cruzada Categórica
         double perda = 0.0;
-        for (size_t i = 0; i < saida_esperada.size(); i++)
+        const size_t total = saida_esperada.n_amostras * saida_esperada.largura;
+        for (size_t i = 0; i < total; i++)
         {
-            // Adiciona um valor pequeno para evitar log(0)
-            perda += saida_esperada[i] * log(saida_ativada[i] + 1e-9);
+            // Com rótulos one-hot, quase todos os termos são zero: pula o log
+            if (saida_esperada.dados[i] != 0.0)
+                // Adiciona um valor pequeno para evitar log(0)
+                perda += saida_esperada.dados[i] * log(saida_ativada.dados[i] + 1e-9);
         }
         return -perda;
     }
 
+    double forward_backward_lote(LoteConstante logits, LoteConstante saida_esperada,
+                                 LoteValores saida, LoteValores delta) override
+    {
+        double perda = 0.0;
+        const size_t n = logits.largura;
+
+        for (size_t a = 0; a < logits.n_amostras; a++)
+        {
+            const double *z = logits.amostra(a);
+            const double *y = saida_esperada.amostra(a);
+            double *p = saida.amostra(a);
+            double *d = delta.amostra(a);
+
+            // log(soma(e^z)) sai de graça do softmax, e então
+            // -soma(y log(p)) = soma(y (lse - z)): um único log por amostra
+            double lse = softmax(z, p, n);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                d[i] = p[i] - y[i];
+                perda += y[i] * (lse - z[i]);
+            }
+        }
+
+        return perda;
+    }
+
     std::string get_tipo() const override { return "SCE"; }
 
     std::unique_ptr<CamadaSaida> clone() const override
@@ -89,39 +189,81 @@ public:
         return std::make_unique<SoftmaxCrossEntropy>(*this);
     }
 
+private:
+    // Softmax estável de uma amostra. Retorna log(soma(e^z))
+    static double softmax(const double *logits, double *ativacoes, size_t n)
+    {
+        if (n == 0)
+            return 0.0;
+
+        double max_val = *std::max_element(logits, logits + n);
+
+        for (size_t i = 0; i < n; i++)
+            ativacoes[i] = logits[i] - max_val;
+
+        nn::exp_vetor(ativacoes, ativacoes, n);
+
+        double sum = 0.0;
+        for (size_t i = 0; i < n; i++)
+            sum += ativacoes[i];
+
+        const double inv = 1.0 / sum;
+        for (size_t i = 0; i < n; i++)
+            ativacoes[i] *= inv;
+
+        return max_val + log(sum);
+    }
+
 }; // SoftmaxCrossEntropy
 
 // --- ESTRATÉGIA PARA REGRESSÃO ---
 class LinearMeanSquareError : public CamadaSaida
 {
 public:
-    Vetor forward(const Vetor &logits) override
+    void forward_lote(LoteConstante logits, LoteValores ativacoes) override
     {
-        // A ativação linear simplesmente retorna a entrada
-        return logits;
+        // A ativação linear simplesmente copia a entrada
+        if (logits.dados != ativacoes.dados)
+            std::copy(logits.dados, logits.dados + logits.n_amostras * logits.largura, ativacoes.dados);
     }
 
-    Vetor backward(const Vetor &saida_ativada, const Vetor &saida_esperada) override
+    void backward_lote(LoteConstante saida_ativada, LoteConstante saida_esperada, LoteValores delta) override
     {
         // Derivada do Erro Quadrático Médio: (saída - esperado)
         // Multiplicado pela derivada da ativação linear (1)
-        Vetor delta = saida_ativada;
-        for (size_t i = 0; i < delta.size(); i++)
+        const size_t total = delta.n_amostras * delta.largura;
+        for (size_t i = 0; i < total; i++)
+        {
+            delta.dados[i] = saida_ativada.dados[i] - saida_esperada.dados[i];
+        }
+    }
+
+    double calcular_loss_lote(LoteConstante saida_ativada, LoteConstante saida_esperada) override
+    {
+        // Erro Quadrático Médio (Mean Squared Error) de cada amostra
+        double perda = 0.0;
+        const size_t total = saida_esperada.n_amostras * saida_esperada.largura;
+        for (size_t i = 0; i < total; i++)
         {
-            delta[i] -= saida_esperada[i];
+            double erro = saida_ativada.dados[i] - saida_esperada.dados[i];
+            perda += erro * erro;
         }
-        return delta;
+        return perda / saida_ativada.largura;
     }
 
-    double calcular_loss(const Vetor &saida_ativada, const Vetor &saida_esperada) override
+    double forward_backward_lote(LoteConstante logits, LoteConstante saida_esperada,
+                                 LoteValores saida, LoteValores delta) override
     {
-        // Erro Quadrático Médio (Mean Squared Error)
         double perda = 0.0;
-        for (size_t i = 0; i < saida_esperada.size(); i++)
+        const size_t total = logits.n_amostras * logits.largura;
+        for (size_t i = 0; i < total; i++)
         {
-            perda += pow(saida_ativada[i] - saida_esperada[i], 2);
+            double erro = logits.dados[i] - saida_esperada.dados[i];
+            saida.dados[i] = logits.dados[i];
+            delta.dados[i] = erro;
+            perda += erro * erro;
         }
-        return perda / saida_ativada.size();
+        return perda / logits.largura;
     }
 
     std::string get_tipo() const override { return "LMSE"; }
@@ -133,4 +275,4 @@ public:
 
 }; // LinearMeanSquareError
 
-#endif // _CAMADAS_SAIDA_H
\ No newline at end of file
+#endif // _CAMADAS_SAIDA_H
@@ -0,0 +1,144 @@
+#ifndef _CONTADORES_H
+#define _CONTADORES_H
+
+#include <cstdint>
+#include <string>
+
+namespace nn
+{
+  // Eventos lidos dos contadores de hardware (perf_event_open, no Linux)
+  enum EventoHardware
+  {
+    CICLOS,
+    INSTRUCOES,
+    FALTAS_L1D,      // faltas de leitura na cache de dados L1
+    FALTAS_LLC,      // faltas na cache de último nível (vão para a memória)
+    DESVIOS_ERRADOS, // desvios previstos errado
+    N_EVENTOS_HARDWARE
+  };
+
+  const char *nome_evento(EventoHardware evento);
+
+  // Resultado de uma medição (ou a soma de várias)
+  struct Medicao
+  {
+    uint64_t chamadas = 0;
+    double segundos = 0.0;
+
+    // Operações de ponto flutuante, contadas analiticamente por quem mediu
+    // (os contadores genéricos do perf não têm um evento de FLOPs portátil)
+    double flops = 0.0;
+
+    // -1 = contador indisponível nesta máquina
+    int64_t eventos[N_EVENTOS_HARDWARE] = {-1, -1, -1, -1, -1};
+
+    // Valores derivados: negativos quando faltam os contadores necessários
+    double ipc() const;
+    double gflops() const;
+
+    // Tráfego estimado com a memória: faltas na LLC * 64 bytes por segundo
+    double banda_gbs() const;
+
+    Medicao &operator+=(const Medicao &outra);
+  };
+
+  /*
+  Contadores de hardware da thread que criou o objeto.
+
+  Cada evento é aberto separadamente, então os que a CPU (ou a máquina
+  virtual) não tem ficam só marcados como indisponíveis. Se nenhum abrir
+  (fora do Linux, perf_event_paranoid alto, contêiner sem permissão),
+  'disponivel' é false, 'erro' diz o motivo e as medições trazem só o tempo.
+
+  Só a thread dona é contada: laços divididos pelo ContextoExecucao entre
+  outras threads ficam de fora. Para medir um kernel inteiro, use
+  ModoExecucao::LATENCIA.
+  */
+  class ContadoresHardware
+  {
+  public:
+    ContadoresHardware();
+    ~ContadoresHardware();
+
+    ContadoresHardware(const ContadoresHardware &) = delete;
+    ContadoresHardware &operator=(const ContadoresHardware &) = delete;
+
+    bool disponivel() const;
+    bool disponivel(EventoHardware evento) const { return m_fds[evento] >= 0; }
+    const std::string &erro() const { return m_erro; }
+
+    void iniciar();
+
+    // Eventos e tempo desde o último 'iniciar' (uma chamada)
+    Medicao parar();
+
+    // Valores brutos dos contadores: para medições que se sobrepõem, cada
+    // uma guarda a sua leitura inicial
+    struct Leitura
+    {
+      uint64_t valor[N_EVENTOS_HARDWARE];
+      uint64_t habilitado[N_EVENTOS_HARDWARE];
+      uint64_t rodando[N_EVENTOS_HARDWARE];
+      int64_t ns;
+    };
+
+    void ler(Leitura &leitura) const;
+    Medicao diferenca(const Leitura &inicio, const Leitura &fim) const;
+
+  private:
+    int m_fds[N_EVENTOS_HARDWARE];
+    std::string m_erro;
+    Leitura m_inicio;
+  };
+
+  /*
+  Contadores por região instrumentada da rede: o produto matriz-vetor do
+  forward (propagar_camada), o backward de cada camada e o passo do Adam.
+
+  Desligado por padrão, e aí cada região custa só a leitura de um booleano.
+  Ligado, cada thread abre os seus contadores na primeira região que
+  executa, e as medições de todas as threads são somadas por região.
+  */
+  namespace contadores
+  {
+    enum Regiao
+    {
+      FORWARD,
+      BACKWARD,
+      OTIMIZADOR,
+      N_REGIOES
+    };
+
+    const char *nome_regiao(Regiao regiao);
+
+    void habilitar(bool ligado);
+    bool habilitado();
+
+    // Soma das medições da região desde o último 'zerar'
+    Medicao total(Regiao regiao);
+    void zerar();
+
+    // Se os contadores abrem nesta máquina (e, se não, por quê)
+    bool disponivel(std::string *erro = nullptr);
+
+    // Mede do construtor ao destrutor, somando 'flops' à região
+    class Escopo
+    {
+    public:
+      Escopo(Regiao regiao, double flops);
+      ~Escopo();
+
+      Escopo(const Escopo &) = delete;
+      Escopo &operator=(const Escopo &) = delete;
+
+    private:
+      Regiao m_regiao;
+      double m_flops;
+      ContadoresHardware *m_contadores; // nullptr = desligado
+      ContadoresHardware::Leitura m_inicio;
+    };
+  } // namespace contadores
+
+} // namespace nn
+
+#endif // _CONTADORES_H
@@ -0,0 +1,164 @@
+#ifndef _CONVOLUCAO_H
+#define _CONVOLUCAO_H
+
+#include "rede_neural.h"
+
+#include <memory>
+#include <string>
+#include <cstddef>
+
+namespace nn
+{
+  // Formato de uma imagem: canais x altura x largura, guardada nessa ordem (CHW)
+  struct Formato3D
+  {
+    size_t canais = 1;
+    size_t altura = 1;
+    size_t largura = 1;
+
+    size_t tamanho() const { return canais * altura * largura; }
+  };
+
+  /*
+  Camada que trabalha sobre imagens, antes das camadas densas de uma
+  Sequencial (ver o construtor com extrator). Entradas, saídas e gradientes
+  são vetores planos no formato CHW, então a última camada de imagem já
+  entrega a entrada das densas.
+
+  Os parâmetros (se houver) ficam num único vetor; a Sequencial cuida dos
+  gradientes, do Adam, da cópia dos melhores pesos e do arquivo do modelo.
+  */
+  class CamadaImagem
+  {
+  public:
+    virtual ~CamadaImagem() = default;
+
+    /*
+    Define o formato da entrada, calcula o da saída e dimensiona os
+    parâmetros (sorteados de novo). Lança std::invalid_argument se a camada
+    não couber na entrada.
+    */
+    virtual void configurar(const Formato3D &entrada) = 0;
+
+    const Formato3D &get_entrada() const { return m_entrada; }
+    const Formato3D &get_saida() const { return m_saida; }
+
+    // Buffer por amostra escrito pelo forward e usado (e sobrescrito) pelo backward
+    virtual size_t tamanho_auxiliar() const { return 0; }
+
+    virtual void forward(const double *x, double *y, double *auxiliar, ContextoExecucao &contexto) const = 0;
+
+    /*
+    Backward de uma amostra, depois do forward dela.
+    @tparam dy gradiente do loss em relação à saída (é modificado)
+    @tparam dx recebe o gradiente em relação à entrada (nullptr na primeira camada, onde não é usado)
+    @tparam gradientes gradientes dos parâmetros, com o formato de get_parametros (somados com 'acumular')
+    */
+    virtual void backward(const double *x, const double *y, double *auxiliar, double *dy, double *dx,
+                          double *gradientes, bool acumular, ContextoExecucao &contexto) const = 0;
+
+    // Operações de ponto flutuante do forward de uma amostra
+    virtual double flops() const = 0;
+
+    Vetor &get_parametros() { return m_parametros; }
+    const Vetor &get_parametros() const { return m_parametros; }
+
+    // Palavra-chave e argumentos da camada no arquivo de modelo (ex.: "CONV2D" e "8 3 1 0 ReLU")
+    virtual std::string get_tipo() const = 0;
+    virtual std::string descricao() const = 0;
+
+    virtual std::unique_ptr<CamadaImagem> clone() const = 0;
+
+  protected:
+    Formato3D m_entrada, m_saida;
+    Vetor m_parametros;
+  };
+
+  /*
+  Convolução 2D com 'filtros' filtros de kernel x kernel sobre todos os
+  canais da entrada, seguida da ativação. Calculada com im2col + GEMM: as
+  janelas da imagem viram as colunas de uma matriz (canais * kernel² linhas,
+  uma coluna por posição de saída), e a saída inteira é um único produto de
+  matrizes com os filtros (ver produto_matrizes em matematica.h).
+
+  Parâmetros: os pesos de cada filtro (canal, linha, coluna) e depois os
+  biases dos filtros.
+  */
+  class Conv2D : public CamadaImagem
+  {
+  public:
+    Conv2D(size_t filtros, size_t kernel, size_t passo = 1, size_t preenchimento = 0, func ativacao = ReLU);
+
+    void configurar(const Formato3D &entrada) override;
+
+    size_t tamanho_auxiliar() const override;
+
+    void forward(const double *x, double *y, double *auxiliar, ContextoExecucao &contexto) const override;
+    void backward(const double *x, const double *y, double *auxiliar, double *dy, double *dx,
+                  double *gradientes, bool acumular, ContextoExecucao &contexto) const override;
+
+    double flops() const override;
+
+    std::string get_tipo() const override { return "CONV2D"; }
+    std::string descricao() const override;
+
+    std::unique_ptr<CamadaImagem> clone() const override { return std::make_unique<Conv2D>(*this); }
+
+  private:
+    size_t m_filtros, m_kernel, m_passo, m_preenchimento;
+    func m_ativacao;
+
+    size_t linhas_colunas() const { return m_entrada.canais * m_kernel * m_kernel; }
+    size_t posicoes() const { return m_saida.altura * m_saida.largura; }
+
+    void im2col(const double *x, double *colunas) const;
+    void col2im(const double *colunas, double *dx) const;
+  };
+
+  // Máximo de cada janela tamanho x tamanho, canal por canal (passo 0 = tamanho)
+  class MaxPool2D : public CamadaImagem
+  {
+  public:
+    explicit MaxPool2D(size_t tamanho, size_t passo = 0);
+
+    void configurar(const Formato3D &entrada) override;
+
+    // Posição do máximo de cada janela, usada no backward
+    size_t tamanho_auxiliar() const override { return m_saida.tamanho(); }
+
+    void forward(const double *x, double *y, double *auxiliar, ContextoExecucao &contexto) const override;
+    void backward(const double *x, const double *y, double *auxiliar, double *dy, double *dx,
+                  double *gradientes, bool acumular, ContextoExecucao &contexto) const override;
+
+    double flops() const override;
+
+    std::string get_tipo() const override { return "MAXPOOL2D"; }
+    std::string descricao() const override;
+
+    std::unique_ptr<CamadaImagem> clone() const override { return std::make_unique<MaxPool2D>(*this); }
+
+  private:
+    size_t m_tamanho, m_passo;
+  };
+
+  // Achata a imagem num vetor (canais * altura * largura, 1, 1): marca o fim do extrator
+  class Flatten : public CamadaImagem
+  {
+  public:
+    void configurar(const Formato3D &entrada) override;
+
+    void forward(const double *x, double *y, double *auxiliar, ContextoExecucao &contexto) const override;
+    void backward(const double *x, const double *y, double *auxiliar, double *dy, double *dx,
+                  double *gradientes, bool acumular, ContextoExecucao &contexto) const override;
+
+    double flops() const override { return 0.0; }
+
+    std::string get_tipo() const override { return "FLATTEN"; }
+    std::string descricao() const override { return ""; }
+
+    std::unique_ptr<CamadaImagem> clone() const override { return std::make_unique<Flatten>(*this); }
+  };
+
+} // namespace nn
+
+#endif // _CONVOLUCAO_H
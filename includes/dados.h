@@ -0,0 +1,74 @@
+#ifndef _DADOS_H
+#define _DADOS_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace nn
+{
+  using Vetor = std::vector<double>;
+
+  /*
+  Visão (sem cópia) de um conjunto de amostras rotuladas: aponta para os
+  vetores de entradas e saídas de quem a criou e, opcionalmente, para uma
+  lista de índices que define a ordem e quais amostras fazem parte dela.
+
+  Fatiar, embaralhar e separar treino/validação só mexem nos índices; as
+  amostras nunca são copiadas. Os vetores originais devem viver mais que a
+  visão (e não mudar de tamanho enquanto ela for usada).
+
+  Ex.:
+    nn::VisaoDados todos(imagens, rotulos);
+    nn::VisaoDados embaralhados = todos.permutada(42);
+    nn::VisaoDados validacao = embaralhados.fatia(0, 12000);
+    nn::VisaoDados treino = embaralhados.fatia(12000, embaralhados.tamanho());
+  */
+  class VisaoDados
+  {
+  public:
+    // Todas as amostras, na ordem dos vetores.
+    // Lança std::invalid_argument se os tamanhos forem diferentes
+    VisaoDados(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas);
+
+    // As amostras entradas[indices[i]], saidas[indices[i]]
+    VisaoDados(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas,
+               std::shared_ptr<const std::vector<size_t>> indices);
+
+    // A visão só guarda ponteiros: vetores temporários seriam destruídos antes dela
+    VisaoDados(std::vector<Vetor> &&, const std::vector<Vetor> &) = delete;
+    VisaoDados(const std::vector<Vetor> &, std::vector<Vetor> &&) = delete;
+    VisaoDados(std::vector<Vetor> &&, std::vector<Vetor> &&) = delete;
+    VisaoDados(std::vector<Vetor> &&, const std::vector<Vetor> &, std::shared_ptr<const std::vector<size_t>>) = delete;
+    VisaoDados(const std::vector<Vetor> &, std::vector<Vetor> &&, std::shared_ptr<const std::vector<size_t>>) = delete;
+    VisaoDados(std::vector<Vetor> &&, std::vector<Vetor> &&, std::shared_ptr<const std::vector<size_t>>) = delete;
+
+    size_t tamanho() const { return m_fim - m_inicio; }
+    bool vazia() const { return m_fim == m_inicio; }
+
+    // Posição da i-ésima amostra da visão nos vetores originais
+    size_t indice(size_t i) const { return m_indices ? (*m_indices)[m_inicio + i] : m_inicio + i; }
+
+    const Vetor &entrada(size_t i) const { return (*m_entradas)[indice(i)]; }
+    const Vetor &saida(size_t i) const { return (*m_saidas)[indice(i)]; }
+
+    const std::vector<Vetor> &entradas_originais() const { return *m_entradas; }
+    const std::vector<Vetor> &saidas_originais() const { return *m_saidas; }
+
+    // As amostras [inicio, fim) desta visão (compartilha os índices)
+    VisaoDados fatia(size_t inicio, size_t fim) const;
+
+    // As mesmas amostras numa ordem aleatória (só os índices são copiados)
+    VisaoDados permutada(uint64_t semente) const;
+
+  private:
+    const std::vector<Vetor> *m_entradas;
+    const std::vector<Vetor> *m_saidas;
+    std::shared_ptr<const std::vector<size_t>> m_indices; // nullptr = ordem original
+    size_t m_inicio = 0, m_fim = 0;
+  };
+
+} // namespace nn
+
+#endif // _DADOS_H
@@ -0,0 +1,108 @@
+#ifndef _DISTRIBUIDO_H
+#define _DISTRIBUIDO_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+
+namespace nn
+{
+  /*
+  Canal do anel: cada processo envia para o próximo (rank + 1) e recebe do
+  anterior (rank - 1). Os dados são doubles crus, então todos os processos
+  precisam ter a mesma arquitetura.
+  */
+  class Transporte
+  {
+  public:
+    virtual ~Transporte() = default;
+
+    // Envia 'envio' para o próximo processo enquanto recebe 'recebido' do
+    // anterior. As duas coisas andam juntas para o anel não travar.
+    virtual void trocar(const double *envio, size_t n_envio, double *recebido, size_t n_recebido) = 0;
+  };
+
+  enum class TipoTransporte
+  {
+    MEMORIA_COMPARTILHADA, // processos na mesma máquina (POSIX shm)
+    TCP                    // processos em máquinas diferentes (ou loopback)
+  };
+
+  struct ConfigDistribuido
+  {
+    size_t rank = 0;
+    size_t n_processos = 1;
+    TipoTransporte transporte = TipoTransporte::MEMORIA_COMPARTILHADA;
+
+    // Prefixo dos segmentos de memória compartilhada (deve ser igual em todos)
+    std::string sessao = "nn";
+
+    // Endereço "host:porta" de cada rank, usado pelo TCP
+    std::vector<std::string> enderecos;
+  };
+
+  /*
+  Lê a configuração das variáveis de ambiente:
+  NN_RANK, NN_N_PROCESSOS, NN_TRANSPORTE ("shm" ou "tcp"), NN_SESSAO e
+  NN_ENDERECOS (lista "host:porta" separada por vírgulas, um por rank)
+  */
+  ConfigDistribuido config_do_ambiente();
+
+  /*
+  Grupo de processos que treinam a mesma rede.
+
+  O allreduce é em anel: reduce-scatter seguido de all-gather, cada processo
+  enviando 2*(P-1)/P do buffer, independente do número de processos P.
+
+  allreduce_assincrono coloca o buffer numa fila atendida por uma thread de
+  comunicação, o que permite reduzir os gradientes de uma camada enquanto o
+  backward ainda calcula as camadas anteriores. Todos os processos precisam
+  fazer as mesmas chamadas, na mesma ordem.
+  */
+  class GrupoProcessos
+  {
+  public:
+    explicit GrupoProcessos(const ConfigDistribuido &config);
+    ~GrupoProcessos();
+
+    GrupoProcessos(const GrupoProcessos &) = delete;
+    GrupoProcessos &operator=(const GrupoProcessos &) = delete;
+
+    size_t get_rank() const;
+    size_t get_n_processos() const;
+
+    // Soma 'dados' de todos os processos; o resultado fica em todos
+    void allreduce(double *dados, size_t n);
+
+    // Copia 'dados' do processo 'raiz' para todos os outros
+    void broadcast(double *dados, size_t n, size_t raiz = 0);
+
+    void barreira();
+
+    // Enfileira um allreduce; 'dados' deve continuar válido até esperar()
+    void allreduce_assincrono(double *dados, size_t n);
+
+    // Espera todos os allreduces assíncronos terminarem
+    void esperar();
+
+  private:
+    struct Comunicacao;
+
+    void allreduce_anel(double *dados, size_t n);
+
+    ConfigDistribuido m_config;
+    std::unique_ptr<Transporte> m_transporte;
+    std::unique_ptr<Comunicacao> m_comunicacao;
+    std::vector<double> m_recebido;
+  };
+
+  // Fatia [inicio, fim) dos dados que cabe a um processo. Todas as fatias têm
+  // o mesmo tamanho (as últimas n % n_processos amostras ficam de fora), para
+  // que todos os processos façam o mesmo número de passos por época.
+  std::pair<size_t, size_t> fatia_dados(size_t n, size_t rank, size_t n_processos);
+
+} // namespace nn
+
+#endif // _DISTRIBUIDO_H
@@ -0,0 +1,83 @@
+#ifndef _ESCALONADOR_H
+#define _ESCALONADOR_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+namespace nn
+{
+  /*
+  Grafo de tarefas com dependências (um DAG).
+
+  O grafo é montado uma vez e pode ser executado várias vezes: as tarefas
+  leem seus parâmetros de onde quiserem (ex.: do lote atual da rede), então
+  a mesma estrutura serve para todos os lotes sem novas alocações.
+  */
+  class GrafoTarefas
+  {
+  public:
+    // Adiciona uma tarefa e retorna o seu índice
+    size_t adicionar_tarefa(std::function<void()> tarefa);
+
+    // A tarefa 'depois' só começa quando a tarefa 'antes' terminar
+    void adicionar_dependencia(size_t antes, size_t depois);
+
+    void limpar();
+
+    size_t tamanho() const;
+    bool vazio() const;
+
+  private:
+    friend class EscalonadorTarefas;
+
+    std::vector<std::function<void()>> m_tarefas;
+    std::vector<std::vector<size_t>> m_dependentes; // tarefas liberadas por cada tarefa
+    std::vector<int> m_n_dependencias;               // quantas tarefas cada uma espera
+
+    // Contadores usados durante a execução
+    std::unique_ptr<std::atomic<int>[]> m_pendentes;
+    size_t m_capacidade_pendentes = 0;
+  };
+
+  /*
+  Escalonador com roubo de tarefas (work stealing).
+
+  Cada trabalhador tem a sua própria fila dupla: tarefas liberadas por ele
+  entram no fim da sua fila e são retiradas de lá (LIFO, bom para a cache).
+  Um trabalhador sem tarefas rouba do começo da fila de outro (FIFO), de modo
+  que nenhum núcleo fica esperando uma barreira enquanto existe trabalho
+  pronto em alguma camada.
+
+  Dentro das tarefas, paralelo_para roda em série (ver RegiaoSerial): o
+  paralelismo vem das próprias tarefas.
+  */
+  class EscalonadorTarefas
+  {
+  public:
+    // @tparam n_trabalhadores número de trabalhadores (contando a thread chamadora), 0 usa o número de núcleos
+    explicit EscalonadorTarefas(size_t n_trabalhadores = 0);
+    ~EscalonadorTarefas();
+
+    EscalonadorTarefas(const EscalonadorTarefas &) = delete;
+    EscalonadorTarefas &operator=(const EscalonadorTarefas &) = delete;
+
+    // Executa todas as tarefas do grafo respeitando as dependências
+    // Retorna quando todas terminarem
+    void executar(GrafoTarefas &grafo);
+
+    size_t get_n_trabalhadores() const;
+
+  private:
+    struct Estado;
+    std::unique_ptr<Estado> m_estado;
+  };
+
+  // Escalonador compartilhado, criado no primeiro uso
+  EscalonadorTarefas &escalonador_padrao();
+
+} // namespace nn
+
+#endif // _ESCALONADOR_H
@@ -0,0 +1,156 @@
+#ifndef _EXECUCAO_H
+#define _EXECUCAO_H
+
+#include <cstddef>
+#include <memory>
+
+namespace nn
+{
+  /*
+  Modos de execução:
+  LATENCIA - tudo roda na thread chamadora (ideal para inferência de uma amostra)
+  VAZAO    - os laços grandes o bastante são divididos entre as threads do pool
+  */
+  enum class ModoExecucao
+  {
+    LATENCIA,
+    VAZAO
+  };
+
+  /*
+  Backends disponíveis para o paralelo_para:
+  POOL   - pool de threads próprio e persistente (sempre disponível)
+  OPENMP - regiões paralelas do OpenMP (só se compilado com NN_OPENMP)
+  */
+  enum class BackendExecucao
+  {
+    POOL,
+    OPENMP
+  };
+
+  /*
+  Contexto de execução: decide se, e como, um laço é dividido entre threads.
+
+  Todos os kernels da rede passam por aqui, em vez de usar '#pragma omp'
+  diretamente. Um laço só é paralelizado se o trabalho total
+  (n * custo_por_item) passa do grão mínimo; abaixo disso o custo de acordar
+  as threads é maior que o ganho, e o laço roda em série.
+
+  Chamadas de paralelo_para feitas de dentro de outro paralelo_para rodam em
+  série na thread que as chamou.
+  */
+  class ContextoExecucao
+  {
+  public:
+    /*
+    @tparam n_threads número de threads (contando a chamadora), 0 usa o número de núcleos
+    @tparam grao_minimo trabalho mínimo (em operações) de cada bloco paralelo
+    */
+    explicit ContextoExecucao(size_t n_threads = 0, size_t grao_minimo = 16384);
+    ~ContextoExecucao();
+
+    ContextoExecucao(const ContextoExecucao &) = delete;
+    ContextoExecucao &operator=(const ContextoExecucao &) = delete;
+
+    // Recria o pool com outro número de threads (0 = número de núcleos)
+    void set_n_threads(size_t n_threads);
+    void set_grao_minimo(size_t grao_minimo);
+    void set_modo(ModoExecucao modo);
+
+    // Retorna false (e mantém o backend atual) se o backend não foi compilado
+    bool set_backend(BackendExecucao backend);
+
+    size_t get_n_threads() const;
+    size_t get_grao_minimo() const;
+    ModoExecucao get_modo() const;
+    BackendExecucao get_backend() const;
+
+    /*
+    Executa fn(inicio, fim) sobre blocos contíguos de [0, n).
+    @tparam custo_por_item estimativa de operações por item, usada para decidir
+    se vale a pena paralelizar e em quantos blocos dividir
+    */
+    template <typename F>
+    void paralelo_para(size_t n, size_t custo_por_item, const F &fn)
+    {
+      size_t n_blocos = calcular_blocos(n, custo_por_item);
+
+      if (n_blocos <= 1)
+      {
+        if (n > 0) fn(size_t(0), n);
+        return;
+      }
+
+      executar(n, n_blocos, &trampolim<F>, static_cast<const void *>(&fn));
+    }
+
+    /*
+    Como paralelo_para, mas em 'n_blocos' blocos, sem olhar o grão mínimo
+    (ex.: um número de threads escolhido pelo autoajuste). Ainda roda em
+    série no modo LATENCIA e dentro de outro paralelo_para, e nunca usa
+    mais blocos que threads.
+    */
+    template <typename F>
+    void paralelo_para_em(size_t n, size_t n_blocos, const F &fn)
+    {
+      n_blocos = limitar_blocos(n, n_blocos);
+
+      if (n_blocos <= 1)
+      {
+        if (n > 0) fn(size_t(0), n);
+        return;
+      }
+
+      executar(n, n_blocos, &trampolim<F>, static_cast<const void *>(&fn));
+    }
+
+    // Número de blocos em que paralelo_para dividiria um laço com esse custo
+    size_t calcular_blocos(size_t n, size_t custo_por_item) const;
+
+    // Número de blocos que paralelo_para_em usaria
+    size_t limitar_blocos(size_t n, size_t n_blocos) const;
+
+  private:
+    using FuncaoBloco = void (*)(const void *dados, size_t inicio, size_t fim);
+
+    template <typename F>
+    static void trampolim(const void *dados, size_t inicio, size_t fim)
+    {
+      (*static_cast<const F *>(dados))(inicio, fim);
+    }
+
+    void executar(size_t n, size_t n_blocos, FuncaoBloco funcao, const void *dados);
+
+    struct Pool;
+    std::unique_ptr<Pool> m_pool;
+
+    size_t m_n_threads;
+    size_t m_grao_minimo;
+    ModoExecucao m_modo;
+    BackendExecucao m_backend;
+  };
+
+  // Contexto compartilhado usado por padrão por todas as redes
+  ContextoExecucao &contexto_padrao();
+
+  /*
+  Enquanto um objeto deste tipo existir, todo paralelo_para chamado pela
+  thread atual roda em série. Usado por quem já distribui o trabalho entre
+  threads por conta própria (ex.: o escalonador de tarefas).
+  */
+  class RegiaoSerial
+  {
+  public:
+    RegiaoSerial();
+    ~RegiaoSerial();
+
+    RegiaoSerial(const RegiaoSerial &) = delete;
+    RegiaoSerial &operator=(const RegiaoSerial &) = delete;
+
+  private:
+    bool m_anterior;
+  };
+
+} // namespace nn
+
+#endif // _EXECUCAO_H
@@ -0,0 +1,144 @@
+#ifndef _FLUXO_H
+#define _FLUXO_H
+
+#include "rede_neural.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+namespace nn
+{
+  // Uma amostra rotulada (entrada e saída esperada)
+  struct Amostra
+  {
+    Vetor entrada;
+    Vetor saida;
+  };
+
+  /*
+  Fila limitada de amostras, segura para vários produtores e um consumidor.
+
+  Quando está cheia, inserir() espera espaço ou, se 'descartar_antigas' for
+  verdadeiro, joga fora a amostra mais antiga: assim um produtor rápido nunca
+  trava e o treino sempre vê os dados mais recentes.
+  */
+  class FilaAmostras
+  {
+  public:
+    explicit FilaAmostras(size_t capacidade = 1024, bool descartar_antigas = false);
+
+    // Retorna false se a fila já foi fechada
+    bool inserir(Amostra amostra);
+
+    // Espera até 'espera' por uma amostra. Retorna false se o tempo acabou
+    // ou se a fila foi fechada e está vazia
+    bool retirar(Amostra &amostra, std::chrono::milliseconds espera);
+
+    // Avisa que não virão mais amostras; o consumidor termina depois de esvaziar a fila
+    void fechar();
+
+    bool fechada() const;
+    size_t tamanho() const;
+    size_t descartadas() const;
+
+  private:
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cv_dados;
+    std::condition_variable m_cv_espaco;
+    std::deque<Amostra> m_amostras;
+
+    size_t m_capacidade;
+    bool m_descartar_antigas;
+    bool m_fechada = false;
+    size_t m_descartadas = 0;
+  };
+
+  struct ConfigFluxo
+  {
+    size_t tamanho_lote = 32;
+    double taxa_aprendizagem = 1e-3;
+
+    // Tempo máximo que a primeira amostra de um lote espera por ele: vencido,
+    // o lote incompleto é usado assim mesmo (mesmo que ainda cheguem
+    // amostras), para que a latência de cada atualização continue limitada
+    std::chrono::milliseconds espera_maxima{50};
+
+    // Chamada depois de cada atualização com o número do passo e o loss do lote
+    std::function<void(size_t passo, double perda)> ao_atualizar;
+  };
+
+  struct ResultadoFluxo
+  {
+    size_t passos = 0;
+    size_t amostras = 0;
+    double perda_media = 0.0; // média móvel exponencial do loss dos lotes
+  };
+
+  /*
+  Treina a rede com amostras que chegam continuamente, usando train_step em
+  lotes de 'tamanho_lote'. Retorna quando a fila for fechada e esvaziada.
+  */
+  ResultadoFluxo treinar_fluxo(Sequencial &rede, FilaAmostras &fila, const ConfigFluxo &config);
+
+  // Uso interno dos treinos em fluxo
+  namespace detalhe
+  {
+    // Lote com 'tamanho_lote' vagas reaproveitadas de um passo para o outro:
+    // depois do primeiro lote, guardar uma amostra não aloca memória
+    class LoteFluxo
+    {
+    public:
+      explicit LoteFluxo(size_t tamanho_lote);
+
+      void adicionar(const Vetor &entrada, const Vetor &saida);
+      void adicionar(Amostra &&amostra);
+
+      bool cheio() const { return m_n == m_entradas.size(); }
+      bool vazio() const { return m_n == 0; }
+
+      // train_step com as amostras guardadas (esvaziando o lote), atualizando
+      // 'resultado' e chamando config.ao_atualizar
+      void atualizar(Sequencial &rede, const ConfigFluxo &config, ResultadoFluxo &resultado);
+
+    private:
+      std::vector<Vetor> m_entradas, m_saidas;
+      std::vector<Vetor> m_sobra_entradas, m_sobra_saidas; // vagas livres de um lote incompleto
+      size_t m_n = 0;
+
+      // Volta as vagas livres para o lote e o esvazia
+      void devolver_sobra();
+    };
+  } // namespace detalhe
+
+  /*
+  Mesmo treino, consumindo um intervalo de iteradores de nn::Amostra (por
+  exemplo, um gerador ou um arquivo lido aos poucos).
+  */
+  template <typename Iterador>
+  ResultadoFluxo treinar_fluxo(Sequencial &rede, Iterador inicio, Iterador fim, const ConfigFluxo &config)
+  {
+    ResultadoFluxo resultado;
+    detalhe::LoteFluxo lote(config.tamanho_lote);
+
+    for (; inicio != fim; ++inicio)
+    {
+      const Amostra &amostra = *inicio;
+      lote.adicionar(amostra.entrada, amostra.saida);
+      resultado.amostras++;
+
+      if (lote.cheio())
+        lote.atualizar(rede, config, resultado);
+    }
+
+    if (!lote.vazio())
+      lote.atualizar(rede, config, resultado);
+
+    return resultado;
+  }
+
+} // namespace nn
+
+#endif // _FLUXO_H
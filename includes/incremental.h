@@ -0,0 +1,95 @@
+#ifndef _INCREMENTAL_H
+#define _INCREMENTAL_H
+
+#include "rede_neural.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace nn
+{
+  /*
+  Inferência incremental para entradas que mudam pouco de uma chamada para
+  a outra (ex.: um desenho sendo feito, um sensor que varia devagar).
+
+  Guarda os logits da primeira camada de conexões. Quando só algumas
+  entradas mudam, cada uma soma Δx_k * W[k] a eles (uma linha contínua de
+  m_pesos[0]), em vez de refazer o produto inteiro; só as camadas seguintes,
+  em geral bem menores, são recalculadas.
+
+  Ex.: com {784, 32, 32, 10}, mudar 25 pixels custa 25 * 32 operações na
+  primeira camada, em vez de 784 * 32.
+
+  O objeto começa com a entrada toda em zero (como um desenho em branco):
+  'atualizar' pode ser chamado logo depois do construtor.
+
+  Os logits guardados ficam presos aos pesos do momento em que 'iniciar'
+  foi chamado: depois de treinar ou carregar outra rede, chame 'iniciar' de
+  novo. A primeira camada usa sempre os pesos em double, mesmo com
+  set_precisao_pesos em 16 bits. Cada objeto tem a sua própria área de
+  trabalho, então pode rodar em paralelo com o feed_forward da rede (mas
+  não com o treino).
+
+  Nas redes convolucionais (ver Conv2D) um pixel mudado se espalha pelas
+  camadas de imagem: a rede é sempre calculada inteira, como no
+  feed_forward, e a interface continua a mesma.
+  */
+  class InferenciaIncremental
+  {
+  public:
+    explicit InferenciaIncremental(const Sequencial &rede);
+
+    /*
+    Calcula a rede inteira para 'entrada' e guarda o estado. Retorna a saída
+    ativada, válida até a próxima chamada. Lança std::invalid_argument se a
+    entrada tiver o tamanho errado.
+    */
+    const Vetor &iniciar(const Vetor &entrada);
+
+    /*
+    Soma deltas[i] à entrada indices[i] (i < n) e retorna a nova saída.
+    Índices repetidos são somados. Lança std::out_of_range para um índice
+    fora da entrada.
+    */
+    const Vetor &atualizar(const size_t *indices, const double *deltas, size_t n);
+    const Vetor &atualizar(const std::vector<size_t> &indices, const Vetor &deltas);
+
+    // Troca a entrada inteira, aplicando só as posições que mudaram
+    const Vetor &atualizar(const Vetor &nova_entrada);
+
+    // Entrada atual (com todos os deltas já aplicados)
+    const Vetor &get_entrada() const { return m_rede.m_extrator.empty() ? m_area.ativacoes[0] : m_imagem; }
+
+    // Saída ativada atual
+    const Vetor &get_saida() const { return m_area.ativacoes.back(); }
+
+    /*
+    A soma repetida de deltas acumula erros de arredondamento: a cada
+    'intervalo' atualizações, a primeira camada é recalculada do zero
+    (0 = nunca). O padrão é 1000.
+    */
+    void set_intervalo_recalculo(size_t intervalo) { m_intervalo_recalculo = intervalo; }
+
+  private:
+    const Sequencial &m_rede;
+    Sequencial::AreaTrabalho m_area;
+
+    size_t m_atualizacoes = 0;
+    size_t m_intervalo_recalculo = 1000;
+
+    // Entrada atual das redes convolucionais
+    Vetor m_imagem;
+
+    // Soma 'delta' à entrada k e delta * W[k] aos logits da primeira camada
+    void aplicar(size_t k, double delta);
+
+    // Primeira camada do zero, a partir de m_area.ativacoes[0]
+    void recalcular_primeira_camada();
+
+    // Ativa a primeira camada e propaga pelas seguintes
+    const Vetor &propagar_restante();
+  };
+
+} // namespace nn
+
+#endif // _INCREMENTAL_H
@@ -0,0 +1,100 @@
+#ifndef _MATEMATICA_H
+#define _MATEMATICA_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nn
+{
+  /*
+  Precisão das funções vetorizadas abaixo:
+
+  PRECISA - erro relativo <= 1e-15 em exp/sigmoid, erro absoluto <= 1e-15 em
+            log/tanh (praticamente igual a std::exp/std::log/std::tanh)
+  RAPIDA  - polinômios menores: erro relativo <= 2e-7 em exp/sigmoid e erro
+            absoluto <= 5e-7 em log/tanh. Suficiente para treino e inferência.
+
+  Em ambos os modos, exp satura em 0 abaixo de -708 e em +inf acima de 709,
+  e log(x) para x <= 0 retorna -inf.
+  */
+  enum class PrecisaoMatematica
+  {
+    PRECISA,
+    RAPIDA
+  };
+
+  // Vale para todas as threads; o padrão é PRECISA
+  void set_precisao_matematica(PrecisaoMatematica precisao);
+  PrecisaoMatematica get_precisao_matematica();
+
+  /*
+  Funções aplicadas em 'n' valores de uma vez (y pode ser igual a x).
+  Processam 2 (SSE2) ou 4 (AVX) doubles por instrução quando o compilador tem
+  extensões vetoriais (GCC/Clang); caso contrário, o mesmo algoritmo roda escalar.
+  */
+  void exp_vetor(const double *x, double *y, size_t n);
+  void log_vetor(const double *x, double *y, size_t n);
+  void tanh_vetor(const double *x, double *y, size_t n);
+  void sigmoid_vetor(const double *x, double *y, size_t n);
+  void relu_vetor(const double *x, double *y, size_t n);
+
+  /*
+  Derivadas calculadas a partir das ativações já guardadas no feed_forward,
+  sem nenhuma função transcendental. Multiplicam 'delta' no lugar:
+  delta[i] *= f'(x[i]), escrito em termos de a[i] = f(x[i]).
+  */
+  void multiplicar_derivada_tanh(const double *ativacoes, double *delta, size_t n);    // 1 - a²
+  void multiplicar_derivada_sigmoid(const double *ativacoes, double *delta, size_t n); // a (1 - a)
+  void multiplicar_derivada_relu(const double *ativacoes, double *delta, size_t n);    // a > 0
+
+  /*
+  Formato dos pesos usados no feed_forward:
+
+  DOUBLE - 64 bits (o padrão)
+  FP16   - IEEE 754 binary16: 11 bits de mantissa, valores até 65504
+  BF16   - bfloat16: os 16 bits altos de um float; mesma faixa do float, 8 bits de mantissa
+
+  Os formatos de 16 bits leem 4x menos memória que double no produto
+  matriz-vetor, que é o que limita a inferência de uma amostra por vez.
+  */
+  enum class PrecisaoPesos
+  {
+    DOUBLE,
+    FP16,
+    BF16
+  };
+
+  /*
+  Conversões entre double/float e 16 bits (guardados em uint16_t), com
+  arredondamento para o mais próximo. Usam as instruções F16C (FP16) e
+  AVX512-BF16 (BF16) quando a compilação as habilita (ver NN_NATIVO no CMake).
+  De double, o valor passa antes por float. Com AVX512-BF16, valores
+  subnormais (abaixo de ~1e-38) viram zero em BF16.
+  */
+  void converter_para_meia(PrecisaoPesos formato, const double *x, uint16_t *y, size_t n);
+  void converter_de_meia(PrecisaoPesos formato, const uint16_t *x, float *y, size_t n);
+
+  /*
+  Produto matriz-vetor com a matriz em 16 bits: para cada j em [inicio, fim),
+  y[j] = soma_k pesos[j * n_colunas + k] * x[k]. Os pesos viram float nos
+  registradores e a soma é acumulada em float.
+  */
+  void produto_matriz_meia(PrecisaoPesos formato, const uint16_t *pesos, const float *x, size_t n_colunas,
+                           size_t inicio, size_t fim, double *y);
+
+  /*
+  Produto de matrizes guardadas por linhas: C (m x n) = op(A) * op(B), com
+  op(A) m x k e op(B) k x n. Com 'transpor_a', A é guardada k x m (e lida
+  transposta, sem cópia); com 'transpor_b', B é guardada n x k. Com
+  'acumular', o produto é somado a C em vez de sobrescrevê-la.
+
+  Os laços internos percorrem linhas contínuas (vetorizados pelo
+  compilador), em blocos de k que cabem na cache. Usado pelas camadas de
+  convolução (im2col + GEMM, ver convolucao.h).
+  */
+  void produto_matrizes(const double *a, bool transpor_a, const double *b, bool transpor_b, double *c,
+                        size_t m, size_t k, size_t n, bool acumular = false);
+
+} // namespace nn
+
+#endif // _MATEMATICA_H
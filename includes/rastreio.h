@@ -0,0 +1,93 @@
+#ifndef _RASTREIO_H
+#define _RASTREIO_H
+
+#include <cstdint>
+#include <string>
+
+namespace nn
+{
+  /*
+  Rastreio de intervalos (spans) para ver onde o tempo de um passo de treino
+  é gasto, sem profiler externo.
+
+  Só existe quando compilado com NN_RASTREIO (opção do CMake de mesmo
+  nome). Sem ela, NN_SPAN não gera código nenhum. Com ela, cada thread grava
+  os seus intervalos num buffer circular próprio, sem travas (os mais
+  antigos são sobrescritos quando ele enche), e 'salvar' escreve tudo no
+  formato trace-event do Chrome: abra o arquivo em https://ui.perfetto.dev
+  ou chrome://tracing. Cada thread vira uma linha, então dá para ver a
+  ocupação do pool, o tempo de cada camada e as esperas entre os blocos de
+  um paralelo_para.
+
+  Se a variável de ambiente NN_RASTREIO_ARQUIVO estiver definida, o rastreio
+  é salvo nela ao fim do programa.
+
+  Ex.:
+    void Sequencial::otimizar(...)
+    {
+        NN_SPAN("otimizar");
+        ...
+    }
+
+    NN_SPAN("forward camada", i); // 'i' aparece nos argumentos do evento
+  */
+  namespace rastreio
+  {
+#ifdef NN_RASTREIO
+    constexpr bool habilitado = true;
+#else
+    constexpr bool habilitado = false;
+#endif
+
+    // Nanossegundos desde o início do rastreio (relógio monotônico)
+    uint64_t agora_ns();
+
+    // Grava um intervalo já terminado. 'nome' deve ser uma string estática
+    // (ex.: um literal): só o ponteiro é guardado
+    void registrar(const char *nome, int64_t argumento, uint64_t inicio_ns, uint64_t fim_ns);
+
+    // Nome da thread atual no rastreio (o padrão é "thread N")
+    void nomear_thread(const std::string &nome);
+
+    /*
+    Escreve os intervalos guardados em 'caminho' (JSON trace-event).
+    Retorna false se o arquivo não puder ser escrito. Chame com as threads
+    paradas: intervalos gravados durante a escrita podem sair incompletos.
+    */
+    bool salvar(const std::string &caminho);
+
+    // Descarta os intervalos gravados até agora (mesma restrição de 'salvar')
+    void limpar();
+
+    // Intervalo do construtor ao destrutor (use através de NN_SPAN)
+    class Span
+    {
+    public:
+      explicit Span(const char *nome, int64_t argumento = -1)
+          : m_nome(nome), m_argumento(argumento), m_inicio(agora_ns()) {}
+
+      ~Span() { registrar(m_nome, m_argumento, m_inicio, agora_ns()); }
+
+      Span(const Span &) = delete;
+      Span &operator=(const Span &) = delete;
+
+    private:
+      const char *m_nome;
+      int64_t m_argumento;
+      uint64_t m_inicio;
+    };
+  } // namespace rastreio
+
+} // namespace nn
+
+#ifdef NN_RASTREIO
+#define NN_CONCATENAR_(a, b) a##b
+#define NN_CONCATENAR(a, b) NN_CONCATENAR_(a, b)
+#define NN_SPAN(...) ::nn::rastreio::Span NN_CONCATENAR(nn_span_, __LINE__)(__VA_ARGS__)
+#define NN_NOMEAR_THREAD(nome) ::nn::rastreio::nomear_thread(nome)
+#else
+#define NN_SPAN(...) ((void)0)
+#define NN_NOMEAR_THREAD(nome) ((void)0)
+#endif
+
+#endif // _RASTREIO_H
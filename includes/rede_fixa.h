@@ -0,0 +1,360 @@
+#ifndef _REDE_FIXA_H
+#define _REDE_FIXA_H
+
+#include "rede_neural.h"
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+
+namespace nn
+{
+  /*
+  Ativações e camadas de saída como tipos, para que a SequencialFixa possa
+  inlinar tudo. Cada uma sabe o nome usado no arquivo de modelo e qual é a
+  equivalente dinâmica (usada nas conversões com Sequencial).
+  */
+  namespace fixa
+  {
+    struct ReLU
+    {
+      static constexpr const char *nome = "ReLU";
+      static double aplicar(double x) { return x > 0.0 ? x : 0.0; }
+      static const func &dinamica() { return nn::ReLU; }
+    };
+
+    struct Tanh
+    {
+      static constexpr const char *nome = "tanh";
+      static double aplicar(double x) { return std::tanh(x); }
+      static const func &dinamica() { return nn::tanh; }
+    };
+
+    struct Sigmoid
+    {
+      static constexpr const char *nome = "sigmoid";
+      static double aplicar(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+      static const func &dinamica() { return nn::sigmoid; }
+    };
+
+    struct SCE
+    {
+      static constexpr const char *tipo = "SCE";
+
+      template <size_t N>
+      static void ativar(double *saida)
+      {
+        double max_val = *std::max_element(saida, saida + N);
+
+        double soma = 0.0;
+        for (size_t i = 0; i < N; i++)
+        {
+          saida[i] = std::exp(saida[i] - max_val);
+          soma += saida[i];
+        }
+
+        for (size_t i = 0; i < N; i++)
+          saida[i] /= soma;
+      }
+    };
+
+    struct LMSE
+    {
+      static constexpr const char *tipo = "LMSE";
+
+      template <size_t N>
+      static void ativar(double *) {} // linear
+    };
+
+    // Posições de cada camada nos arrays de parâmetros
+    template <size_t N>
+    constexpr size_t inicio_pesos(const std::array<size_t, N> &topologia, size_t L)
+    {
+      size_t inicio = 0;
+      for (size_t i = 0; i < L; i++)
+        inicio += topologia[i] * topologia[i + 1];
+      return inicio;
+    }
+
+    template <size_t N>
+    constexpr size_t inicio_biases(const std::array<size_t, N> &topologia, size_t L)
+    {
+      size_t inicio = 0;
+      for (size_t i = 0; i < L; i++)
+        inicio += topologia[i + 1];
+      return inicio;
+    }
+
+    // Largura da maior camada oculta (tamanho dos buffers intermediários)
+    template <size_t N>
+    constexpr size_t maior_camada_oculta(const std::array<size_t, N> &topologia)
+    {
+      size_t maior = 1;
+      for (size_t i = 1; i + 1 < N; i++)
+        maior = topologia[i] > maior ? topologia[i] : maior;
+      return maior;
+    }
+  } // namespace fixa
+
+  /*
+  Rede sequencial com a topologia fixada em tempo de compilação.
+
+  Ex.: nn::SequencialFixa<nn::fixa::ReLU, nn::fixa::SCE, 2, 8, 2>
+
+  Todos os parâmetros ficam em std::array dentro do objeto (nenhuma alocação
+  no heap) e os tamanhos das camadas são constantes, então o compilador pode
+  desenrolar e vetorizar os laços. Não há std::function, funções virtuais nem
+  threads: é feita para embutir modelos pequenos onde a latência importa.
+
+  Só faz inferência. Para treinar, converta de/para Sequencial (ou carregue
+  um arquivo salvo por ela: o formato é o mesmo).
+  */
+  template <class Ativacao, class Saida, size_t... TAMANHOS>
+  class SequencialFixa
+  {
+    static_assert(sizeof...(TAMANHOS) >= 2, "a rede precisa de pelo menos uma camada de entrada e uma de saída");
+
+  public:
+    static constexpr size_t n_camadas = sizeof...(TAMANHOS);
+    static constexpr std::array<size_t, n_camadas> topologia{TAMANHOS...};
+    static constexpr size_t n_entradas = topologia.front();
+    static constexpr size_t n_saidas = topologia.back();
+    static constexpr size_t n_pesos = fixa::inicio_pesos(topologia, n_camadas - 1);
+    static constexpr size_t n_biases = fixa::inicio_biases(topologia, n_camadas - 1);
+
+    // Todos os pesos e biases começam em zero
+    SequencialFixa() : m_pesos{}, m_biases{} {}
+
+    // Copia os parâmetros de uma Sequencial com a mesma topologia e ativações
+    explicit SequencialFixa(const Sequencial &rede) { copiar_de(rede); }
+
+    // Carrega um arquivo salvo por Sequencial::salvar_rede
+    explicit SequencialFixa(const std::string &caminho)
+    {
+      if (!carregar_rede(caminho))
+        throw std::invalid_argument("arquivo inválido ou com topologia/ativações diferentes: " + caminho);
+    }
+
+    /*
+    Calcula a saída da rede. Os buffers intermediários ficam na pilha, então
+    pode ser chamado de várias threads ao mesmo tempo.
+    */
+    void feed_forward(const double *entrada, double *saida) const
+    {
+      logits(entrada, saida);
+      Saida::template ativar<n_saidas>(saida);
+    }
+
+    std::array<double, n_saidas> feed_forward(const std::array<double, n_entradas> &entrada) const
+    {
+      std::array<double, n_saidas> saida;
+      feed_forward(entrada.data(), saida.data());
+      return saida;
+    }
+
+    // Índice da maior saída, direto dos logits (sem a ativação de saída)
+    size_t prever_classe(const double *entrada) const
+    {
+      std::array<double, n_saidas> saida;
+      logits(entrada, saida.data());
+      return std::max_element(saida.begin(), saida.end()) - saida.begin();
+    }
+
+    // Logits de saída (antes da ativação de saída)
+    void logits(const double *entrada, double *saida) const
+    {
+      std::array<double, fixa::maior_camada_oculta(topologia)> a, b;
+      propagar<0>(entrada, saida, a.data(), b.data());
+    }
+
+    /*
+    ===============
+      CONVERSÕES
+    ===============
+    */
+
+    // Cria uma Sequencial equivalente (ex.: para continuar o treino)
+    std::unique_ptr<Sequencial> para_sequencial() const
+    {
+      std::vector<size_t> topologia_dinamica(topologia.begin(), topologia.end());
+      auto rede = std::make_unique<Sequencial>(topologia_dinamica, Saida::tipo, Ativacao::dinamica());
+      copiar_para(*rede);
+      return rede;
+    }
+
+    // Copia os parâmetros para uma Sequencial que já tem a mesma topologia
+    // (as ativações dela passam a ser as desta rede)
+    void copiar_para(Sequencial &rede) const
+    {
+      verificar_topologia(rede);
+
+      if (std::string(Saida::tipo) == "SCE")
+        rede.set_func(Ativacao::dinamica(), std::make_unique<SoftmaxCrossEntropy>());
+      else
+        rede.set_func(Ativacao::dinamica(), std::make_unique<LinearMeanSquareError>());
+
+      // Esta rede não tem normalização em lote
+      for (size_t i = 1; i + 1 < n_camadas; i++)
+      {
+        if (rede.get_normalizacao(i).ligada())
+          rede.set_normalizacao(i, false);
+      }
+
+      for (size_t L = 0; L + 1 < n_camadas; L++)
+      {
+        Matriz pesos(topologia[L], Vetor(topologia[L + 1]));
+        for (size_t k = 0; k < topologia[L]; k++)
+          for (size_t j = 0; j < topologia[L + 1]; j++)
+            pesos[k][j] = m_pesos[inicio_pesos(L) + k * topologia[L + 1] + j];
+
+        rede.set_pesos(L, pesos);
+        rede.set_biases(L, Vetor(m_biases.begin() + inicio_biases(L),
+                                 m_biases.begin() + inicio_biases(L) + topologia[L + 1]));
+      }
+    }
+
+    // Lança std::invalid_argument se a topologia ou as ativações forem diferentes
+    void copiar_de(const Sequencial &rede)
+    {
+      verificar_topologia(rede);
+
+      // Só camadas densas (como no compilar_modelo)
+      if (!rede.get_extrator().empty())
+        throw std::invalid_argument("a SequencialFixa não suporta camadas de imagem");
+
+      if (std::string(rede.get_func_oculta().nome) != Ativacao::nome || rede.get_camada_saida().get_tipo() != Saida::tipo)
+        throw std::invalid_argument("as ativações da rede são diferentes das da SequencialFixa");
+
+      // Uma única ativação para todas as ocultas (ver set_ativacao_camada)
+      for (size_t i = 1; i + 1 < n_camadas; i++)
+      {
+        if (std::string(rede.get_ativacao_camada(i).nome) != Ativacao::nome)
+          throw std::invalid_argument("a camada " + std::to_string(i) + " tem uma ativação diferente da SequencialFixa");
+      }
+
+      // A normalização em lote é incorporada aos pesos de uma cópia (como no compilar_modelo)
+      for (size_t i = 1; i + 1 < n_camadas; i++)
+      {
+        if (!rede.get_normalizacao(i).ligada())
+          continue;
+
+        Sequencial copia(rede.get_topologia(), Saida::tipo, Ativacao::dinamica());
+        copia = rede;
+        copia.incorporar_normalizacao();
+        copiar_de(copia);
+        return;
+      }
+
+      for (size_t L = 0; L + 1 < n_camadas; L++)
+      {
+        const Matriz &pesos = rede.get_pesos(L);
+        for (size_t k = 0; k < topologia[L]; k++)
+          std::copy(pesos[k].begin(), pesos[k].end(), m_pesos.begin() + inicio_pesos(L) + k * topologia[L + 1]);
+
+        const Vetor &biases = rede.get_biases(L + 1); // camada L+1
+        std::copy(biases.begin(), biases.end(), m_biases.begin() + inicio_biases(L));
+      }
+    }
+
+    /*
+    ===============================================
+      MÉTODOS DE PERSISTENCIA (SALVAR E CARREGAR)
+    ===============================================
+    Mesmo formato de Sequencial (feitos através dela).
+    */
+
+    bool salvar_rede(const std::string &caminho) const
+    {
+      return para_sequencial()->salvar_rede(caminho);
+    }
+
+    // Retorna false se o arquivo não existir, for inválido ou tiver outra topologia/ativação
+    bool carregar_rede(const std::string &caminho)
+    {
+      try
+      {
+        Sequencial rede(caminho);
+        copiar_de(rede);
+      }
+      catch (const std::exception &)
+      {
+        return false;
+      }
+      return true;
+    }
+
+    /*
+    ===========
+      ACESSO
+    ===========
+    Mesmo layout de Sequencial: o peso do neurônio k da camada L para o
+    neurônio j da camada L+1 é peso(L, k, j).
+    */
+
+    double &peso(size_t L, size_t k, size_t j) { return m_pesos[inicio_pesos(L) + k * topologia[L + 1] + j]; }
+    double peso(size_t L, size_t k, size_t j) const { return m_pesos[inicio_pesos(L) + k * topologia[L + 1] + j]; }
+
+    // Bias do neurônio j da camada L+1
+    double &bias(size_t L, size_t j) { return m_biases[inicio_biases(L) + j]; }
+    double bias(size_t L, size_t j) const { return m_biases[inicio_biases(L) + j]; }
+
+  private:
+    static void verificar_topologia(const Sequencial &rede)
+    {
+      const std::vector<size_t> &topologia_dinamica = rede.get_topologia();
+
+      if (!std::equal(topologia.begin(), topologia.end(), topologia_dinamica.begin(), topologia_dinamica.end()))
+        throw std::invalid_argument("a topologia da rede é diferente da SequencialFixa");
+    }
+
+    static constexpr size_t inicio_pesos(size_t L) { return fixa::inicio_pesos(topologia, L); }
+    static constexpr size_t inicio_biases(size_t L) { return fixa::inicio_biases(topologia, L); }
+
+    // Camada de conexões L: lê 'entrada' e escreve em 'livre' (ou em 'saida', na última)
+    template <size_t L>
+    void propagar(const double *entrada, double *saida, double *livre, double *outro) const
+    {
+      constexpr size_t ORIGEM = topologia[L];
+      constexpr size_t DESTINO = topologia[L + 1];
+      constexpr bool ULTIMA = L + 2 == n_camadas;
+
+      const double *pesos = m_pesos.data() + inicio_pesos(L);
+      const double *biases = m_biases.data() + inicio_biases(L);
+      double *destino = ULTIMA ? saida : livre;
+
+      // Acumula num array local: sem risco de aliasing com os pesos, o
+      // compilador mantém as somas em registradores
+      std::array<double, DESTINO> soma;
+      for (size_t j = 0; j < DESTINO; j++)
+        soma[j] = biases[j];
+
+      // Linha a linha: o laço interno percorre memória contínua
+      for (size_t k = 0; k < ORIGEM; k++)
+      {
+        const double x = entrada[k];
+        for (size_t j = 0; j < DESTINO; j++)
+          soma[j] += x * pesos[k * DESTINO + j];
+      }
+
+      for (size_t j = 0; j < DESTINO; j++)
+        destino[j] = soma[j];
+
+      if constexpr (!ULTIMA)
+      {
+        for (size_t j = 0; j < DESTINO; j++)
+          destino[j] = Ativacao::aplicar(destino[j]);
+
+        propagar<L + 1>(destino, saida, outro, livre);
+      }
+    }
+
+    std::array<double, n_pesos> m_pesos;
+    std::array<double, n_biases> m_biases;
+  };
+
+} // namespace nn
+
+#endif // _REDE_FIXA_H
@@ -2,10 +2,18 @@
 #define _REDE_NEURAL_H
 
 #include "camadas_saida.h"
+#include "agenda_taxa.h"
+#include "execucao.h"
+#include "autoajuste.h"
+#include "escalonador.h"
+#include "distribuido.h"
+#include "matematica.h"
+#include "dados.h"
 #include <vector>
 #include <string>
 #include <functional>
 #include <memory>
+#include <map>
 
 namespace nn
 {
@@ -18,11 +26,109 @@ namespace nn
     std::function<double(double)> funcao;
     std::function<double(double)> derivada;
 
+    /*
+    Opcionais (ver matematica.h). Com 'funcao_vetor', a ativação é aplicada
+    na camada inteira de uma vez. Com 'multiplicar_derivada', o backward usa
+    a derivada escrita em termos da saída ativada (ex.: 1 - a² para tanh),
+    sem recalcular funções transcendentais.
+    */
+    void (*funcao_vetor)(const double *x, double *y, size_t n) = nullptr;
+    void (*multiplicar_derivada)(const double *ativacoes, double *delta, size_t n) = nullptr;
+
     func(
       const char* nome,
       std::function<double(double)> fn,
-      std::function<double(double)> dfn
-    ): nome(nome), funcao(fn), derivada(dfn) {}
+      std::function<double(double)> dfn,
+      void (*fn_vetor)(const double*, double*, size_t) = nullptr,
+      void (*dfn_ativacao)(const double*, double*, size_t) = nullptr
+    ): nome(nome), funcao(fn), derivada(dfn), funcao_vetor(fn_vetor), multiplicar_derivada(dfn_ativacao) {}
+  };
+
+  /*
+  Opções do treino.
+  Os quatro primeiros campos são os mesmos parâmetros da versão posicional do train.
+  */
+  struct ConfigTreino
+  {
+    double taxa_aprendizagem = 1e-3;
+    size_t janela_analise = 100;
+    double target_loss = 0.0;
+    double threshold = 1e-5;
+
+    // Número máximo de épocas (0 = sem limite)
+    size_t max_epocas = 0;
+
+    // Agenda da taxa de aprendizagem (nullptr = taxa constante)
+    // Ex.: std::make_shared<DecaimentoCosseno>(20)
+    std::shared_ptr<const AgendaTaxa> agenda;
+
+    // Redução no platô: multiplica a taxa por 'fator_plateau' depois de
+    // 'paciencia_plateau' épocas sem melhora no loss de validação (0 = desligado)
+    size_t paciencia_plateau = 0;
+    double fator_plateau = 0.5;
+    double taxa_minima = 0.0;
+
+    // Parada antecipada: termina depois de 'paciencia' épocas sem melhorar o
+    // melhor loss de validação em pelo menos 'melhora_minima' (0 = desligado)
+    size_t paciencia = 0;
+    double melhora_minima = 0.0;
+
+    // Termina quando a precisão de validação chega a este valor (0 = desligado)
+    double target_accuracy = 0.0;
+
+    // Embaralha a ordem das amostras de treino a cada época (só os índices,
+    // ver VisaoDados). 'semente' = 0 usa uma semente aleatória
+    bool embaralhar = true;
+    uint64_t semente = 0;
+
+    // Imprime o progresso de cada época
+    bool verbose = true;
+  };
+
+  // O que aconteceu num treino
+  struct ResultadoTreino
+  {
+    size_t epocas = 0;
+    size_t melhor_epoca = 0;
+    double melhor_perda = 0.0;
+    bool precisao_atingida = false;
+    double segundos = 0.0;
+  };
+
+  /*
+  Normalização em lote (batch normalization) dos logits z de uma camada
+  oculta, antes da ativação:
+    y = gama * (z - média) / sqrt(variância + epsilon) + beta
+
+  No treino em mini-lotes, média e variância são as do lote, e as médias
+  móveis (com 'momento') são atualizadas a cada lote. Na inferência (e nos
+  lotes de uma amostra só) as médias móveis são usadas.
+  */
+  struct NormalizacaoLote
+  {
+    Vetor gama, beta;       // treinados pelo Adam
+    Vetor media, variancia; // médias móveis
+    double momento = 0.1;
+    double epsilon = 1e-5;
+
+    bool ligada() const { return !gama.empty(); }
+  };
+
+  // Bytes ocupados por cada parte de uma rede (ver Sequencial::uso_memoria)
+  struct UsoMemoria
+  {
+    size_t pesos = 0;         // m_pesos (double)
+    size_t biases = 0;        // m_biases e os parâmetros da normalização em lote
+    size_t pesos_meia = 0;    // cópia em 16 bits (set_precisao_pesos)
+    size_t gradientes = 0;    // gradientes de pesos e biases (e buffers do treino distribuído)
+    size_t otimizador = 0;    // momentos do Adam
+    size_t area_trabalho = 0; // buffers do feed_forward/backward
+    size_t pipeline = 0;      // áreas de trabalho por amostra do treino em micro-lotes
+
+    size_t total() const
+    {
+      return pesos + biases + pesos_meia + gradientes + otimizador + area_trabalho + pipeline;
+    }
   };
 
   extern std::unique_ptr<CamadaSaida> camada_saida_padrao;
@@ -30,6 +136,10 @@ namespace nn
   extern const func tanh;
   extern const func sigmoid;
 
+  // Camadas de imagem (convolucao.h)
+  class CamadaImagem;
+  struct Formato3D;
+
   // Implementação de uma rede neural sequencial
   class Sequencial
   {
@@ -70,6 +180,33 @@ namespace nn
     */
     Sequencial(const std::string &caminho);
 
+    /*
+    Rede convolucional: as camadas de imagem (Conv2D, MaxPool2D, Flatten;
+    ver convolucao.h) vêm antes das camadas densas. As entradas têm o
+    formato 'formato_entrada' (CHW) e 'camadas_densas' são os tamanhos das
+    camadas depois do extrator, sem a de entrada: ela é a saída achatada da
+    última camada de imagem (get_topologia()[0]).
+
+    Ex.:
+      std::vector<std::unique_ptr<nn::CamadaImagem>> extrator;
+      extrator.push_back(std::make_unique<nn::Conv2D>(8, 3));
+      extrator.push_back(std::make_unique<nn::MaxPool2D>(2));
+      extrator.push_back(std::make_unique<nn::Flatten>());
+      nn::Sequencial rede({1, 28, 28}, std::move(extrator), {32, 10}, "SCE", nn::ReLU);
+
+    O treino em micro-lotes (n_micro_lotes > 1), o treino distribuído, a
+    inferência incremental e compilar_modelo só aceitam redes sem extrator.
+    */
+    Sequencial(
+        const Formato3D &formato_entrada,
+        std::vector<std::unique_ptr<CamadaImagem>> extrator,
+        const std::vector<size_t> &camadas_densas,
+        std::string camada_saida_str,
+        func funcao_ativacao_oculta
+      );
+
+    ~Sequencial();
+
     /*
     =====================================
       MÉTODOS DE FUNCIONALIDADE DA REDE
@@ -79,9 +216,31 @@ namespace nn
     /*
     Calcula o resultado da rede para uma dada entrada.
     O vetor de entrada deve ter o mesmo tamanho da camada de entrada da rede.
-    Retorna um vetor com os valores da camada de saída.
+    Retorna uma referência para os valores da camada de saída, que fica válida
+    até a próxima chamada de feed_forward (copie-a se precisar guardá-la).
+
+    Nenhuma alocação é feita aqui: todos os buffers intermediários são
+    reservados uma única vez a partir da topologia.
+    */
+    const Vetor &feed_forward(const Vetor &entradas) const;
+
+    /*
+    Inferência de classificação: índice da maior saída. Calculado direto dos
+    logits, sem a ativação de saída (nem o exp do softmax), que não muda a
+    ordem dos valores. Lança std::invalid_argument se a entrada tiver o
+    tamanho errado.
+    */
+    size_t prever_classe(const Vetor &entradas) const;
+
+    // As 'k' classes mais prováveis, da maior para a menor, escritas em 'indices'
+    void prever_top_k(const Vetor &entradas, size_t k, std::vector<size_t> &indices) const;
+
+    /*
+    Classe prevista para cada uma das entradas, em paralelo: cada bloco de
+    amostras usa a sua própria área de trabalho. 'classes' é redimensionado.
+    Lança std::invalid_argument se alguma entrada tiver o tamanho errado.
     */
-    Vetor feed_forward(const Vetor &entradas) const;
+    void prever_classes(const std::vector<Vetor> &entradas, std::vector<size_t> &classes) const;
 
     /*
     Função para treinar a rede neural com dados pré-estabelecidos
@@ -100,6 +259,35 @@ namespace nn
                const std::vector<Vetor> &entradas_validacao, const std::vector<Vetor> &saidas_validacao,
                double taxa_aprendizagem, size_t janela_analise = 100, double target_loss = 0.0, double threshold = 1e-5);
 
+    /*
+    Mesmo treino, com as opções de agenda da taxa, redução no platô e parada
+    antecipada (ver ConfigTreino). Os pesos finais são os da época com o
+    melhor loss de validação.
+    */
+    ResultadoTreino train(const std::vector<Vetor> &entradas_treino, const std::vector<Vetor> &saidas_treino,
+                          const std::vector<Vetor> &entradas_validacao, const std::vector<Vetor> &saidas_validacao,
+                          const ConfigTreino &config);
+
+    /*
+    Mesmo treino, a partir de visões dos dados (ver dados.h): separar treino
+    e validação, fatiar e embaralhar não copiam nenhuma amostra.
+    */
+    ResultadoTreino train(const VisaoDados &treino, const VisaoDados &validacao, const ConfigTreino &config);
+
+    /*
+    Treino incremental (online): aplica UMA atualização do otimizador com a
+    média dos gradientes do lote e retorna o loss médio do lote (calculado
+    antes da atualização).
+
+    Não há laço de épocas, validação, cópia dos melhores pesos nem saída no
+    terminal, e nenhuma alocação depois da primeira chamada: o custo de cada
+    chamada depende só do tamanho do lote. Lotes de até 'tamanho_lote'
+    amostras usam o pipeline configurado em configurar_pipeline. Com
+    configurar_acumulacao(n), a atualização só é aplicada a cada n chamadas.
+    Ver também nn::treinar_fluxo (fluxo.h) para consumir amostras de uma fila.
+    */
+    double train_step(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas, double taxa_aprendizagem);
+
     /*
     Avalia o desempenho da rede
     */
@@ -107,6 +295,9 @@ namespace nn
 
     double calc_accuracy (const std::vector<Vetor>& entradas, const std::vector<Vetor>& saidas_esperadas) const;
 
+    double calc_loss(const VisaoDados &dados) const;
+    double calc_accuracy(const VisaoDados &dados) const;
+
     /*
     ===========================
       MÉTODOS DE PLASTICIDADE
@@ -129,10 +320,142 @@ namespace nn
     void remover_neuronio(int index_camada, int index_neuronio);
 
     /*
-    Muda as funções de ativação da rede
+    Muda as funções de ativação da rede (todas as camadas ocultas passam a
+    usar 'funcao_ativacao_oculta')
     */
     void set_func(func funcao_ativacao_oculta, std::unique_ptr<CamadaSaida> camada_saida);
 
+    /*
+    Ativação de uma camada oculta, no lugar da ativação oculta da rede.
+    @tparam index_camada deve ser uma camada oculta (de 1 a get_topologia().size() - 2).
+
+    Ex.: ReLU nas primeiras camadas e tanh na última oculta:
+      rede.set_ativacao_camada(2, nn::tanh);
+
+    É salva no arquivo do modelo (linhas ATIVACAO_CAMADA).
+    */
+    void set_ativacao_camada(size_t index_camada, func ativacao);
+
+    /*
+    Fixa o plano (kernel, bloco e threads; ver autoajuste.h) da camada de
+    pesos 'index_camada', no lugar do escolhido pelo autoajuste ou do
+    padrão. Ex.: POR_LINHA depois de uma camada ReLU, em que boa parte das
+    entradas é zero e é pulada. Não muda os resultados nem é salvo no
+    arquivo (depende da máquina); carregar outra rede desfaz.
+    */
+    void set_plano_camada(size_t index_camada, const PlanoCamada &plano);
+
+    /*
+    Liga (ou desliga) a normalização em lote (ver NormalizacaoLote) de uma
+    camada oculta, com gama = 1, beta = 0 e as médias móveis em 0 e 1.
+    @tparam index_camada deve ser uma camada oculta (de 1 a get_topologia().size() - 2).
+
+    As estatísticas do lote só existem no treino em mini-lotes:
+    configurar_pipeline(tamanho_lote) com tamanho_lote >= 2 e n_micro_lotes = 1
+    (ou train_step com lotes de 2 ou mais amostras). O treino distribuído
+    não é suportado. É salva no arquivo do modelo.
+    */
+    void set_normalizacao(size_t index_camada, bool ligada, double momento = 0.1, double epsilon = 1e-5);
+
+    /*
+    Incorpora a normalização de todas as camadas aos pesos e biases da
+    camada de pesos anterior e a desliga:
+      W'[k][j] = W[k][j] * s_j,  b'_j = (b_j - média_j) * s_j + beta_j,
+      com s_j = gama_j / sqrt(variância_j + epsilon)
+    O resultado da inferência é o mesmo (a menos de arredondamento), sem
+    nenhum custo da normalização. Para depois do treino (ex.: antes de
+    salvar o modelo que vai para produção).
+    */
+    void incorporar_normalizacao();
+
+    /*
+    Define o contexto de execução (threads, modo latência/vazão) usado pelos
+    kernels da rede. Por padrão é usado nn::contexto_padrao().
+    O contexto deve viver mais que a rede.
+    */
+    void set_contexto_execucao(ContextoExecucao &contexto);
+
+    /*
+    Autoajuste do forward (ver autoajuste.h). Ligado, cada camada usa o
+    kernel, o tamanho de bloco e o número de threads mais rápidos para o
+    seu formato nesta máquina: formatos ainda não vistos são medidos na
+    hora (alguns milissegundos cada) e gravados no cache, os outros só são
+    lidos dele. Os planos são refeitos ao carregar outra rede ou trocar o
+    contexto de execução. Só afeta os pesos em double (PrecisaoPesos::DOUBLE)
+    e não muda os resultados.
+    */
+    void set_autoajuste(bool ligado);
+
+    /*
+    Formato dos pesos no feed_forward (ver PrecisaoPesos em matematica.h).
+    Com FP16/BF16, uma cópia dos pesos em 16 bits é usada nos produtos, com
+    as somas em float; os biases continuam em double.
+
+    O treino continua funcionando: m_pesos (double) são os pesos mestres,
+    atualizados pelo otimizador e usados no backward, e a cópia em 16 bits é
+    refeita depois de cada atualização. O formato é salvo no arquivo do
+    modelo, com os pesos já arredondados para ele.
+    */
+    void set_precisao_pesos(PrecisaoPesos precisao);
+
+    /*
+    Modo somente inferência: libera tudo o que só o treino usa (gradientes,
+    momentos do Adam, deltas e áreas do pipeline), deixando apenas os pesos,
+    os biases e os buffers do feed_forward. Enquanto ligado, train e
+    train_step lançam std::logic_error.
+
+    Fora desse modo, o estado do treino é alocado na primeira chamada de
+    train/train_step, e não no construtor nem em carregar_rede. Desligar o
+    modo recomeça o Adam do zero.
+    */
+    void set_somente_inferencia(bool somente_inferencia);
+
+    /*
+    Configura o treino em mini-lotes.
+    @tparam tamanho_lote amostras por atualização do otimizador (1 = uma amostra por vez, o padrão)
+    @tparam n_micro_lotes em quantos micro-lotes cada lote é dividido. Com mais de um,
+    o forward e o backward de cada camada e micro-lote viram tarefas de um escalonador
+    com roubo de tarefas: camadas diferentes de micro-lotes diferentes rodam ao mesmo
+    tempo, sem a barreira entre camadas. Útil em redes profundas e estreitas, onde
+    paralelizar dentro de uma camada não compensa.
+    @tparam escalonador escalonador a ser usado (nullptr = nn::escalonador_padrao())
+    */
+    void configurar_pipeline(size_t tamanho_lote, size_t n_micro_lotes = 1, EscalonadorTarefas *escalonador = nullptr);
+
+    /*
+    Acumulação de gradientes: os gradientes de 'lotes_por_passo' lotes
+    seguidos são somados e o otimizador dá um único passo com a média de
+    todas as amostras. O lote efetivo fica lotes_por_passo * tamanho_lote
+    amostras, mas só um lote precisa caber na memória. No train, o último
+    passo de cada época usa os lotes que sobraram; no train_step, a
+    atualização é aplicada a cada 'lotes_por_passo' chamadas.
+    */
+    void configurar_acumulacao(size_t lotes_por_passo);
+
+    /*
+    Checkpoint de ativações no treino em micro-lotes (n_micro_lotes > 1), onde
+    cada amostra do lote guarda as suas ativações até o backward: com
+    'intervalo' = k, cada amostra guarda só as ativações das camadas 0, k,
+    2k... e um delta, e o backward recalcula o resto a partir do checkpoint
+    mais próximo (até k camadas de forward a mais por camada). 0 desliga.
+    */
+    void configurar_checkpoint(size_t intervalo);
+
+    /*
+    Treino distribuído: a rede passa a ser treinada em conjunto com os outros
+    processos do grupo. Cada processo deve chamar train com a sua fatia dos
+    dados (ver nn::fatia_dados), todas do mesmo tamanho.
+
+    Os pesos do rank 0 são copiados para os outros aqui. A cada passo, os
+    gradientes de cada camada entram no allreduce assim que o backward daquela
+    camada termina, enquanto as camadas anteriores ainda estão sendo
+    calculadas. O loss de validação também é a média entre os processos, para
+    que todos parem na mesma época. Só o rank 0 imprime o progresso.
+
+    nullptr volta ao treino local. O grupo deve viver mais que a rede.
+    */
+    void set_grupo_processos(GrupoProcessos *grupo);
+
     /*
     =====================================
       MÉTODOS PARA ALGORITMOS GENÉTICOS
@@ -180,9 +503,59 @@ namespace nn
     // é representado por {2, 3, 5, 2}
     const std::vector<size_t> &get_topologia() const;
 
+    // Tamanho das entradas da rede: o da imagem de entrada, se houver extrator,
+    // ou o da camada 0
+    size_t get_tamanho_entrada() const;
+
+    // Camadas de imagem antes das densas (vazio numa rede só densa)
+    const std::vector<std::unique_ptr<CamadaImagem>> &get_extrator() const;
+
+    ContextoExecucao &get_contexto_execucao() const;
+
+    // Plano de cada camada de pesos (o padrão, o do autoajuste ou o fixado)
+    const std::vector<PlanoCamada> &get_planos() const;
+
+    PrecisaoPesos get_precisao_pesos() const;
+
+    bool get_somente_inferencia() const;
+
+    // Memória ocupada por categoria (pesos, gradientes, otimizador...)
+    UsoMemoria uso_memoria() const;
+
+    // Funções de ativação em uso (ex.: para gerar código a partir da rede)
+    const func &get_func_oculta() const;
+    const func &get_ativacao_camada(size_t index_camada) const;
+    const CamadaSaida &get_camada_saida() const;
+
+    // Normalização de uma camada oculta (desligada se !ligada())
+    const NormalizacaoLote &get_normalizacao(size_t index_camada) const;
+
     Sequencial &operator=(const Sequencial &other);
 
   private:
+    // Usa a área de trabalho e os passos por camada (ver incremental.h)
+    friend class InferenciaIncremental;
+
+    /*
+    Área de trabalho com todos os buffers temporários de uma passada
+    (feed_forward + backpropagate). É dimensionada uma única vez a partir da
+    topologia, de modo que o laço de treino não faz alocações no heap.
+    */
+    struct AreaTrabalho
+    {
+      std::vector<Vetor> logits;    // somas ponderadas (antes da ativação) de cada camada
+      std::vector<Vetor> ativacoes; // saídas ativadas de cada camada, incluindo a entrada
+      std::vector<Vetor> deltas;    // sinais de erro de cada camada, calculados no backpropagate
+      std::vector<float> entrada_float; // ativações da camada atual em float (pesos em 16 bits)
+      std::vector<Vetor> normalizados;  // logits normalizados (x̂) das camadas com normalização
+
+      // Extrator: imagens[0] é a entrada e imagens[i + 1] a saída da camada
+      // de imagem i (copiada para ativacoes[0] no fim)
+      std::vector<Vetor> imagens;
+      std::vector<Vetor> auxiliares;     // buffer de cada camada de imagem (ex.: colunas do im2col)
+      std::vector<Vetor> deltas_imagens; // gradientes em relação a cada imagem (só no treino)
+    };
+
     // A topologia define a estrutura da rede, ex: {3, 5, 2}
     std::vector<size_t> m_topologia;
 
@@ -205,27 +578,176 @@ namespace nn
     */
     std::vector<Vetor> m_biases;
 
+    /*
+    Cópia de m_pesos em 16 bits, usada no feed_forward quando
+    m_precisao_pesos não é DOUBLE (vazia caso contrário). Cada camada é
+    transposta: m_pesos_meia[i][j * origem + k] é m_pesos[i][k][j], para que
+    a soma de cada neurônio leia memória contínua.
+    */
+    PrecisaoPesos m_precisao_pesos = PrecisaoPesos::DOUBLE;
+    std::vector<std::vector<uint16_t>> m_pesos_meia;
+
+    // Refaz m_pesos_meia a partir de m_pesos (chamado sempre que m_pesos muda)
+    void atualizar_pesos_meia();
+
     // Membros para armazenar os gradientes gerados pelo backpropagate
     std::vector<Matriz> m_gradientes_pesos;
     std::vector<Vetor> m_gradientes_biases;
 
-    // Membros para armazenar os valores intermediários do feed_forward
-    mutable std::vector<Vetor> m_logits;    // armazena as somas ponderadas (antes da ativação)
-    mutable std::vector<Vetor> m_ativacoes; // armazena as saídas ativadas de cada camada
+    // Área de trabalho padrão, usada pelas chamadas públicas de feed_forward
+    mutable AreaTrabalho m_area;
 
-    void backpropagate(const Vetor &saida_esperada);
+    // Dimensiona os buffers de uma área de trabalho de acordo com a topologia
+    // (os deltas só com 'treino')
+    void alocar_area_trabalho(AreaTrabalho &area, bool treino = false) const;
+
+    /*
+    Estado do treino: alocado sob demanda por preparar_treino (no início de
+    train/train_step) e liberado por liberar_estado_treino (modo somente
+    inferência, ou quando carregar_rede troca a topologia).
+    */
+    bool m_somente_inferencia = false;
+    void preparar_treino();
+    void liberar_estado_treino();
+
+    // Sem 'ativar_saida', retorna os logits de saída (o treino ativa a saída
+    // junto com o loss e o delta, em retropropagar_camada)
+    const Vetor &feed_forward(const Vetor &entradas, AreaTrabalho &area, bool ativar_saida = true) const;
+    void backpropagate(const Vetor &saida_esperada, AreaTrabalho &area);
+
+    // Passos de uma única camada de conexões (usados pelo pipeline)
+    void propagar_camada(size_t index_camada, AreaTrabalho &area, bool ativar_saida = true) const;
+    // Só os logits (a primeira metade de propagar_camada). Retorna true se a
+    // ativação foi fundida ao produto e a camada já está ativada
+    bool calcular_logits(size_t index_camada, AreaTrabalho &area) const;
+    // Só a ativação de area.logits[index_camada] (a segunda metade de propagar_camada)
+    void ativar_camada(size_t index_camada, AreaTrabalho &area, bool ativar_saida = true) const;
+
+    // Retorna o loss da amostra quando 'index_camada' é a última (0 nas outras)
+    double retropropagar_camada(size_t index_camada, const Vetor &saida_esperada, AreaTrabalho &area, bool acumular);
+    // As duas metades de retropropagar_camada: o delta da camada (em relação
+    // à entrada da ativação) e os gradientes dos pesos e biases a partir dele
+    double calcular_delta(size_t index_camada, const Vetor &saida_esperada, AreaTrabalho &area);
+    void acumular_gradientes(size_t index_camada, AreaTrabalho &area, bool acumular);
+
+    // Multiplica todos os gradientes por 'fator' (ex.: 1/n para tirar a média do lote)
+    void escalar_gradientes(double fator);
+
+    // Membros do treino em mini-lotes
+    struct LoteAtual
+    {
+      const VisaoDados *dados = nullptr;
+      size_t inicio = 0, fim = 0;
+      bool acumular = false; // soma aos gradientes dos lotes anteriores (acumulação)
+      bool fechar = false;   // último lote antes do passo do otimizador
+    };
+
+    size_t m_tamanho_lote = 1;
+    size_t m_n_micro_lotes = 1;
+    LoteAtual m_lote;
+    std::vector<AreaTrabalho> m_areas_lote;
+    std::vector<double> m_perdas_lote; // loss de cada amostra do lote, escrito pelo backward da última camada
+    GrafoTarefas m_grafo_pipeline;
+    EscalonadorTarefas *m_escalonador = nullptr;
+
+    // Acumulação de gradientes entre lotes
+    size_t m_lotes_por_passo = 1;
+    size_t m_lotes_acumulados = 0;
+    size_t m_amostras_acumuladas = 0;
+
+    // Checkpoint de ativações: com m_intervalo_checkpoint > 0, m_areas_lote
+    // guardam só os checkpoints (ver alocar_area_checkpoint) e cada micro-lote
+    // recalcula as outras camadas na sua área de m_areas_recomputo
+    size_t m_intervalo_checkpoint = 0;
+    std::vector<AreaTrabalho> m_areas_recomputo;
+    void alocar_area_checkpoint(AreaTrabalho &area) const;
+    void recalcular_ate(size_t index_camada, const AreaTrabalho &amostra, AreaTrabalho &area);
+
+    /*
+    Soma os gradientes das amostras [inicio, fim) aos dos lotes já acumulados
+    e retorna o loss médio delas. Com 'fechar', os gradientes viram a média de
+    todas as amostras acumuladas (entre todos os processos, no treino
+    distribuído) e o otimizador pode ser chamado.
+    */
+    double treinar_lote(const VisaoDados &dados, size_t inicio, size_t fim, bool fechar = true);
+    void processar_micro_lote(size_t micro, bool forward, size_t index_camada);
+    void montar_grafo_pipeline();
+
+    /*
+    Normalização em lote, uma por camada de pesos (só as ocultas podem estar
+    ligadas), com os gradientes e momentos do Adam de gama e beta e o
+    1 / desvio padrão do último lote de cada camada.
+    */
+    std::vector<NormalizacaoLote> m_normalizacoes;
+    std::vector<Vetor> m_gradientes_gama, m_gradientes_beta;
+    std::vector<Vetor> m_gama_m, m_gama_v, m_beta_m, m_beta_v;
+    std::vector<Vetor> m_inversos_desvio;
+    bool tem_normalizacao() const;
+
+    // Lote inteiro camada por camada (as estatísticas do lote precisam de
+    // todas as amostras antes da ativação), uma área de m_areas_lote por amostra
+    double treinar_lote_normalizado(const VisaoDados &dados, size_t inicio, size_t fim);
+    // Delta da camada de saída das 'n' amostras numa única chamada de
+    // forward_backward_lote, com logits, saídas esperadas, ativações e deltas
+    // do lote lado a lado (copiados de/para as áreas de cada amostra)
+    Vetor m_logits_saida_lote, m_esperadas_lote, m_ativacoes_saida_lote, m_deltas_saida_lote;
+    double calcular_delta_saida_lote(const VisaoDados &dados, size_t inicio, size_t n);
+    // Forward da normalização sobre os logits das 'n' amostras: estatísticas,
+    // x̂, gama * x̂ + beta e a ativação numa passada, atualizando as médias móveis
+    void normalizar_lote(size_t index_camada, size_t n);
+    // Backward dela: gradientes de gama e beta e os deltas em relação aos logits
+    void retropropagar_normalizacao_lote(size_t index_camada, size_t n, bool acumular);
+
+    // Membros do treino distribuído
+    GrupoProcessos *m_grupo = nullptr;
+    std::vector<Vetor> m_gradientes_planos; // gradientes de cada camada em memória contínua (pesos e depois biases)
+
+    // Copia os gradientes da camada para o buffer plano e inicia o allreduce dela
+    void enviar_gradientes_camada(size_t index_camada);
+
+    // Espera os allreduces e copia a soma de volta, multiplicada por 'fator'
+    void receber_gradientes(double fator);
 
     // otimizador Adam
-    void otimizar(double taxa_aprendizagem, double beta1, double beta2, double epsilon);
+    void otimizar(double taxa_aprendizagem, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8);
 
     // Membros do Adam
     std::vector<Matriz> m_pesos_m, m_pesos_v;
     std::vector<Vetor> m_biases_m, m_biases_v;
     long m_timestep;
 
+    // Ativação padrão das ocultas e a de cada uma: m_ativacoes[L] ativa
+    // area.logits[L] (a camada L + 1), para L < m_pesos.size() - 1
     func funcao_ativacao_oculta;
+    std::vector<func> m_ativacoes;
     std::unique_ptr<CamadaSaida> m_camada_saida;
 
+    ContextoExecucao *m_execucao = &contexto_padrao();
+
+    // Camadas de imagem antes das densas, com os gradientes e os momentos
+    // do Adam dos parâmetros de cada uma
+    std::vector<std::unique_ptr<CamadaImagem>> m_extrator;
+    std::vector<Vetor> m_gradientes_extrator;
+    std::vector<Vetor> m_extrator_m, m_extrator_v;
+
+    // Forward das camadas de imagem até area.ativacoes[0]
+    void propagar_extrator(const Vetor &entradas, AreaTrabalho &area) const;
+    // Backward delas, a partir de area.deltas[0] (depois do backward das densas)
+    void retropropagar_extrator(AreaTrabalho &area, bool acumular);
+
+    /*
+    Plano da pilha, decidido uma vez (no construtor, em carregar_rede e
+    quando uma camada muda) e não a cada chamada: o plano de cada camada
+    de pesos e se a ativação dela é fundida ao produto, aplicada a cada
+    bloco de logits logo depois dos biases, enquanto ele ainda está na
+    cache, em vez de numa segunda passada pela camada.
+    */
+    std::vector<PlanoCamada> m_planos;
+    std::vector<bool> m_fundir_ativacao;
+    std::map<size_t, PlanoCamada> m_planos_fixos; // set_plano_camada
+    bool m_autoajuste = false;
+    void planejar_pilha();
+
     void inicializar_pesos();
     void inicializar_biases();
   };
@@ -0,0 +1,361 @@
+#include "autoajuste.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <tuple>
+
+using namespace nn;
+
+//
+// KERNELS
+//
+
+namespace
+{
+    // Executa fn(inicio, fim) sobre os neurônios de destino, dividido como o plano pede
+    template <typename F>
+    void dividir(const PlanoCamada &plano, ContextoExecucao &contexto, size_t n, size_t custo_por_item, const F &fn)
+    {
+        if (plano.n_threads == 0)
+            contexto.paralelo_para(n, custo_por_item, fn);
+        else
+            contexto.paralelo_para_em(n, plano.n_threads, fn);
+    }
+}
+
+void nn::produto_camada(const PlanoCamada &plano, const Matriz &pesos, const Vetor &biases, const Vetor &x,
+                        Vetor &y, ContextoExecucao &contexto,
+                        void (*ativacao)(const double *, double *, size_t), double *ativado)
+{
+    const size_t n_entradas = x.size();
+
+    if (plano.kernel == KernelForward::POR_NEURONIO)
+    {
+        dividir(plano, contexto, y.size(), n_entradas,
+            [&](size_t inicio, size_t fim)
+            {
+                for (size_t j = inicio; j < fim; ++j)
+                {
+                    double soma_ponderada = 0.0;
+                    for (size_t k = 0; k < n_entradas; ++k)
+                    {
+                        // Acesso aos pesos:
+                        // pesos[neuronio_origem][neuronio_destino]
+                        soma_ponderada += x[k] * pesos[k][j];
+                    }
+
+                    // Adiciona o bias
+                    soma_ponderada += biases[j];
+                    y[j] = soma_ponderada;
+                }
+
+                if (ativacao)
+                    ativacao(y.data() + inicio, ativado + inicio, fim - inicio);
+            });
+        return;
+    }
+
+    dividir(plano, contexto, y.size(), n_entradas,
+        [&](size_t inicio, size_t fim)
+        {
+            const size_t passo = plano.bloco > 0 ? plano.bloco : fim - inicio;
+            double *saida = y.data();
+
+            // Um bloco de saídas fica na cache enquanto todas as linhas passam por ele
+            for (size_t j0 = inicio; j0 < fim; j0 += passo)
+            {
+                const size_t j1 = std::min(fim, j0 + passo);
+
+                for (size_t j = j0; j < j1; j++)
+                    saida[j] = 0.0;
+
+                for (size_t k = 0; k < n_entradas; k++)
+                {
+                    const double xk = x[k];
+                    if (xk == 0.0)
+                        continue;
+
+                    const double *linha = pesos[k].data();
+                    for (size_t j = j0; j < j1; j++)
+                        saida[j] += xk * linha[j];
+                }
+
+                for (size_t j = j0; j < j1; j++)
+                    saida[j] += biases[j];
+
+                if (ativacao)
+                    ativacao(saida + j0, ativado + j0, j1 - j0);
+            }
+        });
+}
+
+//
+// MEDIÇÃO
+//
+
+namespace
+{
+    // Tempo por chamada de fn: o melhor de 3 rodadas de ~1 ms
+    template <typename F>
+    double segundos_por_chamada(const F &fn)
+    {
+        using relogio = std::chrono::steady_clock;
+
+        fn(); // aquecimento (caches e threads do pool)
+
+        // Quantas chamadas cabem em ~1 ms
+        size_t chamadas = 1;
+        double segundos = 0.0;
+        while (true)
+        {
+            auto inicio = relogio::now();
+            for (size_t c = 0; c < chamadas; c++)
+                fn();
+            segundos = std::chrono::duration<double>(relogio::now() - inicio).count();
+
+            if (segundos >= 1e-3 || chamadas >= (size_t(1) << 24))
+                break;
+            chamadas *= 2;
+        }
+
+        double melhor = segundos / chamadas;
+        for (int rodada = 0; rodada < 2; rodada++)
+        {
+            auto inicio = relogio::now();
+            for (size_t c = 0; c < chamadas; c++)
+                fn();
+            segundos = std::chrono::duration<double>(relogio::now() - inicio).count();
+            melhor = std::min(melhor, segundos / chamadas);
+        }
+
+        return melhor;
+    }
+}
+
+PlanoCamada autoajuste::medir(size_t entradas, size_t saidas, const ContextoExecucao &contexto)
+{
+    // Contexto próprio, com as mesmas threads e backend, mas em modo VAZAO:
+    // o da rede pode estar em LATENCIA (ou em uso)
+    ContextoExecucao bancada(contexto.get_n_threads(), contexto.get_grao_minimo());
+    bancada.set_backend(contexto.get_backend());
+    bancada.set_modo(ModoExecucao::VAZAO);
+
+    std::mt19937 gerador(42);
+    std::uniform_real_distribution<double> distribuicao(-1.0, 1.0);
+
+    Matriz pesos(entradas, Vetor(saidas));
+    for (auto &linha : pesos)
+        for (double &w : linha)
+            w = distribuicao(gerador);
+
+    Vetor biases(saidas), x(entradas), y(saidas);
+    for (double &b : biases)
+        b = distribuicao(gerador);
+    for (double &v : x)
+        v = distribuicao(gerador);
+
+    // Candidatos: os dois kernels, blocos menores que a camada e 1, 2, 4...
+    // threads até as do contexto
+    std::vector<PlanoCamada> candidatos;
+    const size_t max_threads = std::max<size_t>(1, std::min(bancada.get_n_threads(), saidas));
+    std::vector<size_t> threads;
+    for (size_t t = 1; t < max_threads; t *= 2)
+        threads.push_back(t);
+    threads.push_back(max_threads);
+
+    for (size_t t : threads)
+    {
+        candidatos.push_back({KernelForward::POR_NEURONIO, 0, t});
+        candidatos.push_back({KernelForward::POR_LINHA, 0, t});
+
+        for (size_t bloco : {16, 64, 256})
+        {
+            if (bloco < (saidas + t - 1) / t)
+                candidatos.push_back({KernelForward::POR_LINHA, bloco, t});
+        }
+    }
+
+    PlanoCamada melhor = candidatos.front();
+    double melhor_tempo = -1.0;
+
+    for (const PlanoCamada &candidato : candidatos)
+    {
+        double tempo = segundos_por_chamada([&]()
+        {
+            produto_camada(candidato, pesos, biases, x, y, bancada);
+        });
+
+        if (melhor_tempo < 0.0 || tempo < melhor_tempo)
+        {
+            melhor = candidato;
+            melhor_tempo = tempo;
+        }
+    }
+
+    return melhor;
+}
+
+//
+// CACHE
+//
+
+namespace
+{
+    // (threads do contexto, entradas, saídas) -> plano, para a CPU atual
+    using Chave = std::tuple<size_t, size_t, size_t>;
+
+    std::mutex trava_cache;
+    std::map<Chave, PlanoCamada> planos;
+    bool arquivo_lido = false;
+
+    bool ler_kernel(const std::string &nome, KernelForward &kernel)
+    {
+        for (KernelForward k : {KernelForward::POR_NEURONIO, KernelForward::POR_LINHA})
+        {
+            if (nome == autoajuste::nome_kernel(k))
+            {
+                kernel = k;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+    Uma linha por plano:
+      entradas saídas threads_contexto kernel bloco threads modelo da CPU
+    Linhas de outras CPUs, comentários e linhas inválidas são ignorados.
+    */
+    void ler_arquivo(const std::string &caminho, const std::string &cpu)
+    {
+        std::ifstream arquivo(caminho);
+        std::string linha;
+
+        while (std::getline(arquivo, linha))
+        {
+            if (linha.empty() || linha[0] == '#')
+                continue;
+
+            std::istringstream campos(linha);
+            size_t entradas, saidas, threads_contexto;
+            std::string kernel;
+            PlanoCamada plano;
+
+            if (!(campos >> entradas >> saidas >> threads_contexto >> kernel >> plano.bloco >> plano.n_threads) ||
+                !ler_kernel(kernel, plano.kernel))
+                continue;
+
+            std::string cpu_linha;
+            std::getline(campos >> std::ws, cpu_linha);
+            if (cpu_linha == cpu)
+                planos[Chave(threads_contexto, entradas, saidas)] = plano;
+        }
+    }
+
+    void gravar_plano(const std::string &caminho, const std::string &cpu, const Chave &chave, const PlanoCamada &plano)
+    {
+        std::error_code erro;
+        std::filesystem::path arquivo(caminho);
+        if (arquivo.has_parent_path())
+            std::filesystem::create_directories(arquivo.parent_path(), erro);
+
+        bool novo = !std::filesystem::exists(arquivo, erro);
+
+        // Só acrescenta: outros processos podem estar gravando planos também
+        std::ofstream saida(caminho, std::ios::app);
+        if (!saida)
+            return;
+
+        if (novo)
+            saida << "# autoajuste da rede_neural: entradas saidas threads_contexto kernel bloco threads cpu\n";
+
+        saida << std::get<1>(chave) << ' ' << std::get<2>(chave) << ' ' << std::get<0>(chave) << ' '
+              << autoajuste::nome_kernel(plano.kernel) << ' ' << plano.bloco << ' ' << plano.n_threads << ' '
+              << cpu << '\n';
+    }
+}
+
+PlanoCamada autoajuste::plano(size_t entradas, size_t saidas, const ContextoExecucao &contexto)
+{
+    const std::string cpu = modelo_cpu();
+    const std::string caminho = caminho_cache();
+    const Chave chave(contexto.get_n_threads(), entradas, saidas);
+
+    // A trava fica com quem mede: duas threads não medem o mesmo formato
+    std::lock_guard<std::mutex> lock(trava_cache);
+
+    if (!arquivo_lido)
+    {
+        if (!caminho.empty())
+            ler_arquivo(caminho, cpu);
+        arquivo_lido = true;
+    }
+
+    auto encontrado = planos.find(chave);
+    if (encontrado != planos.end())
+        return encontrado->second;
+
+    PlanoCamada novo = medir(entradas, saidas, contexto);
+    planos[chave] = novo;
+
+    if (!caminho.empty())
+        gravar_plano(caminho, cpu, chave, novo);
+
+    return novo;
+}
+
+std::string autoajuste::modelo_cpu()
+{
+    static const std::string modelo = []
+    {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string linha;
+
+        while (std::getline(cpuinfo, linha))
+        {
+            if (linha.compare(0, 10, "model name") != 0)
+                continue;
+
+            size_t dois_pontos = linha.find(':');
+            if (dois_pontos != std::string::npos && dois_pontos + 2 <= linha.size())
+                return linha.substr(dois_pontos + 2);
+        }
+
+        return std::string("desconhecida");
+    }();
+
+    return modelo;
+}
+
+std::string autoajuste::caminho_cache()
+{
+    if (const char *arquivo = std::getenv("NN_AUTOAJUSTE_ARQUIVO"))
+        return arquivo;
+
+    if (const char *cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return std::string(cache) + "/rede_neural/autoajuste.txt";
+
+    if (const char *home = std::getenv("HOME"); home && *home)
+        return std::string(home) + "/.cache/rede_neural/autoajuste.txt";
+
+    return "";
+}
+
+void autoajuste::esquecer()
+{
+    std::lock_guard<std::mutex> lock(trava_cache);
+    planos.clear();
+    arquivo_lido = false;
+}
+
+const char *autoajuste::nome_kernel(KernelForward kernel)
+{
+    return kernel == KernelForward::POR_LINHA ? "POR_LINHA" : "POR_NEURONIO";
+}
@@ -0,0 +1,97 @@
+#include "rede_neural.h"
+
+// Gerados no build por nn_compilar_modelo (ver CMakeLists.txt)
+#include "modelo_xor.h"
+#include "modelo_sqrt_aprox.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+/*
+Compara a rede genérica (nn::Sequencial carregada do arquivo) com o código
+gerado por compilar_modelo para os mesmos modelos: as saídas devem ser iguais
+e o tempo por inferência bem menor.
+*/
+
+const int repeticoes = 1000000;
+
+// Evita que o compilador descarte os cálculos do laço de medição
+volatile double sumidouro;
+
+template <typename F>
+double nanossegundos_por_chamada(F &&f)
+{
+    auto inicio = chrono::steady_clock::now();
+    for (int i = 0; i < repeticoes; i++)
+        f(i);
+    auto fim = chrono::steady_clock::now();
+
+    return chrono::duration<double, nano>(fim - inicio).count() / repeticoes;
+}
+
+// O código gerado entra como parâmetro do template para poder ser inlinado
+template <size_t N_SAIDAS, void (*feed_forward_gerado)(const double *, double *)>
+bool comparar(const string &nome, const string &caminho, const nn::Matriz &entradas)
+{
+    nn::contexto_padrao().set_modo(nn::ModoExecucao::LATENCIA);
+    nn::Sequencial rede(caminho);
+
+    double diferenca = 0.0;
+    for (const auto &entrada : entradas)
+    {
+        const nn::Vetor &esperada = rede.feed_forward(entrada);
+        double saida[N_SAIDAS];
+        feed_forward_gerado(entrada.data(), saida);
+
+        for (size_t i = 0; i < N_SAIDAS; i++)
+            diferenca = max(diferenca, fabs(esperada[i] - saida[i]));
+    }
+
+    double t_generico = nanossegundos_por_chamada([&](int i)
+    {
+        sumidouro = rede.feed_forward(entradas[i % entradas.size()])[0];
+    });
+
+    double t_gerado = nanossegundos_por_chamada([&](int i)
+    {
+        double saida[N_SAIDAS];
+        feed_forward_gerado(entradas[i % entradas.size()].data(), saida);
+        sumidouro = saida[0];
+    });
+
+    cout << left << setw(12) << nome << setw(16) << t_generico << setw(16) << t_gerado
+         << setw(10) << t_generico / t_gerado << scientific << diferenca << fixed << endl;
+
+    return diferenca < 1e-9;
+}
+
+int main ()
+{
+    nn::Matriz entradas_xor = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+
+    nn::Matriz entradas_raiz;
+    for (int i = 0; i < 64; i++)
+        entradas_raiz.push_back({i / 64.0});
+
+    cout << fixed << setprecision(1);
+    cout << left << setw(12) << "MODELO" << setw(16) << "GENÉRICO (ns)" << setw(16) << "GERADO (ns)"
+         << setw(10) << "GANHO" << "DIFERENÇA" << endl;
+
+    bool ok = true;
+    ok &= comparar<modelo_xor::n_saidas, modelo_xor::feed_forward>(
+        "xor", "data/models/xor_model.txt", entradas_xor);
+    ok &= comparar<modelo_sqrt_aprox::n_saidas, modelo_sqrt_aprox::feed_forward>(
+        "sqrt_aprox", "data/models/sqrt_aprox_model.txt", entradas_raiz);
+
+    if (!ok)
+    {
+        cerr << "ERRO: as saídas do código gerado são diferentes das da rede" << endl;
+        return 1;
+    }
+
+    return 0;
+}
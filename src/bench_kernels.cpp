@@ -0,0 +1,124 @@
+#include "rede_neural.h"
+#include "contadores.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Benchmark dos kernels da rede com contadores de hardware.
+
+Uso:
+  ./bench_kernels [iteracoes=2000] [tamanho_lote=32]
+
+Roda feed_forward e train_step numa rede {784, 128, 64, 10} com dados
+aleatórios e mostra, para cada região instrumentada (forward, backward e
+Adam), o tempo, os eventos do perf e os valores derivados: IPC, banda
+estimada com a memória (faltas na LLC * 64 B) e GFLOP/s alcançados (FLOPs
+contados analiticamente). Tudo roda em ModoExecucao::LATENCIA, na thread
+principal, que é a única contada.
+
+Sem acesso aos contadores (ex.: perf_event_paranoid alto ou contêiner sem
+permissão) o motivo é mostrado e só o tempo e os GFLOP/s são medidos.
+*/
+
+// Evento formatado, ou "-" se indisponível
+string evento(const nn::Medicao &m, nn::EventoHardware e)
+{
+    if (m.eventos[e] < 0)
+        return "-";
+    return to_string(m.eventos[e] / m.chamadas);
+}
+
+string derivado(double valor, int casas)
+{
+    if (valor < 0.0)
+        return "-";
+
+    ostringstream texto;
+    texto << fixed << setprecision(casas) << valor;
+    return texto.str();
+}
+
+void relatorio(const string &titulo)
+{
+    cout << "\n" << titulo << "\n";
+    cout << left << setw(32) << "região" << right
+         << setw(10) << "chamadas" << setw(12) << "us/chamada";
+    for (int e = 0; e < nn::N_EVENTOS_HARDWARE; e++)
+        cout << setw(16) << nn::nome_evento(static_cast<nn::EventoHardware>(e));
+    cout << setw(8) << "IPC" << setw(10) << "GB/s" << setw(10) << "GFLOP/s" << "\n";
+
+    for (int r = 0; r < nn::contadores::N_REGIOES; r++)
+    {
+        nn::contadores::Regiao regiao = static_cast<nn::contadores::Regiao>(r);
+        nn::Medicao m = nn::contadores::total(regiao);
+        if (m.chamadas == 0)
+            continue;
+
+        cout << left << setw(32) << nn::contadores::nome_regiao(regiao) << right
+             << setw(10) << m.chamadas
+             << setw(12) << fixed << setprecision(2) << m.segundos / m.chamadas * 1e6;
+        for (int e = 0; e < nn::N_EVENTOS_HARDWARE; e++)
+            cout << setw(16) << evento(m, static_cast<nn::EventoHardware>(e));
+        cout << setw(8) << derivado(m.ipc(), 2)
+             << setw(10) << derivado(m.banda_gbs(), 2)
+             << setw(10) << derivado(m.gflops(), 2) << "\n";
+    }
+}
+
+int main (int argc, char** argv)
+{
+    int iteracoes = argc > 1 ? atoi(argv[1]) : 2000;
+    size_t tamanho_lote = argc > 2 ? atoi(argv[2]) : 32;
+
+    string erro;
+    if (nn::contadores::disponivel(&erro))
+        cout << "Contadores de hardware disponíveis\n";
+    else
+        cout << "Contadores de hardware indisponíveis: " << erro << "\n"
+             << "Medindo só tempo e GFLOP/s\n";
+
+    nn::contexto_padrao().set_modo(nn::ModoExecucao::LATENCIA);
+
+    nn::Sequencial rede({784, 128, 64, 10}, "SCE", nn::ReLU);
+
+    mt19937 gerador(42);
+    uniform_real_distribution<double> pixel(0.0, 1.0);
+
+    vector<nn::Vetor> entradas(tamanho_lote, nn::Vetor(784));
+    vector<nn::Vetor> saidas(tamanho_lote, nn::Vetor(10, 0.0));
+    for (size_t a = 0; a < tamanho_lote; a++)
+    {
+        for (double &p : entradas[a])
+            p = pixel(gerador);
+        saidas[a][a % 10] = 1.0;
+    }
+
+    // Aquecimento: caches, páginas e alocações da primeira chamada
+    rede.train_step(entradas, saidas, 0.001);
+    for (size_t a = 0; a < tamanho_lote; a++)
+        rede.feed_forward(entradas[a]);
+
+    nn::contadores::habilitar(true);
+
+    nn::contadores::zerar();
+    for (int i = 0; i < iteracoes; i++)
+        rede.feed_forward(entradas[i % tamanho_lote]);
+    relatorio("feed_forward (" + to_string(iteracoes) + " amostras)");
+
+    nn::contadores::zerar();
+    for (int i = 0; i < iteracoes / static_cast<int>(tamanho_lote) + 1; i++)
+        rede.train_step(entradas, saidas, 0.001);
+    relatorio("train_step (lotes de " + to_string(tamanho_lote) + ")");
+
+    nn::contadores::habilitar(false);
+
+    return 0;
+}
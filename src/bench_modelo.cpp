@@ -0,0 +1,93 @@
+#include "rede_neural.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+/*
+Benchmark de carregar_rede/salvar_rede.
+
+Uso:
+  ./bench_modelo [modelo=data/models/number_rec_model.txt] [repeticoes=20]
+
+Mede o tempo médio de cada operação e confere que salvar e carregar de novo
+devolve exatamente os mesmos pesos.
+*/
+
+template <typename F>
+double milissegundos_por_chamada(int repeticoes, F &&f)
+{
+    auto inicio = chrono::steady_clock::now();
+    for (int i = 0; i < repeticoes; i++)
+        f();
+    auto fim = chrono::steady_clock::now();
+
+    return chrono::duration<double, milli>(fim - inicio).count() / repeticoes;
+}
+
+// Maior diferença entre os parâmetros de duas redes com a mesma topologia
+double diferenca_parametros(const nn::Sequencial &a, const nn::Sequencial &b)
+{
+    const vector<size_t> &topologia = a.get_topologia();
+    double diferenca = 0.0;
+
+    for (size_t L = 0; L + 1 < topologia.size(); L++)
+    {
+        const nn::Matriz &pesos_a = a.get_pesos(L);
+        const nn::Matriz &pesos_b = b.get_pesos(L);
+        for (size_t k = 0; k < topologia[L]; k++)
+            for (size_t j = 0; j < topologia[L + 1]; j++)
+                diferenca = max(diferenca, fabs(pesos_a[k][j] - pesos_b[k][j]));
+
+        const nn::Vetor &biases_a = a.get_biases(L + 1);
+        const nn::Vetor &biases_b = b.get_biases(L + 1);
+        for (size_t j = 0; j < topologia[L + 1]; j++)
+            diferenca = max(diferenca, fabs(biases_a[j] - biases_b[j]));
+    }
+
+    return diferenca;
+}
+
+int main (int argc, char** argv)
+{
+    string caminho = argc > 1 ? argv[1] : "data/models/number_rec_model.txt";
+    int repeticoes = argc > 2 ? stoi(argv[2]) : 20;
+    const string copia = "bench_modelo_copia.txt";
+
+    nn::Sequencial rede(caminho);
+
+    double t_carregar = milissegundos_por_chamada(repeticoes, [&]()
+    {
+        if (!rede.carregar_rede(caminho))
+            throw runtime_error("não foi possível carregar " + caminho);
+    });
+
+    double t_salvar = milissegundos_por_chamada(repeticoes, [&]()
+    {
+        if (!rede.salvar_rede(copia))
+            throw runtime_error("não foi possível salvar " + copia);
+    });
+
+    nn::Sequencial recarregada(copia);
+    double diferenca = diferenca_parametros(rede, recarregada);
+    remove(copia.c_str());
+
+    cout << fixed << setprecision(2);
+    cout << "Modelo:    " << caminho << endl;
+    cout << "Carregar:  " << t_carregar << " ms" << endl;
+    cout << "Salvar:    " << t_salvar << " ms" << endl;
+    cout << "Diferença após salvar e carregar: " << scientific << diferenca << endl;
+
+    if (diferenca != 0.0)
+    {
+        cerr << "ERRO: os pesos mudaram ao salvar e carregar" << endl;
+        return 1;
+    }
+
+    return 0;
+}
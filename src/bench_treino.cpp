@@ -0,0 +1,147 @@
+#include "rede_neural.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdlib>
+
+using namespace std;
+
+/*
+Benchmark de tempo até a precisão alvo no MNIST.
+
+Uso:
+  ./bench_treino [precisao_alvo=0.95] [numero_imagens=60000] [max_epocas=20]
+
+Todas as configurações partem dos mesmos pesos iniciais e param na primeira
+época em que a precisão de validação passa do alvo.
+*/
+
+const char* labels_file_path = "data/dataset/train-labels.idx1-ubyte";
+const char* images_file_path = "data/dataset/train-images.idx3-ubyte";
+
+const int tamanho_imagem = 28 * 28;
+
+bool ler_mnist (int numero_imagens, nn::Matriz& imagens, nn::Matriz& rotulos)
+{
+    ifstream labels_file (labels_file_path, ios::binary);
+    ifstream images_file (images_file_path, ios::binary);
+
+    if (!labels_file.is_open() || !images_file.is_open())
+        return false;
+
+    // pular os cabeçalhos
+    images_file.seekg(16);
+    labels_file.seekg(8);
+
+    vector<u_char> buffer_imagem(tamanho_imagem);
+    for (int i = 0; i < numero_imagens; ++i)
+    {
+        u_char buffer_rotulo;
+        images_file.read(reinterpret_cast<char*>(buffer_imagem.data()), tamanho_imagem);
+        labels_file.read(reinterpret_cast<char*>(&buffer_rotulo), 1);
+
+        if (!images_file || !labels_file)
+            return false;
+
+        nn::Vetor imagem(tamanho_imagem);
+        for (int p = 0; p < tamanho_imagem; p++)
+            imagem[p] = buffer_imagem[p] / 255.0;
+
+        nn::Vetor rotulo(10, 0.0);
+        rotulo[buffer_rotulo] = 1.0;
+
+        imagens.push_back(move(imagem));
+        rotulos.push_back(move(rotulo));
+    }
+
+    return true;
+}
+
+struct Candidato
+{
+    string nome;
+    nn::ConfigTreino config;
+};
+
+int main (int argc, char** argv)
+{
+    double precisao_alvo = argc > 1 ? atof(argv[1]) : 0.95;
+    int numero_imagens   = argc > 2 ? atoi(argv[2]) : 60000;
+    size_t max_epocas    = argc > 3 ? atoi(argv[3]) : 20;
+
+    nn::Matriz imagens, rotulos;
+    if (!ler_mnist(numero_imagens, imagens, rotulos))
+    {
+        cerr << "ERRO: falha ao ler o MNIST em data/dataset/" << endl;
+        return 1;
+    }
+
+    // 20% para validação
+    size_t n_validacao = imagens.size() / 5;
+    nn::Matriz entradas_validacao(imagens.begin(), imagens.begin() + n_validacao);
+    nn::Matriz saidas_validacao(rotulos.begin(), rotulos.begin() + n_validacao);
+    nn::Matriz entradas_treino(imagens.begin() + n_validacao, imagens.end());
+    nn::Matriz saidas_treino(rotulos.begin() + n_validacao, rotulos.end());
+
+    nn::ConfigTreino base;
+    base.taxa_aprendizagem = 0.001;
+    base.janela_analise = 10;
+    base.max_epocas = max_epocas;
+    base.target_accuracy = precisao_alvo;
+    base.paciencia = 5;
+    base.verbose = false;
+
+    vector<Candidato> candidatos;
+
+    candidatos.push_back({"constante", base});
+
+    {
+        Candidato c{"degraus (x0.5 a cada 2)", base};
+        c.config.agenda = make_shared<DecaimentoDegraus>(2, 0.5);
+        candidatos.push_back(c);
+    }
+    {
+        Candidato c{"cosseno", base};
+        c.config.agenda = make_shared<DecaimentoCosseno>(max_epocas);
+        candidatos.push_back(c);
+    }
+    {
+        Candidato c{"aquecimento + cosseno", base};
+        c.config.taxa_aprendizagem = 0.003;
+        c.config.agenda = make_shared<Aquecimento>(1, make_unique<DecaimentoCosseno>(max_epocas - 1));
+        candidatos.push_back(c);
+    }
+    {
+        Candidato c{"um ciclo", base};
+        c.config.taxa_aprendizagem = 0.003;
+        c.config.agenda = make_shared<UmCiclo>(max_epocas);
+        candidatos.push_back(c);
+    }
+    {
+        Candidato c{"constante + platô", base};
+        c.config.paciencia_plateau = 1;
+        candidatos.push_back(c);
+    }
+
+    nn::Sequencial inicial({tamanho_imagem, 32, 32, 10}, "SCE", nn::ReLU);
+
+    cout << "ALVO: " << precisao_alvo * 100.0 << "% | " << entradas_treino.size() << " IMAGENS DE TREINO" << endl << endl;
+    cout << left << setw(28) << "AGENDA" << setw(10) << "ÉPOCAS" << setw(12) << "SEGUNDOS" << "ATINGIU" << endl;
+
+    for (auto& c : candidatos)
+    {
+        nn::Sequencial rede({tamanho_imagem, 32, 32, 10}, "SCE", nn::ReLU);
+        rede = inicial;
+
+        auto r = rede.train(entradas_treino, saidas_treino, entradas_validacao, saidas_validacao, c.config);
+
+        cout << left << setw(28) << c.nome << setw(10) << r.epocas << setw(12) << fixed << setprecision(2) << r.segundos
+             << (r.precisao_atingida ? "sim" : "não") << endl;
+    }
+
+    return 0;
+}
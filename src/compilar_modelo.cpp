@@ -0,0 +1,284 @@
+#include "rede_neural.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cctype>
+
+using namespace std;
+
+/*
+Compilador de modelos: lê um arquivo salvo com salvar_rede e gera um header
+C++ autossuficiente com a mesma rede.
+
+Uso:
+  ./compilar_modelo <modelo.txt> <saida.h> [nome]
+
+O header gerado não depende desta biblioteca: a topologia é constexpr, os
+pesos ficam embutidos em arrays 'static constexpr' alinhados, a ativação é
+inline e os laços têm tamanho fixo (o compilador desenrola os pequenos).
+Nenhum arquivo é lido ao iniciar o programa. No CMake, use a função
+nn_compilar_modelo(alvo modelo nome).
+
+Exemplo de uso do header gerado para "xor":
+
+  #include "modelo_xor.h"
+  double entrada[modelo_xor::n_entradas] = {1, 0};
+  double saida[modelo_xor::n_saidas];
+  modelo_xor::feed_forward(entrada, saida);
+*/
+
+// Transforma o nome em um identificador C++ válido
+string identificador(const string &nome)
+{
+    string id;
+    for (char c : nome)
+        id += isalnum((unsigned char)c) ? (char)tolower((unsigned char)c) : '_';
+
+    if (id.empty() || isdigit((unsigned char)id[0]))
+        id = "m_" + id;
+
+    return id;
+}
+
+// Nome do arquivo sem diretório nem extensão
+string nome_base(const string &caminho)
+{
+    size_t barra = caminho.find_last_of("/\\");
+    string nome = caminho.substr(barra == string::npos ? 0 : barra + 1);
+
+    size_t ponto = nome.find_last_of('.');
+    if (ponto != string::npos)
+        nome = nome.substr(0, ponto);
+
+    // "xor_model" -> "xor"
+    const string sufixo = "_model";
+    if (nome.size() > sufixo.size() && nome.compare(nome.size() - sufixo.size(), sufixo.size(), sufixo) == 0)
+        nome = nome.substr(0, nome.size() - sufixo.size());
+
+    return nome;
+}
+
+// Escreve 'valores' como lista de inicialização, 4 por linha
+void escrever_valores(ostream &out, const vector<double> &valores)
+{
+    for (size_t i = 0; i < valores.size(); i++)
+    {
+        if (i % 4 == 0)
+            out << "\n    ";
+        out << valores[i] << (i + 1 < valores.size() ? ", " : "");
+    }
+}
+
+bool gerar_header(const nn::Sequencial &rede, const string &origem, const string &nome, ostream &out)
+{
+    const vector<size_t> &topologia = rede.get_topologia();
+    const string ativacao = rede.get_func_oculta().nome;
+    const string saida = rede.get_camada_saida().get_tipo();
+
+    // Ativação de cada camada oculta (ativacoes[L] é a da camada L + 1)
+    vector<string> ativacoes;
+    for (size_t L = 1; L + 1 < topologia.size(); L++)
+        ativacoes.push_back(rede.get_ativacao_camada(L).nome);
+
+    for (const string &a : ativacoes)
+    {
+        if (a != "ReLU" && a != "tanh" && a != "sigmoid")
+        {
+            cerr << "ERRO: ativação desconhecida: " << a << endl;
+            return false;
+        }
+    }
+
+    // O header gerado só tem as camadas densas
+    if (!rede.get_extrator().empty())
+    {
+        cerr << "ERRO: modelos com camadas de imagem (CONV2D, MAXPOOL2D) não são suportados" << endl;
+        return false;
+    }
+
+    const string ns = "modelo_" + identificador(nome);
+    string guarda = ns;
+    for (auto &c : guarda)
+        c = toupper((unsigned char)c);
+
+    // Precisão suficiente para reproduzir cada double exatamente
+    out.precision(numeric_limits<double>::max_digits10);
+
+    out << "// Gerado por compilar_modelo a partir de " << origem << " - não edite\n";
+    out << "#ifndef _" << guarda << "_H\n";
+    out << "#define _" << guarda << "_H\n\n";
+    out << "#include <array>\n#include <cmath>\n#include <cstddef>\n\n";
+    out << "namespace " << ns << "\n{\n";
+
+    out << "  // Rede " << saida << " com ativação oculta " << ativacao;
+    if (count(ativacoes.begin(), ativacoes.end(), ativacao) != (long)ativacoes.size())
+    {
+        out << " (por camada:";
+        for (const string &a : ativacoes)
+            out << ' ' << a;
+        out << ')';
+    }
+    out << "\n";
+    out << "  constexpr std::array<std::size_t, " << topologia.size() << "> topologia = {";
+    for (size_t i = 0; i < topologia.size(); i++)
+        out << (i ? ", " : "") << topologia[i];
+    out << "};\n";
+    out << "  constexpr std::size_t n_entradas = " << topologia.front() << ";\n";
+    out << "  constexpr std::size_t n_saidas = " << topologia.back() << ";\n\n";
+
+    /*
+    Os pesos são transpostos em relação a m_pesos: pesos_L[j * origem + k]
+    é o peso do neurônio k (camada L) para o neurônio j (camada L+1), de modo
+    que o produto escalar de cada neurônio lê memória contínua.
+    */
+    for (size_t L = 0; L + 1 < topologia.size(); L++)
+    {
+        const nn::Matriz &pesos = rede.get_pesos(L);
+        vector<double> transpostos;
+        transpostos.reserve(topologia[L] * topologia[L + 1]);
+        for (size_t j = 0; j < topologia[L + 1]; j++)
+            for (size_t k = 0; k < topologia[L]; k++)
+                transpostos.push_back(pesos[k][j]);
+
+        out << "  alignas(64) static constexpr double pesos_" << L << "[" << transpostos.size() << "] = {";
+        escrever_valores(out, transpostos);
+        out << "};\n\n";
+
+        out << "  alignas(64) static constexpr double biases_" << L << "[" << topologia[L + 1] << "] = {";
+        escrever_valores(out, rede.get_biases(L + 1)); // biases da camada L+1
+        out << "};\n\n";
+    }
+
+    // Só as ativações usadas por alguma camada
+    for (const char *nome_ativacao : {"ReLU", "tanh", "sigmoid"})
+    {
+        if (find(ativacoes.begin(), ativacoes.end(), nome_ativacao) == ativacoes.end())
+            continue;
+
+        out << "  inline double ativacao_" << nome_ativacao << "(double x)\n  {\n";
+        if (string(nome_ativacao) == "ReLU")
+            out << "    return x > 0.0 ? x : 0.0;\n";
+        else if (string(nome_ativacao) == "tanh")
+            out << "    return std::tanh(x);\n";
+        else
+            out << "    return 1.0 / (1.0 + std::exp(-x));\n";
+        out << "  }\n\n";
+    }
+
+    out << "  // Uma camada densa de tamanho fixo: saida = ATIVACAO(W x + b) (nullptr = sem ativação)\n";
+    out << "  template <std::size_t ORIGEM, std::size_t DESTINO, double (*ATIVACAO)(double)>\n";
+    out << "  inline void camada(const double *pesos, const double *biases, const double *entrada, double *saida)\n";
+    out << "  {\n";
+    out << "    for (std::size_t j = 0; j < DESTINO; j++)\n";
+    out << "    {\n";
+    out << "      double soma = biases[j];\n";
+    out << "      for (std::size_t k = 0; k < ORIGEM; k++)\n";
+    out << "        soma += pesos[j * ORIGEM + k] * entrada[k];\n";
+    out << "      if constexpr (ATIVACAO != nullptr)\n";
+    out << "        soma = ATIVACAO(soma);\n";
+    out << "      saida[j] = soma;\n";
+    out << "    }\n";
+    out << "  }\n\n";
+
+    const size_t ultima = topologia.size() - 2;
+
+    out << "  // Logits de saída (antes da ativação de saída). Sem alocações nem threads\n";
+    out << "  inline void logits(const double *entrada, double *saida)\n  {\n";
+    for (size_t L = 1; L <= ultima; L++)
+        out << "    double c" << L << "[" << topologia[L] << "];\n";
+    for (size_t L = 0; L <= ultima; L++)
+    {
+        string de = L == 0 ? "entrada" : "c" + to_string(L);
+        string para = L == ultima ? "saida" : "c" + to_string(L + 1);
+        string ativar = L == ultima ? "nullptr" : "ativacao_" + ativacoes[L];
+        out << "    camada<" << topologia[L] << ", " << topologia[L + 1] << ", " << ativar
+            << ">(pesos_" << L << ", biases_" << L << ", " << de << ", " << para << ");\n";
+    }
+    out << "  }\n\n";
+
+    out << "  // Saída da rede, igual a Sequencial::feed_forward\n";
+    out << "  inline void feed_forward(const double *entrada, double *saida)\n  {\n";
+    out << "    logits(entrada, saida);\n";
+    if (saida == "SCE")
+    {
+        out << "\n    double max_val = saida[0];\n";
+        out << "    for (std::size_t i = 1; i < n_saidas; i++)\n";
+        out << "      max_val = saida[i] > max_val ? saida[i] : max_val;\n\n";
+        out << "    double soma = 0.0;\n";
+        out << "    for (std::size_t i = 0; i < n_saidas; i++)\n";
+        out << "    {\n";
+        out << "      saida[i] = std::exp(saida[i] - max_val);\n";
+        out << "      soma += saida[i];\n";
+        out << "    }\n\n";
+        out << "    for (std::size_t i = 0; i < n_saidas; i++)\n";
+        out << "      saida[i] /= soma;\n";
+    }
+    out << "  }\n\n";
+
+    out << "  inline std::array<double, n_saidas> feed_forward(const std::array<double, n_entradas> &entrada)\n  {\n";
+    out << "    std::array<double, n_saidas> saida;\n";
+    out << "    feed_forward(entrada.data(), saida.data());\n";
+    out << "    return saida;\n";
+    out << "  }\n\n";
+
+    out << "  // Índice da maior saída, direto dos logits (sem a ativação de saída)\n";
+    out << "  inline std::size_t prever_classe(const double *entrada)\n  {\n";
+    out << "    double saida[n_saidas];\n";
+    out << "    logits(entrada, saida);\n\n";
+    out << "    std::size_t melhor = 0;\n";
+    out << "    for (std::size_t i = 1; i < n_saidas; i++)\n";
+    out << "      melhor = saida[i] > saida[melhor] ? i : melhor;\n";
+    out << "    return melhor;\n";
+    out << "  }\n";
+
+    out << "} // namespace " << ns << "\n\n";
+    out << "#endif // _" << guarda << "_H\n";
+
+    return static_cast<bool>(out);
+}
+
+int main (int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cerr << "Uso: " << argv[0] << " <modelo.txt> <saida.h> [nome]" << endl;
+        return 1;
+    }
+
+    string caminho_modelo = argv[1];
+    string caminho_saida = argv[2];
+    string nome = argc > 3 ? argv[3] : nome_base(caminho_modelo);
+
+    try
+    {
+        nn::Sequencial rede(caminho_modelo);
+
+        // O código gerado não tem normalização em lote: ela vai para os pesos
+        rede.incorporar_normalizacao();
+
+        // Gera em memória e só então escreve: um erro não deixa um header pela metade
+        ostringstream codigo;
+        if (!gerar_header(rede, caminho_modelo, nome, codigo))
+            return 1;
+
+        ofstream saida(caminho_saida, ios::trunc);
+        saida << codigo.str();
+        if (!saida)
+        {
+            cerr << "ERRO: não foi possível escrever " << caminho_saida << endl;
+            return 1;
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERRO: " << caminho_modelo << ": " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include "contadores.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace nn;
+
+namespace
+{
+    int64_t agora_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+#ifdef __linux__
+    // Tipo e configuração do perf para cada EventoHardware
+    struct DescricaoEvento
+    {
+        uint32_t tipo;
+        uint64_t config;
+    };
+
+    const DescricaoEvento descricoes[N_EVENTOS_HARDWARE] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+
+    int abrir_evento(const DescricaoEvento &descricao)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = descricao.tipo;
+        attr.config = descricao.config;
+        attr.exclude_kernel = 1; // funciona com perf_event_paranoid = 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // pid 0, cpu -1: só a thread atual, em qualquer CPU
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+}
+
+//
+// MEDIÇÃO
+//
+
+const char *nn::nome_evento(EventoHardware evento)
+{
+    static const char *nomes[N_EVENTOS_HARDWARE] = {"ciclos", "instruções", "faltas L1d", "faltas LLC",
+                                                    "desvios errados"};
+    return nomes[evento];
+}
+
+double Medicao::ipc() const
+{
+    if (eventos[CICLOS] <= 0 || eventos[INSTRUCOES] < 0)
+        return -1.0;
+    return static_cast<double>(eventos[INSTRUCOES]) / eventos[CICLOS];
+}
+
+double Medicao::gflops() const
+{
+    return segundos > 0.0 ? flops / segundos * 1e-9 : -1.0;
+}
+
+double Medicao::banda_gbs() const
+{
+    if (eventos[FALTAS_LLC] < 0 || segundos <= 0.0)
+        return -1.0;
+    return eventos[FALTAS_LLC] * 64.0 / segundos * 1e-9;
+}
+
+Medicao &Medicao::operator+=(const Medicao &outra)
+{
+    // Somando a uma medição vazia, os eventos são os da outra. Fora isso,
+    // um evento indisponível em qualquer das parcelas fica indisponível
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        if (chamadas == 0)
+            eventos[e] = outra.eventos[e];
+        else if (eventos[e] < 0 || outra.eventos[e] < 0)
+            eventos[e] = -1;
+        else
+            eventos[e] += outra.eventos[e];
+    }
+
+    chamadas += outra.chamadas;
+    segundos += outra.segundos;
+    flops += outra.flops;
+
+    return *this;
+}
+
+//
+// CONTADORES DE HARDWARE
+//
+
+ContadoresHardware::ContadoresHardware()
+{
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+        m_fds[e] = -1;
+
+#ifdef __linux__
+    int ultimo_errno = 0;
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        m_fds[e] = abrir_evento(descricoes[e]);
+        if (m_fds[e] < 0)
+            ultimo_errno = errno;
+    }
+
+    if (!disponivel())
+    {
+        m_erro = std::string("perf_event_open falhou: ") + std::strerror(ultimo_errno);
+        if (ultimo_errno == EACCES || ultimo_errno == EPERM)
+            m_erro += " (veja /proc/sys/kernel/perf_event_paranoid)";
+    }
+#else
+    m_erro = "contadores de hardware só são suportados no Linux";
+#endif
+
+    iniciar();
+}
+
+ContadoresHardware::~ContadoresHardware()
+{
+#ifdef __linux__
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        if (m_fds[e] >= 0)
+            close(m_fds[e]);
+    }
+#endif
+}
+
+bool ContadoresHardware::disponivel() const
+{
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        if (m_fds[e] >= 0)
+            return true;
+    }
+    return false;
+}
+
+void ContadoresHardware::ler(Leitura &leitura) const
+{
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        leitura.valor[e] = leitura.habilitado[e] = leitura.rodando[e] = 0;
+
+#ifdef __linux__
+        // Os contadores ficam sempre ligados: medir é a diferença entre duas leituras
+        uint64_t dados[3];
+        if (m_fds[e] >= 0 && read(m_fds[e], dados, sizeof(dados)) == sizeof(dados))
+        {
+            leitura.valor[e] = dados[0];
+            leitura.habilitado[e] = dados[1];
+            leitura.rodando[e] = dados[2];
+        }
+#endif
+    }
+
+    leitura.ns = agora_ns();
+}
+
+void ContadoresHardware::iniciar()
+{
+    ler(m_inicio);
+}
+
+Medicao ContadoresHardware::parar()
+{
+    Leitura fim;
+    ler(fim);
+
+    return diferenca(m_inicio, fim);
+}
+
+Medicao ContadoresHardware::diferenca(const Leitura &inicio, const Leitura &fim) const
+{
+    Medicao medicao;
+    medicao.chamadas = 1;
+    medicao.segundos = (fim.ns - inicio.ns) * 1e-9;
+
+    for (int e = 0; e < N_EVENTOS_HARDWARE; e++)
+    {
+        if (m_fds[e] < 0)
+            continue;
+
+        // Com mais eventos que contadores físicos, o kernel reveza os
+        // eventos: a contagem é extrapolada pelo tempo em que cada um rodou
+        uint64_t valor = fim.valor[e] - inicio.valor[e];
+        uint64_t habilitado = fim.habilitado[e] - inicio.habilitado[e];
+        uint64_t rodando = fim.rodando[e] - inicio.rodando[e];
+
+        if (rodando > 0 && rodando < habilitado)
+            valor = static_cast<uint64_t>(static_cast<double>(valor) * habilitado / rodando);
+
+        medicao.eventos[e] = static_cast<int64_t>(valor);
+    }
+
+    return medicao;
+}
+
+//
+// REGIÕES DA REDE
+//
+
+namespace
+{
+    std::atomic<bool> regioes_ligadas{false};
+
+    std::mutex trava_totais;
+    Medicao totais[contadores::N_REGIOES];
+
+    ContadoresHardware &contadores_da_thread()
+    {
+        thread_local std::unique_ptr<ContadoresHardware> contadores = std::make_unique<ContadoresHardware>();
+        return *contadores;
+    }
+}
+
+const char *contadores::nome_regiao(Regiao regiao)
+{
+    static const char *nomes[N_REGIOES] = {"forward (produto matriz-vetor)", "backward", "otimizador (Adam)"};
+    return nomes[regiao];
+}
+
+void contadores::habilitar(bool ligado)
+{
+    regioes_ligadas.store(ligado, std::memory_order_relaxed);
+}
+
+bool contadores::habilitado()
+{
+    return regioes_ligadas.load(std::memory_order_relaxed);
+}
+
+Medicao contadores::total(Regiao regiao)
+{
+    std::lock_guard<std::mutex> lock(trava_totais);
+    return totais[regiao];
+}
+
+void contadores::zerar()
+{
+    std::lock_guard<std::mutex> lock(trava_totais);
+    for (auto &t : totais)
+        t = Medicao();
+}
+
+bool contadores::disponivel(std::string *erro)
+{
+    ContadoresHardware &c = contadores_da_thread();
+    if (erro)
+        *erro = c.erro();
+    return c.disponivel();
+}
+
+contadores::Escopo::Escopo(Regiao regiao, double flops)
+    : m_regiao(regiao), m_flops(flops), m_contadores(nullptr)
+{
+    if (!habilitado())
+        return;
+
+    m_contadores = &contadores_da_thread();
+    m_contadores->ler(m_inicio);
+}
+
+contadores::Escopo::~Escopo()
+{
+    if (!m_contadores)
+        return;
+
+    ContadoresHardware::Leitura fim;
+    m_contadores->ler(fim);
+
+    Medicao medicao = m_contadores->diferenca(m_inicio, fim);
+    medicao.flops = m_flops;
+
+    std::lock_guard<std::mutex> lock(trava_totais);
+    totais[m_regiao] += medicao;
+}
@@ -0,0 +1,314 @@
+#include "convolucao.h"
+#include "contadores.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace nn;
+
+namespace
+{
+    // Aplica a ativação no lugar
+    void ativar(const func &ativacao, double *valores, size_t n)
+    {
+        if (ativacao.funcao_vetor)
+        {
+            ativacao.funcao_vetor(valores, valores, n);
+            return;
+        }
+
+        for (size_t i = 0; i < n; i++)
+            valores[i] = ativacao.funcao(valores[i]);
+    }
+}
+
+//
+// CONV2D
+//
+
+Conv2D::Conv2D(size_t filtros, size_t kernel, size_t passo, size_t preenchimento, func ativacao)
+    : m_filtros(filtros), m_kernel(kernel), m_passo(passo), m_preenchimento(preenchimento), m_ativacao(ativacao)
+{
+    if (filtros == 0 || kernel == 0 || passo == 0)
+        throw std::invalid_argument("Conv2D precisa de filtros, kernel e passo maiores que zero");
+}
+
+void Conv2D::configurar(const Formato3D &entrada)
+{
+    if (entrada.altura + 2 * m_preenchimento < m_kernel || entrada.largura + 2 * m_preenchimento < m_kernel)
+        throw std::invalid_argument("kernel da Conv2D maior que a imagem de entrada");
+
+    m_entrada = entrada;
+    m_saida.canais = m_filtros;
+    m_saida.altura = (entrada.altura + 2 * m_preenchimento - m_kernel) / m_passo + 1;
+    m_saida.largura = (entrada.largura + 2 * m_preenchimento - m_kernel) / m_passo + 1;
+
+    // He (uniforme): a variância da saída não depende do tamanho da janela
+    const size_t n_pesos = m_filtros * linhas_colunas();
+    std::random_device rd;
+    std::mt19937 gerador(rd());
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    const double limite = std::sqrt(6.0 / linhas_colunas());
+
+    m_parametros.assign(n_pesos + m_filtros, 0.0);
+    for (size_t i = 0; i < n_pesos; i++)
+        m_parametros[i] = limite * dist(gerador);
+}
+
+size_t Conv2D::tamanho_auxiliar() const
+{
+    // As colunas do im2col e, se a derivada precisar deles, os logits
+    size_t tamanho = linhas_colunas() * posicoes();
+    if (!m_ativacao.multiplicar_derivada)
+        tamanho += m_saida.tamanho();
+    return tamanho;
+}
+
+void Conv2D::im2col(const double *x, double *colunas) const
+{
+    const size_t k = m_kernel;
+    const size_t n_posicoes = posicoes();
+
+    // Linha (c, ky, kx): o pixel que cada posição de saída vê naquele ponto da janela
+    for (size_t c = 0; c < m_entrada.canais; c++)
+        for (size_t ky = 0; ky < k; ky++)
+            for (size_t kx = 0; kx < k; kx++)
+            {
+                double *linha = colunas + ((c * k + ky) * k + kx) * n_posicoes;
+
+                for (size_t oy = 0; oy < m_saida.altura; oy++)
+                {
+                    // Posição na entrada, já descontado o preenchimento (pode sair da imagem)
+                    long y = (long)(oy * m_passo + ky) - (long)m_preenchimento;
+                    bool dentro_y = y >= 0 && y < (long)m_entrada.altura;
+
+                    for (size_t ox = 0; ox < m_saida.largura; ox++)
+                    {
+                        long xx = (long)(ox * m_passo + kx) - (long)m_preenchimento;
+                        bool dentro = dentro_y && xx >= 0 && xx < (long)m_entrada.largura;
+
+                        linha[oy * m_saida.largura + ox] =
+                            dentro ? x[(c * m_entrada.altura + y) * m_entrada.largura + xx] : 0.0;
+                    }
+                }
+            }
+}
+
+void Conv2D::col2im(const double *colunas, double *dx) const
+{
+    const size_t k = m_kernel;
+    const size_t n_posicoes = posicoes();
+
+    // Inverso do im2col: cada pixel soma os gradientes de todas as janelas que o viram
+    std::fill(dx, dx + m_entrada.tamanho(), 0.0);
+
+    for (size_t c = 0; c < m_entrada.canais; c++)
+        for (size_t ky = 0; ky < k; ky++)
+            for (size_t kx = 0; kx < k; kx++)
+            {
+                const double *linha = colunas + ((c * k + ky) * k + kx) * n_posicoes;
+
+                for (size_t oy = 0; oy < m_saida.altura; oy++)
+                {
+                    long y = (long)(oy * m_passo + ky) - (long)m_preenchimento;
+                    if (y < 0 || y >= (long)m_entrada.altura)
+                        continue;
+
+                    for (size_t ox = 0; ox < m_saida.largura; ox++)
+                    {
+                        long xx = (long)(ox * m_passo + kx) - (long)m_preenchimento;
+                        if (xx >= 0 && xx < (long)m_entrada.largura)
+                            dx[(c * m_entrada.altura + y) * m_entrada.largura + xx] += linha[oy * m_saida.largura + ox];
+                    }
+                }
+            }
+}
+
+void Conv2D::forward(const double *x, double *y, double *auxiliar, ContextoExecucao &contexto) const
+{
+    contadores::Escopo medir(contadores::FORWARD, flops());
+
+    const size_t n_linhas = linhas_colunas();
+    const size_t n_posicoes = posicoes();
+    const double *pesos = m_parametros.data();
+    const double *biases = pesos + m_filtros * n_linhas;
+
+    double *colunas = auxiliar;
+    im2col(x, colunas);
+
+    // y (filtros x posições) = pesos (filtros x linhas) * colunas (linhas x posições),
+    // com os filtros divididos entre as threads
+    contexto.paralelo_para(m_filtros, n_linhas * n_posicoes,
+        [&](size_t inicio, size_t fim)
+        {
+            produto_matrizes(pesos + inicio * n_linhas, false, colunas, false, y + inicio * n_posicoes,
+                             fim - inicio, n_linhas, n_posicoes);
+
+            for (size_t f = inicio; f < fim; f++)
+            {
+                double *saida = y + f * n_posicoes;
+                for (size_t p = 0; p < n_posicoes; p++)
+                    saida[p] += biases[f];
+            }
+        });
+
+    if (!m_ativacao.multiplicar_derivada)
+        std::copy(y, y + m_saida.tamanho(), colunas + n_linhas * n_posicoes);
+
+    ativar(m_ativacao, y, m_saida.tamanho());
+}
+
+void Conv2D::backward(const double *, const double *y, double *auxiliar, double *dy, double *dx,
+                      double *gradientes, bool acumular, ContextoExecucao &contexto) const
+{
+    // Gradientes dos pesos (2 * pesos * posições) e, fora da primeira camada, das colunas (o mesmo)
+    contadores::Escopo medir(contadores::BACKWARD, dx ? 2.0 * flops() : flops());
+
+    const size_t n_linhas = linhas_colunas();
+    const size_t n_posicoes = posicoes();
+    const size_t n_saida = m_saida.tamanho();
+    const double *pesos = m_parametros.data();
+    double *colunas = auxiliar;
+
+    // dy passa a ser o gradiente em relação aos logits
+    if (m_ativacao.multiplicar_derivada)
+    {
+        m_ativacao.multiplicar_derivada(y, dy, n_saida);
+    }
+    else
+    {
+        const double *logits = colunas + n_linhas * n_posicoes;
+        for (size_t i = 0; i < n_saida; i++)
+            dy[i] *= m_ativacao.derivada(logits[i]);
+    }
+
+    double *gradientes_pesos = gradientes;
+    double *gradientes_biases = gradientes + m_filtros * n_linhas;
+
+    // pesos (filtros x linhas) += dy (filtros x posições) * colunasᵀ
+    contexto.paralelo_para(m_filtros, n_linhas * n_posicoes,
+        [&](size_t inicio, size_t fim)
+        {
+            produto_matrizes(dy + inicio * n_posicoes, false, colunas, true, gradientes_pesos + inicio * n_linhas,
+                             fim - inicio, n_posicoes, n_linhas, acumular);
+
+            for (size_t f = inicio; f < fim; f++)
+            {
+                double soma = 0.0;
+                for (size_t p = 0; p < n_posicoes; p++)
+                    soma += dy[f * n_posicoes + p];
+                gradientes_biases[f] = (acumular ? gradientes_biases[f] : 0.0) + soma;
+            }
+        });
+
+    if (!dx)
+        return;
+
+    // As colunas já foram usadas: viram o gradiente delas, pesosᵀ * dy, e
+    // voltam para a imagem
+    produto_matrizes(pesos, true, dy, false, colunas, n_linhas, m_filtros, n_posicoes);
+
+    col2im(colunas, dx);
+}
+
+double Conv2D::flops() const
+{
+    return 2.0 * m_filtros * linhas_colunas() * posicoes();
+}
+
+std::string Conv2D::descricao() const
+{
+    return std::to_string(m_filtros) + ' ' + std::to_string(m_kernel) + ' ' + std::to_string(m_passo) + ' ' +
+           std::to_string(m_preenchimento) + ' ' + m_ativacao.nome;
+}
+
+//
+// MAXPOOL2D
+//
+
+MaxPool2D::MaxPool2D(size_t tamanho, size_t passo) : m_tamanho(tamanho), m_passo(passo > 0 ? passo : tamanho)
+{
+    if (tamanho == 0)
+        throw std::invalid_argument("MaxPool2D precisa de uma janela maior que zero");
+}
+
+void MaxPool2D::configurar(const Formato3D &entrada)
+{
+    if (entrada.altura < m_tamanho || entrada.largura < m_tamanho)
+        throw std::invalid_argument("janela da MaxPool2D maior que a imagem de entrada");
+
+    m_entrada = entrada;
+    m_saida.canais = entrada.canais;
+    m_saida.altura = (entrada.altura - m_tamanho) / m_passo + 1;
+    m_saida.largura = (entrada.largura - m_tamanho) / m_passo + 1;
+}
+
+void MaxPool2D::forward(const double *x, double *y, double *auxiliar, ContextoExecucao &) const
+{
+    for (size_t c = 0; c < m_saida.canais; c++)
+        for (size_t oy = 0; oy < m_saida.altura; oy++)
+            for (size_t ox = 0; ox < m_saida.largura; ox++)
+            {
+                size_t melhor = (c * m_entrada.altura + oy * m_passo) * m_entrada.largura + ox * m_passo;
+
+                for (size_t ky = 0; ky < m_tamanho; ky++)
+                    for (size_t kx = 0; kx < m_tamanho; kx++)
+                    {
+                        size_t i = (c * m_entrada.altura + oy * m_passo + ky) * m_entrada.largura + ox * m_passo + kx;
+                        if (x[i] > x[melhor])
+                            melhor = i;
+                    }
+
+                size_t o = (c * m_saida.altura + oy) * m_saida.largura + ox;
+                y[o] = x[melhor];
+                auxiliar[o] = static_cast<double>(melhor);
+            }
+}
+
+void MaxPool2D::backward(const double *, const double *, double *auxiliar, double *dy, double *dx,
+                         double *, bool, ContextoExecucao &) const
+{
+    if (!dx)
+        return;
+
+    // Só o máximo de cada janela recebe o gradiente
+    std::fill(dx, dx + m_entrada.tamanho(), 0.0);
+    for (size_t o = 0; o < m_saida.tamanho(); o++)
+        dx[static_cast<size_t>(auxiliar[o])] += dy[o];
+}
+
+double MaxPool2D::flops() const
+{
+    return static_cast<double>(m_saida.tamanho()) * m_tamanho * m_tamanho;
+}
+
+std::string MaxPool2D::descricao() const
+{
+    return std::to_string(m_tamanho) + ' ' + std::to_string(m_passo);
+}
+
+//
+// FLATTEN
+//
+
+void Flatten::configurar(const Formato3D &entrada)
+{
+    m_entrada = entrada;
+    m_saida = {entrada.tamanho(), 1, 1};
+}
+
+void Flatten::forward(const double *x, double *y, double *, ContextoExecucao &) const
+{
+    // CHW já é plano
+    std::copy(x, x + m_entrada.tamanho(), y);
+}
+
+void Flatten::backward(const double *, const double *, double *, double *dy, double *dx,
+                       double *, bool, ContextoExecucao &) const
+{
+    if (dx)
+        std::copy(dy, dy + m_entrada.tamanho(), dx);
+}
@@ -0,0 +1,57 @@
+#include "dados.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+using namespace nn;
+
+VisaoDados::VisaoDados(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas)
+    : m_entradas(&entradas), m_saidas(&saidas), m_inicio(0), m_fim(entradas.size())
+{
+    if (entradas.size() != saidas.size())
+        throw std::invalid_argument("entradas e saídas com números de amostras diferentes");
+}
+
+VisaoDados::VisaoDados(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas,
+                       std::shared_ptr<const std::vector<size_t>> indices)
+    : m_entradas(&entradas), m_saidas(&saidas), m_indices(std::move(indices)), m_inicio(0)
+{
+    if (!m_indices)
+        throw std::invalid_argument("lista de índices nula");
+
+    m_fim = m_indices->size();
+
+    for (size_t i : *m_indices)
+    {
+        if (i >= entradas.size() || i >= saidas.size())
+            throw std::invalid_argument("índice fora dos vetores de amostras");
+    }
+}
+
+VisaoDados VisaoDados::fatia(size_t inicio, size_t fim) const
+{
+    if (inicio > fim || fim > tamanho())
+        throw std::out_of_range("fatia fora da visão de dados");
+
+    VisaoDados parte = *this;
+    parte.m_inicio = m_inicio + inicio;
+    parte.m_fim = m_inicio + fim;
+    return parte;
+}
+
+VisaoDados VisaoDados::permutada(uint64_t semente) const
+{
+    auto indices = std::make_shared<std::vector<size_t>>(tamanho());
+    for (size_t i = 0; i < tamanho(); i++)
+        (*indices)[i] = indice(i);
+
+    std::mt19937_64 gerador(semente);
+    std::shuffle(indices->begin(), indices->end(), gerador);
+
+    VisaoDados resultado = *this;
+    resultado.m_indices = std::move(indices);
+    resultado.m_inicio = 0;
+    resultado.m_fim = resultado.m_indices->size();
+    return resultado;
+}
@@ -0,0 +1,513 @@
+#include "distribuido.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace nn;
+
+namespace
+{
+    const auto tempo_limite_conexao = std::chrono::seconds(60);
+
+    //
+    // MEMÓRIA COMPARTILHADA
+    //
+
+    /*
+    Canal de um produtor e um consumidor num segmento POSIX shm:
+    um buffer circular de doubles com contadores de escrita e leitura.
+    O consumidor cria o segmento e o produtor espera ele ficar pronto.
+    */
+    struct CabecalhoCanal
+    {
+        std::atomic<uint64_t> magico;
+        std::atomic<uint64_t> escrito;
+        std::atomic<uint64_t> lido;
+        uint64_t capacidade;
+    };
+
+    const uint64_t MAGICO_CANAL = 0x6e6e5f616e656c31; // "nn_anel1"
+    const size_t CAPACIDADE_CANAL = 1 << 16;          // em doubles
+
+    struct Mapeamento
+    {
+        CabecalhoCanal *cabecalho = nullptr;
+        double *dados = nullptr;
+        size_t bytes = 0;
+
+        void mapear(int fd, size_t tamanho)
+        {
+            void *p = mmap(nullptr, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("falha no mmap do canal de memória compartilhada");
+
+            bytes = tamanho;
+            cabecalho = static_cast<CabecalhoCanal *>(p);
+            dados = reinterpret_cast<double *>(static_cast<char *>(p) + sizeof(CabecalhoCanal));
+        }
+
+        void desmapear()
+        {
+            if (cabecalho)
+                munmap(cabecalho, bytes);
+            cabecalho = nullptr;
+            dados = nullptr;
+        }
+
+        ~Mapeamento()
+        {
+            desmapear();
+        }
+    };
+
+    class TransporteMemoria : public Transporte
+    {
+    public:
+        TransporteMemoria(const ConfigDistribuido &config)
+        {
+            size_t proximo = (config.rank + 1) % config.n_processos;
+
+            // Canal de entrada: criado por este processo
+            m_nome_entrada = "/" + config.sessao + "_canal_" + std::to_string(config.rank);
+            size_t tamanho = sizeof(CabecalhoCanal) + CAPACIDADE_CANAL * sizeof(double);
+
+            shm_unlink(m_nome_entrada.c_str()); // restos de uma execução anterior
+            int fd = shm_open(m_nome_entrada.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0 || ftruncate(fd, tamanho) != 0)
+                throw std::runtime_error("falha ao criar o canal " + m_nome_entrada);
+
+            m_entrada.mapear(fd, tamanho);
+            close(fd);
+
+            m_entrada.cabecalho->capacidade = CAPACIDADE_CANAL;
+            m_entrada.cabecalho->escrito.store(0);
+            m_entrada.cabecalho->lido.store(0);
+            m_entrada.cabecalho->magico.store(MAGICO_CANAL, std::memory_order_release);
+
+            // Canal de saída: criado pelo próximo processo
+            std::string nome_saida = "/" + config.sessao + "_canal_" + std::to_string(proximo);
+            auto limite = std::chrono::steady_clock::now() + tempo_limite_conexao;
+
+            for (;;)
+            {
+                fd = shm_open(nome_saida.c_str(), O_RDWR, 0600);
+                if (fd >= 0)
+                {
+                    struct stat info;
+                    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= tamanho)
+                    {
+                        m_saida.mapear(fd, tamanho);
+                        close(fd);
+                        if (m_saida.cabecalho->magico.load(std::memory_order_acquire) == MAGICO_CANAL)
+                            break;
+                        m_saida.desmapear();
+                    }
+                    else
+                    {
+                        close(fd);
+                    }
+                }
+
+                if (std::chrono::steady_clock::now() > limite)
+                    throw std::runtime_error("tempo esgotado esperando o canal " + nome_saida);
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        ~TransporteMemoria() override
+        {
+            m_entrada.cabecalho->magico.store(0);
+            shm_unlink(m_nome_entrada.c_str());
+        }
+
+        void trocar(const double *envio, size_t n_envio, double *recebido, size_t n_recebido) override
+        {
+            CabecalhoCanal &saida = *m_saida.cabecalho;
+            CabecalhoCanal &entrada = *m_entrada.cabecalho;
+            const uint64_t cap = saida.capacidade;
+
+            size_t enviados = 0, lidos = 0;
+
+            while (enviados < n_envio || lidos < n_recebido)
+            {
+                bool progrediu = false;
+
+                if (enviados < n_envio)
+                {
+                    uint64_t escrito = saida.escrito.load(std::memory_order_relaxed);
+                    uint64_t livre = cap - (escrito - saida.lido.load(std::memory_order_acquire));
+                    size_t k = std::min<size_t>(livre, n_envio - enviados);
+
+                    for (size_t i = 0; i < k; i++)
+                        m_saida.dados[(escrito + i) % cap] = envio[enviados + i];
+
+                    saida.escrito.store(escrito + k, std::memory_order_release);
+                    enviados += k;
+                    progrediu |= k > 0;
+                }
+
+                if (lidos < n_recebido)
+                {
+                    uint64_t lido = entrada.lido.load(std::memory_order_relaxed);
+                    uint64_t disponivel = entrada.escrito.load(std::memory_order_acquire) - lido;
+                    size_t k = std::min<size_t>(disponivel, n_recebido - lidos);
+
+                    for (size_t i = 0; i < k; i++)
+                        recebido[lidos + i] = m_entrada.dados[(lido + i) % entrada.capacidade];
+
+                    entrada.lido.store(lido + k, std::memory_order_release);
+                    lidos += k;
+                    progrediu |= k > 0;
+                }
+
+                if (!progrediu)
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        std::string m_nome_entrada;
+        Mapeamento m_entrada, m_saida;
+    };
+
+    //
+    // TCP
+    //
+
+    std::pair<std::string, std::string> separar_endereco(const std::string &endereco)
+    {
+        size_t p = endereco.rfind(':');
+        if (p == std::string::npos)
+            throw std::invalid_argument("endereço sem porta: " + endereco);
+        return {endereco.substr(0, p), endereco.substr(p + 1)};
+    }
+
+    class TransporteTCP : public Transporte
+    {
+    public:
+        TransporteTCP(const ConfigDistribuido &config)
+        {
+            if (config.enderecos.size() != config.n_processos)
+                throw std::invalid_argument("NN_ENDERECOS deve ter um endereço por processo");
+
+            size_t proximo = (config.rank + 1) % config.n_processos;
+
+            int escuta = escutar(separar_endereco(config.enderecos[config.rank]).second);
+            m_saida = conectar(config.enderecos[proximo]);
+
+            m_entrada = accept(escuta, nullptr, nullptr);
+            close(escuta);
+            if (m_entrada < 0)
+                throw std::runtime_error("falha ao aceitar a conexão do processo anterior");
+
+            for (int fd : {m_entrada, m_saida})
+            {
+                int um = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &um, sizeof(um));
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            }
+        }
+
+        ~TransporteTCP() override
+        {
+            close(m_entrada);
+            close(m_saida);
+        }
+
+        void trocar(const double *envio, size_t n_envio, double *recebido, size_t n_recebido) override
+        {
+            const char *saida = reinterpret_cast<const char *>(envio);
+            char *entrada = reinterpret_cast<char *>(recebido);
+            size_t a_enviar = n_envio * sizeof(double), a_receber = n_recebido * sizeof(double);
+            size_t enviados = 0, recebidos = 0;
+
+            while (enviados < a_enviar || recebidos < a_receber)
+            {
+                pollfd fds[2] = {
+                    {m_saida, short(enviados < a_enviar ? POLLOUT : 0), 0},
+                    {m_entrada, short(recebidos < a_receber ? POLLIN : 0), 0},
+                };
+
+                if (poll(fds, 2, -1) < 0)
+                    throw std::runtime_error("falha no poll do anel TCP");
+
+                if (fds[0].revents & POLLOUT)
+                {
+                    ssize_t k = send(m_saida, saida + enviados, a_enviar - enviados, MSG_NOSIGNAL);
+                    if (k < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                        throw std::runtime_error("falha ao enviar para o próximo processo");
+                    if (k > 0) enviados += k;
+                }
+
+                if (fds[1].revents & (POLLIN | POLLHUP))
+                {
+                    ssize_t k = recv(m_entrada, entrada + recebidos, a_receber - recebidos, 0);
+                    if (k == 0)
+                        throw std::runtime_error("o processo anterior fechou a conexão");
+                    if (k < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                        throw std::runtime_error("falha ao receber do processo anterior");
+                    if (k > 0) recebidos += k;
+                }
+            }
+        }
+
+    private:
+        int m_entrada = -1, m_saida = -1;
+
+        static int escutar(const std::string &porta)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            int um = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &um, sizeof(um));
+
+            sockaddr_in endereco{};
+            endereco.sin_family = AF_INET;
+            endereco.sin_addr.s_addr = htonl(INADDR_ANY);
+            endereco.sin_port = htons(std::stoi(porta));
+
+            if (bind(fd, reinterpret_cast<sockaddr *>(&endereco), sizeof(endereco)) != 0 || listen(fd, 1) != 0)
+                throw std::runtime_error("falha ao escutar na porta " + porta);
+
+            return fd;
+        }
+
+        static int conectar(const std::string &endereco)
+        {
+            auto [host, porta] = separar_endereco(endereco);
+            auto limite = std::chrono::steady_clock::now() + tempo_limite_conexao;
+
+            addrinfo dica{};
+            dica.ai_family = AF_INET;
+            dica.ai_socktype = SOCK_STREAM;
+
+            for (;;)
+            {
+                addrinfo *resultado = nullptr;
+                if (getaddrinfo(host.c_str(), porta.c_str(), &dica, &resultado) == 0)
+                {
+                    int fd = socket(AF_INET, SOCK_STREAM, 0);
+                    int ok = connect(fd, resultado->ai_addr, resultado->ai_addrlen);
+                    freeaddrinfo(resultado);
+
+                    if (ok == 0)
+                        return fd;
+                    close(fd);
+                }
+
+                if (std::chrono::steady_clock::now() > limite)
+                    throw std::runtime_error("tempo esgotado conectando em " + endereco);
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    };
+}
+
+//
+// CONFIGURAÇÃO
+//
+
+ConfigDistribuido nn::config_do_ambiente()
+{
+    ConfigDistribuido config;
+
+    if (const char *v = std::getenv("NN_RANK")) config.rank = std::strtoul(v, nullptr, 10);
+    if (const char *v = std::getenv("NN_N_PROCESSOS")) config.n_processos = std::strtoul(v, nullptr, 10);
+    if (const char *v = std::getenv("NN_SESSAO")) config.sessao = v;
+
+    if (const char *v = std::getenv("NN_TRANSPORTE"))
+        config.transporte = std::string(v) == "tcp" ? TipoTransporte::TCP : TipoTransporte::MEMORIA_COMPARTILHADA;
+
+    if (const char *v = std::getenv("NN_ENDERECOS"))
+    {
+        std::string lista = v;
+        size_t inicio = 0;
+        while (inicio <= lista.size())
+        {
+            size_t fim = lista.find(',', inicio);
+            if (fim == std::string::npos) fim = lista.size();
+            if (fim > inicio) config.enderecos.push_back(lista.substr(inicio, fim - inicio));
+            inicio = fim + 1;
+        }
+    }
+
+    return config;
+}
+
+std::pair<size_t, size_t> nn::fatia_dados(size_t n, size_t rank, size_t n_processos)
+{
+    size_t por_processo = n / n_processos;
+    return {rank * por_processo, (rank + 1) * por_processo};
+}
+
+//
+// GRUPO DE PROCESSOS
+//
+
+// Thread de comunicação que atende os allreduces assíncronos em ordem
+struct GrupoProcessos::Comunicacao
+{
+    std::mutex mtx;          // protege a fila
+    std::mutex anel;         // um allreduce por vez no anel
+    std::condition_variable cv;
+    std::deque<std::pair<double *, size_t>> fila;
+    size_t pendentes = 0;
+    bool parar = false;
+    std::thread thread;
+};
+
+GrupoProcessos::GrupoProcessos(const ConfigDistribuido &config) : m_config(config)
+{
+    if (m_config.n_processos == 0 || m_config.rank >= m_config.n_processos)
+        throw std::invalid_argument("rank ou número de processos inválido");
+
+    if (m_config.n_processos > 1)
+    {
+        if (m_config.transporte == TipoTransporte::TCP)
+            m_transporte = std::make_unique<TransporteTCP>(m_config);
+        else
+            m_transporte = std::make_unique<TransporteMemoria>(m_config);
+    }
+
+    m_comunicacao = std::make_unique<Comunicacao>();
+    Comunicacao &c = *m_comunicacao;
+
+    c.thread = std::thread([this, &c] {
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lk(c.mtx);
+            c.cv.wait(lk, [&] { return c.parar || !c.fila.empty(); });
+            if (c.fila.empty())
+                return;
+
+            auto [dados, n] = c.fila.front();
+            c.fila.pop_front();
+            lk.unlock();
+
+            {
+                std::lock_guard<std::mutex> trava(c.anel);
+                allreduce_anel(dados, n);
+            }
+
+            lk.lock();
+            c.pendentes--;
+            c.cv.notify_all();
+        }
+    });
+
+    // Garante que o anel inteiro está de pé antes de começar
+    barreira();
+}
+
+GrupoProcessos::~GrupoProcessos()
+{
+    esperar();
+    {
+        std::lock_guard<std::mutex> lk(m_comunicacao->mtx);
+        m_comunicacao->parar = true;
+    }
+    m_comunicacao->cv.notify_all();
+    m_comunicacao->thread.join();
+}
+
+size_t GrupoProcessos::get_rank() const { return m_config.rank; }
+size_t GrupoProcessos::get_n_processos() const { return m_config.n_processos; }
+
+void GrupoProcessos::allreduce_anel(double *dados, size_t n)
+{
+    const size_t P = m_config.n_processos;
+    const size_t r = m_config.rank;
+
+    if (P == 1 || n == 0)
+        return;
+
+    auto inicio = [&](size_t pedaco) { return pedaco * n / P; };
+    auto tamanho = [&](size_t pedaco) { return inicio(pedaco + 1) - inicio(pedaco); };
+
+    m_recebido.resize(std::max(m_recebido.size(), n / P + 1));
+
+    // Reduce-scatter: no passo s, envia o pedaço (r - s) e soma o (r - s - 1).
+    // No fim, o processo r tem a soma completa do pedaço (r + 1).
+    for (size_t s = 0; s + 1 < P; s++)
+    {
+        size_t envia = (r + P - s) % P;
+        size_t recebe = (r + 2 * P - s - 1) % P;
+
+        m_transporte->trocar(dados + inicio(envia), tamanho(envia), m_recebido.data(), tamanho(recebe));
+
+        double *destino = dados + inicio(recebe);
+        for (size_t i = 0; i < tamanho(recebe); i++)
+            destino[i] += m_recebido[i];
+    }
+
+    // All-gather: cada pedaço completo dá a volta no anel
+    for (size_t s = 0; s + 1 < P; s++)
+    {
+        size_t envia = (r + 1 + P - s) % P;
+        size_t recebe = (r + P - s) % P;
+
+        m_transporte->trocar(dados + inicio(envia), tamanho(envia), dados + inicio(recebe), tamanho(recebe));
+    }
+}
+
+void GrupoProcessos::allreduce(double *dados, size_t n)
+{
+    // Os assíncronos já enfileirados vão primeiro, mantendo a ordem igual em todos
+    esperar();
+
+    std::lock_guard<std::mutex> trava(m_comunicacao->anel);
+    allreduce_anel(dados, n);
+}
+
+void GrupoProcessos::broadcast(double *dados, size_t n, size_t raiz)
+{
+    if (m_config.rank != raiz)
+        std::fill(dados, dados + n, 0.0);
+
+    allreduce(dados, n);
+}
+
+void GrupoProcessos::barreira()
+{
+    double x = 0.0;
+    allreduce(&x, 1);
+}
+
+void GrupoProcessos::allreduce_assincrono(double *dados, size_t n)
+{
+    Comunicacao &c = *m_comunicacao;
+    {
+        std::lock_guard<std::mutex> lk(c.mtx);
+        c.fila.emplace_back(dados, n);
+        c.pendentes++;
+    }
+    c.cv.notify_all();
+}
+
+void GrupoProcessos::esperar()
+{
+    Comunicacao &c = *m_comunicacao;
+    std::unique_lock<std::mutex> lk(c.mtx);
+    c.cv.wait(lk, [&] { return c.pendentes == 0; });
+}
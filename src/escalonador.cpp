@@ -0,0 +1,256 @@
+#include "escalonador.h"
+#include "execucao.h"
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+using namespace nn;
+
+//
+// GRAFO DE TAREFAS
+//
+
+size_t GrafoTarefas::adicionar_tarefa(std::function<void()> tarefa)
+{
+    m_tarefas.push_back(std::move(tarefa));
+    m_dependentes.emplace_back();
+    m_n_dependencias.push_back(0);
+    return m_tarefas.size() - 1;
+}
+
+void GrafoTarefas::adicionar_dependencia(size_t antes, size_t depois)
+{
+    m_dependentes[antes].push_back(depois);
+    m_n_dependencias[depois]++;
+}
+
+void GrafoTarefas::limpar()
+{
+    m_tarefas.clear();
+    m_dependentes.clear();
+    m_n_dependencias.clear();
+}
+
+size_t GrafoTarefas::tamanho() const { return m_tarefas.size(); }
+bool GrafoTarefas::vazio() const { return m_tarefas.empty(); }
+
+//
+// ESCALONADOR
+//
+
+namespace
+{
+    // Fila dupla de um trabalhador
+    struct FilaTrabalhador
+    {
+        std::mutex mtx;
+        std::deque<size_t> tarefas;
+
+        void empilhar(size_t t)
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            tarefas.push_back(t);
+        }
+
+        // O dono retira do fim
+        bool retirar(size_t &t)
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (tarefas.empty())
+                return false;
+            t = tarefas.back();
+            tarefas.pop_back();
+            return true;
+        }
+
+        // Os ladrões retiram do começo
+        bool roubar(size_t &t)
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            if (tarefas.empty())
+                return false;
+            t = tarefas.front();
+            tarefas.pop_front();
+            return true;
+        }
+    };
+}
+
+struct EscalonadorTarefas::Estado
+{
+    std::vector<FilaTrabalhador> filas;
+    std::vector<std::thread> threads;
+
+    std::mutex mtx;
+    std::condition_variable cv_trabalho;
+    std::condition_variable cv_fim;
+    unsigned long geracao = 0;
+    bool parar = false;
+    size_t ativas = 0;
+
+    // Serializa execuções vindas de threads diferentes
+    std::mutex submissao;
+
+    GrafoTarefas *grafo = nullptr;
+    std::atomic<size_t> restantes{0};
+
+    explicit Estado(size_t n) : filas(n)
+    {
+        for (size_t i = 1; i < n; i++)
+            threads.emplace_back([this, i] { laco(i); });
+    }
+
+    ~Estado()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            parar = true;
+        }
+        cv_trabalho.notify_all();
+
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void rodar_tarefa(size_t id, size_t trabalhador)
+    {
+        grafo->m_tarefas[id]();
+
+        // Libera as tarefas que só esperavam por esta
+        for (size_t dependente : grafo->m_dependentes[id])
+        {
+            if (grafo->m_pendentes[dependente].fetch_sub(1) == 1)
+                filas[trabalhador].empilhar(dependente);
+        }
+
+        restantes.fetch_sub(1);
+    }
+
+    void trabalhar(size_t trabalhador)
+    {
+        RegiaoSerial serial;
+
+        size_t n = filas.size();
+        size_t vitima = trabalhador;
+
+        while (restantes.load() > 0)
+        {
+            size_t id;
+            if (filas[trabalhador].retirar(id))
+            {
+                rodar_tarefa(id, trabalhador);
+                continue;
+            }
+
+            // Fila vazia: tenta roubar dos outros, começando do último roubado
+            bool roubou = false;
+            for (size_t tentativa = 1; tentativa < n && !roubou; tentativa++)
+            {
+                vitima = (vitima + 1) % n;
+                if (vitima != trabalhador && filas[vitima].roubar(id))
+                    roubou = true;
+            }
+
+            if (roubou)
+                rodar_tarefa(id, trabalhador);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void laco(size_t trabalhador)
+    {
+        unsigned long vista = 0;
+
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            cv_trabalho.wait(lk, [&] { return parar || geracao != vista; });
+
+            if (parar)
+                return;
+
+            vista = geracao;
+            ativas++;
+            lk.unlock();
+
+            trabalhar(trabalhador);
+
+            lk.lock();
+            ativas--;
+            if (ativas == 0)
+                cv_fim.notify_all();
+        }
+    }
+};
+
+EscalonadorTarefas::EscalonadorTarefas(size_t n_trabalhadores)
+{
+    if (n_trabalhadores == 0)
+        n_trabalhadores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    m_estado = std::make_unique<Estado>(n_trabalhadores);
+}
+
+EscalonadorTarefas::~EscalonadorTarefas() = default;
+
+size_t EscalonadorTarefas::get_n_trabalhadores() const
+{
+    return m_estado->filas.size();
+}
+
+void EscalonadorTarefas::executar(GrafoTarefas &grafo)
+{
+    if (grafo.vazio())
+        return;
+
+    Estado &e = *m_estado;
+    std::lock_guard<std::mutex> trava_submissao(e.submissao);
+
+    size_t n_tarefas = grafo.tamanho();
+    if (grafo.m_capacidade_pendentes < n_tarefas)
+    {
+        grafo.m_pendentes.reset(new std::atomic<int>[n_tarefas]);
+        grafo.m_capacidade_pendentes = n_tarefas;
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(e.mtx);
+        e.cv_fim.wait(lk, [&] { return e.ativas == 0; });
+
+        e.grafo = &grafo;
+        e.restantes = n_tarefas;
+
+        // As tarefas sem dependências são distribuídas entre as filas
+        size_t proxima_fila = 0;
+        for (size_t i = 0; i < n_tarefas; i++)
+        {
+            grafo.m_pendentes[i] = grafo.m_n_dependencias[i];
+            if (grafo.m_n_dependencias[i] == 0)
+            {
+                e.filas[proxima_fila].empilhar(i);
+                proxima_fila = (proxima_fila + 1) % e.filas.size();
+            }
+        }
+
+        e.geracao++;
+    }
+    e.cv_trabalho.notify_all();
+
+    // A thread chamadora é o trabalhador 0
+    e.trabalhar(0);
+
+    // Espera os outros trabalhadores saírem antes de liberar o grafo
+    std::unique_lock<std::mutex> lk(e.mtx);
+    e.cv_fim.wait(lk, [&] { return e.ativas == 0; });
+    e.grafo = nullptr;
+}
+
+EscalonadorTarefas &nn::escalonador_padrao()
+{
+    static EscalonadorTarefas escalonador;
+    return escalonador;
+}
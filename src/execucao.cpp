@@ -0,0 +1,275 @@
+#include "execucao.h"
+#include "rastreio.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <string>
+
+#ifdef NN_OPENMP
+#include <omp.h>
+#endif
+
+using namespace nn;
+
+namespace
+{
+    // Verdadeiro enquanto a thread executa um bloco de um paralelo_para
+    thread_local bool dentro_de_paralelo = false;
+
+    size_t threads_hardware()
+    {
+        size_t n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+}
+
+//
+// POOL DE THREADS
+//
+
+/*
+Pool persistente: as threads dormem numa variável de condição e acordam a
+cada novo trabalho (identificado por uma geração). Os blocos são distribuídos
+por um contador atômico, e a thread chamadora também processa blocos.
+*/
+struct ContextoExecucao::Pool
+{
+    std::vector<std::thread> threads;
+
+    std::mutex mtx;
+    std::condition_variable cv_trabalho;
+    std::condition_variable cv_fim;
+
+    // Serializa chamadas de paralelo_para vindas de threads diferentes
+    std::mutex submissao;
+
+    // Trabalho atual (escrito com 'mtx' travado)
+    FuncaoBloco funcao = nullptr;
+    const void *dados = nullptr;
+    size_t n = 0;
+    size_t n_blocos = 0;
+    unsigned long geracao = 0;
+    bool parar = false;
+
+    // Threads auxiliares que estão processando o trabalho atual
+    size_t ativas = 0;
+
+    std::atomic<size_t> proximo_bloco{0};
+    std::atomic<size_t> blocos_concluidos{0};
+
+    explicit Pool(size_t n_auxiliares)
+    {
+        for (size_t i = 0; i < n_auxiliares; i++)
+            threads.emplace_back([this, i]
+            {
+                NN_NOMEAR_THREAD("pool " + std::to_string(i + 1));
+                laco();
+            });
+    }
+
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            parar = true;
+        }
+        cv_trabalho.notify_all();
+
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void processar(FuncaoBloco f, const void *d, size_t total, size_t blocos)
+    {
+        size_t b;
+        while ((b = proximo_bloco.fetch_add(1)) < blocos)
+        {
+            size_t inicio = b * total / blocos;
+            size_t fim = (b + 1) * total / blocos;
+
+            {
+                NN_SPAN("bloco", b);
+                dentro_de_paralelo = true;
+                f(d, inicio, fim);
+                dentro_de_paralelo = false;
+            }
+
+            if (blocos_concluidos.fetch_add(1) + 1 == blocos)
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                cv_fim.notify_all();
+            }
+        }
+    }
+
+    void laco()
+    {
+        unsigned long vista = 0;
+
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            cv_trabalho.wait(lk, [&] { return parar || geracao != vista; });
+
+            if (parar)
+                return;
+
+            vista = geracao;
+            FuncaoBloco f = funcao;
+            const void *d = dados;
+            size_t total = n, blocos = n_blocos;
+            ativas++;
+            lk.unlock();
+
+            processar(f, d, total, blocos);
+
+            lk.lock();
+            ativas--;
+            if (ativas == 0)
+                cv_fim.notify_all();
+        }
+    }
+
+    void executar(FuncaoBloco f, const void *d, size_t total, size_t blocos)
+    {
+        std::lock_guard<std::mutex> trava_submissao(submissao);
+
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+
+            // Nenhuma thread atrasada pode estar lendo o trabalho anterior
+            cv_fim.wait(lk, [&] { return ativas == 0; });
+
+            funcao = f;
+            dados = d;
+            n = total;
+            n_blocos = blocos;
+            proximo_bloco = 0;
+            blocos_concluidos = 0;
+            geracao++;
+        }
+        cv_trabalho.notify_all();
+
+        processar(f, d, total, blocos);
+
+        // O tempo aqui é o desequilíbrio entre os blocos (aparece no rastreio)
+        NN_SPAN("espera blocos");
+        std::unique_lock<std::mutex> lk(mtx);
+        cv_fim.wait(lk, [&] { return blocos_concluidos.load() == blocos; });
+    }
+};
+
+//
+// CONTEXTO DE EXECUÇÃO
+//
+
+ContextoExecucao::ContextoExecucao(size_t n_threads, size_t grao_minimo)
+    : m_n_threads(0),
+      m_grao_minimo(std::max<size_t>(grao_minimo, 1)),
+      m_modo(ModoExecucao::VAZAO),
+      m_backend(BackendExecucao::POOL)
+{
+    set_n_threads(n_threads);
+}
+
+ContextoExecucao::~ContextoExecucao() = default;
+
+void ContextoExecucao::set_n_threads(size_t n_threads)
+{
+    if (n_threads == 0)
+        n_threads = threads_hardware();
+
+    if (n_threads == m_n_threads && m_pool)
+        return;
+
+    m_pool.reset(); // espera as threads antigas terminarem
+    m_n_threads = n_threads;
+    m_pool = std::make_unique<Pool>(m_n_threads - 1);
+}
+
+void ContextoExecucao::set_grao_minimo(size_t grao_minimo)
+{
+    m_grao_minimo = std::max<size_t>(grao_minimo, 1);
+}
+
+void ContextoExecucao::set_modo(ModoExecucao modo)
+{
+    m_modo = modo;
+}
+
+bool ContextoExecucao::set_backend(BackendExecucao backend)
+{
+#ifndef NN_OPENMP
+    if (backend == BackendExecucao::OPENMP)
+        return false;
+#endif
+    m_backend = backend;
+    return true;
+}
+
+size_t ContextoExecucao::get_n_threads() const { return m_n_threads; }
+size_t ContextoExecucao::get_grao_minimo() const { return m_grao_minimo; }
+ModoExecucao ContextoExecucao::get_modo() const { return m_modo; }
+BackendExecucao ContextoExecucao::get_backend() const { return m_backend; }
+
+size_t ContextoExecucao::calcular_blocos(size_t n, size_t custo_por_item) const
+{
+    if (m_modo == ModoExecucao::LATENCIA || m_n_threads <= 1 || dentro_de_paralelo || n < 2)
+        return 1;
+
+    size_t trabalho = n * std::max<size_t>(custo_por_item, 1);
+    if (trabalho < 2 * m_grao_minimo)
+        return 1;
+
+    // Cada bloco deve ter pelo menos 'm_grao_minimo' de trabalho
+    size_t blocos = std::min(trabalho / m_grao_minimo, m_n_threads);
+    return std::min(blocos, n);
+}
+
+size_t ContextoExecucao::limitar_blocos(size_t n, size_t n_blocos) const
+{
+    if (m_modo == ModoExecucao::LATENCIA || dentro_de_paralelo)
+        return 1;
+
+    return std::min({n_blocos, m_n_threads, n});
+}
+
+void ContextoExecucao::executar(size_t n, size_t n_blocos, FuncaoBloco funcao, const void *dados)
+{
+#ifdef NN_OPENMP
+    if (m_backend == BackendExecucao::OPENMP)
+    {
+        #pragma omp parallel for schedule(static) num_threads(m_n_threads)
+        for (size_t b = 0; b < n_blocos; b++)
+        {
+            NN_SPAN("bloco", b);
+            dentro_de_paralelo = true;
+            funcao(dados, b * n / n_blocos, (b + 1) * n / n_blocos);
+            dentro_de_paralelo = false;
+        }
+        return;
+    }
+#endif
+
+    m_pool->executar(funcao, dados, n, n_blocos);
+}
+
+ContextoExecucao &nn::contexto_padrao()
+{
+    static ContextoExecucao contexto;
+    return contexto;
+}
+
+RegiaoSerial::RegiaoSerial() : m_anterior(dentro_de_paralelo)
+{
+    dentro_de_paralelo = true;
+}
+
+RegiaoSerial::~RegiaoSerial()
+{
+    dentro_de_paralelo = m_anterior;
+}
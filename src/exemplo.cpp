@@ -6,9 +6,27 @@
 #include <random>
 #include <numeric>
 #include <algorithm>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <exception>
 
 using namespace std;
 
+/*
+Avaliação das 10.000 imagens de teste do MNIST.
+
+Uso:
+  ./exemplo                          mostra as imagens uma a uma (enter avança)
+  ./exemplo --lote [modelo.txt ...]  avalia o conjunto inteiro sem interação
+
+No modo em lote, cada modelo (o padrão é number_rec_model.txt) passa pelo
+conjunto todo em paralelo, e são mostrados a precisão, a matriz de confusão,
+a precisão e o recall de cada classe, imagens por segundo e percentis da
+latência de uma imagem. Com mais de um modelo, um resumo compara todos.
+*/
+
 const char* images_path = "data/dataset/t10k-images.idx3-ubyte";
 const char* labels_path = "data/dataset/t10k-labels.idx1-ubyte";
 
@@ -27,19 +45,43 @@ int inverter_endian (int i)
 int numero_imagens = 0;
 
 void print_img (vector<double>);
+bool ler_mnist (vector<vector<double>>&, vector<u_char>&, bool);
+void interativo (const vector<vector<double>>&, const vector<u_char>&);
+int avaliar_lote (const vector<string>&, const vector<vector<double>>&, const vector<u_char>&);
 
-int main()
+int main(int argc, char** argv)
+{
+    bool lote = argc > 1 && string(argv[1]) == "--lote";
+
+    vector<string> modelos;
+    for (int i = 2; lote && i < argc; i++)
+        modelos.push_back(argv[i]);
+    if (modelos.empty())
+        modelos.push_back(model_path);
+
+    vector<vector<double>> todas_imagens;
+    vector<u_char>            todos_rotulos;
+
+    if (!ler_mnist(todas_imagens, todos_rotulos, !lote))
+        return 1;
+
+    if (lote)
+        return avaliar_lote(modelos, todas_imagens, todos_rotulos);
+
+    interativo(todas_imagens, todos_rotulos);
+    return 0;
+}
+
+// Lê o conjunto de teste. Com 'verbose', mostra os cabeçalhos dos arquivos
+bool ler_mnist (vector<vector<double>>& todas_imagens, vector<u_char>& todos_rotulos, bool verbose)
 {
-    const char* images_path = "data/dataset/t10k-images.idx3-ubyte";
-    const char* labels_path = "data/dataset/t10k-labels.idx1-ubyte";
-    
     ifstream images_file (images_path, ios::binary);
     ifstream labels_file (labels_path, ios::binary);
 
     if (!images_file.is_open() || !labels_file.is_open())
     {
         cerr << "ERRO: FaLha ao abrir os arquivos." << endl;
-        return 1;
+        return false;
     }
     
     // --- LEITURA DO CABEÇALHO ---
@@ -58,10 +100,13 @@ int main()
     n_rows = inverter_endian(n_rows);
     n_cols = inverter_endian(n_cols);
 
-    cout << "--- CABEÇALHO DAS IMAGENS ---" << endl;
-    cout << "MAGIC NUMBER: " << magic_number_images << endl;
-    cout << "NÚMERO DE IMAGENS: " << numero_imagens << endl;
-    cout << "LINHAS: " << n_rows << " COLUNAS: " << n_cols << endl;
+    if (verbose)
+    {
+        cout << "--- CABEÇALHO DAS IMAGENS ---" << endl;
+        cout << "MAGIC NUMBER: " << magic_number_images << endl;
+        cout << "NÚMERO DE IMAGENS: " << numero_imagens << endl;
+        cout << "LINHAS: " << n_rows << " COLUNAS: " << n_cols << endl;
+    }
 
     int magic_number_labels = 0;
     int numero_rotulos = 0;
@@ -70,15 +115,18 @@ int main()
     magic_number_labels = inverter_endian(magic_number_labels);
     numero_rotulos = inverter_endian(numero_rotulos);
     
-    cout << "\n--- Cabeçalho dos Rótulos ---" << endl;
-    cout << "Magic Number: " << magic_number_labels << endl;
-    cout << "Número de Rótulos: " << numero_rotulos << endl;
+    if (verbose)
+    {
+        cout << "\n--- Cabeçalho dos Rótulos ---" << endl;
+        cout << "Magic Number: " << magic_number_labels << endl;
+        cout << "Número de Rótulos: " << numero_rotulos << endl;
+    }
 
     // --- LEITURA DOS DADOS ---
     int tamanho_imagem = n_rows * n_cols;
-    vector<vector<double>> todas_imagens;
-    vector<u_char>            todos_rotulos;
-    
+    todas_imagens.reserve(numero_imagens);
+    todos_rotulos.reserve(numero_imagens);
+
     cout << "\nLENDO " << numero_imagens << " IMAGENS..." << endl;
 
     for (int i = 0; i < numero_imagens; i++)
@@ -92,7 +140,7 @@ int main()
         if (!images_file || !labels_file)
         {
             cerr << "ERRO: falha ao ler os dados da imagem/rótulo na iteração " << i << endl;
-            return 1;
+            return false;
         }
 
         vector<double> imagem;
@@ -111,6 +159,11 @@ int main()
     images_file.close();
     labels_file.close();
 
+    return true;
+}
+
+void interativo (const vector<vector<double>>& todas_imagens, const vector<u_char>& todos_rotulos)
+{
     vector<int> indices(numero_imagens);
     iota(indices.begin(), indices.end(), 0);
 
@@ -146,6 +199,168 @@ int main()
     }
 }
 
+namespace
+{
+    using relogio = chrono::steady_clock;
+
+    double segundos_desde (relogio::time_point inicio)
+    {
+        return chrono::duration<double>(relogio::now() - inicio).count();
+    }
+
+    // Percentil 'p' (0 a 100) de valores já ordenados
+    double percentil (const vector<double>& ordenados, double p)
+    {
+        size_t i = static_cast<size_t>(p / 100.0 * (ordenados.size() - 1) + 0.5);
+        return ordenados[min(i, ordenados.size() - 1)];
+    }
+
+    struct ResumoModelo
+    {
+        string caminho;
+        double precisao;
+        double imagens_por_segundo;
+        double p50_us, p99_us;
+    };
+}
+
+/*
+Avalia cada modelo no conjunto inteiro:
+- vazão: prever_classes em paralelo (ModoExecucao::VAZAO), melhor de 3 passadas
+- latência: uma imagem por vez (ModoExecucao::LATENCIA), cada chamada cronometrada
+*/
+int avaliar_lote (const vector<string>& modelos, const vector<vector<double>>& imagens, const vector<u_char>& rotulos)
+{
+    const size_t n = imagens.size();
+    vector<ResumoModelo> resumos;
+
+    cout << fixed;
+
+    for (const string& caminho : modelos)
+    {
+        auto inicio_carga = relogio::now();
+        unique_ptr<nn::Sequencial> modelo;
+        try
+        {
+            modelo = make_unique<nn::Sequencial>(caminho);
+        }
+        catch (const exception& e)
+        {
+            cerr << "ERRO: " << caminho << ": " << e.what() << endl;
+            return 1;
+        }
+        nn::Sequencial& rede = *modelo;
+        double tempo_carga = segundos_desde(inicio_carga);
+
+        // Só inferência: a normalização em lote vira parte dos pesos
+        rede.incorporar_normalizacao();
+
+        // Fora do tempo de carga: só a primeira execução na máquina mede
+        rede.set_autoajuste(true);
+
+        const size_t n_classes = rede.get_topologia().back();
+
+        // --- VAZÃO ---
+        nn::contexto_padrao().set_modo(nn::ModoExecucao::VAZAO);
+
+        vector<size_t> previstas;
+        double melhor_tempo = 0.0;
+        for (int rep = 0; rep < 3; rep++)
+        {
+            auto inicio = relogio::now();
+            rede.prever_classes(imagens, previstas);
+            double tempo = segundos_desde(inicio);
+
+            if (rep == 0 || tempo < melhor_tempo)
+                melhor_tempo = tempo;
+        }
+
+        // --- LATÊNCIA ---
+        nn::contexto_padrao().set_modo(nn::ModoExecucao::LATENCIA);
+
+        vector<double> latencias(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            auto inicio = relogio::now();
+            rede.prever_classe(imagens[i]);
+            latencias[i] = segundos_desde(inicio) * 1e6;
+        }
+        sort(latencias.begin(), latencias.end());
+
+        // --- MÉTRICAS ---
+        // confusao[real][prevista]
+        vector<vector<size_t>> confusao(n_classes, vector<size_t>(n_classes, 0));
+        size_t acertos = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t real = rotulos[i];
+            if (real >= n_classes || previstas[i] >= n_classes)
+                continue;
+
+            confusao[real][previstas[i]]++;
+            acertos += real == previstas[i];
+        }
+
+        ResumoModelo resumo{caminho, static_cast<double>(acertos) / n, n / melhor_tempo,
+                            percentil(latencias, 50), percentil(latencias, 99)};
+        resumos.push_back(resumo);
+
+        cout << "\n=== " << caminho << " ===" << endl;
+        cout << setprecision(2);
+        cout << "CARREGAMENTO: " << tempo_carga * 1e3 << " ms" << endl;
+        cout << "PRECISÃO: " << resumo.precisao * 100.0 << "% (" << acertos << "/" << n << ")" << endl;
+        cout << setprecision(0);
+        cout << "VAZÃO: " << resumo.imagens_por_segundo << " imagens/s ("
+             << nn::contexto_padrao().get_n_threads() << " threads)" << endl;
+        cout << setprecision(1);
+        cout << "LATÊNCIA (us): p50 " << percentil(latencias, 50) << "  p90 " << percentil(latencias, 90)
+             << "  p99 " << percentil(latencias, 99) << "  máx " << latencias.back() << endl;
+
+        cout << "\nMATRIZ DE CONFUSÃO (linhas: real, colunas: prevista)" << endl;
+        cout << "     ";
+        for (size_t c = 0; c < n_classes; c++)
+            cout << setw(6) << c;
+        cout << endl;
+        for (size_t r = 0; r < n_classes; r++)
+        {
+            cout << setw(5) << r;
+            for (size_t c = 0; c < n_classes; c++)
+                cout << setw(6) << confusao[r][c];
+            cout << endl;
+        }
+
+        cout << "\nCLASSE  PRECISÃO  RECALL" << endl;
+        for (size_t c = 0; c < n_classes; c++)
+        {
+            size_t previstas_c = 0, reais_c = 0;
+            for (size_t k = 0; k < n_classes; k++)
+            {
+                previstas_c += confusao[k][c];
+                reais_c += confusao[c][k];
+            }
+
+            double precisao_c = previstas_c ? 100.0 * confusao[c][c] / previstas_c : 0.0;
+            double recall_c = reais_c ? 100.0 * confusao[c][c] / reais_c : 0.0;
+            cout << setw(6) << c << setw(9) << precisao_c << "%" << setw(7) << recall_c << "%" << endl;
+        }
+    }
+
+    if (resumos.size() > 1)
+    {
+        cout << "\n=== RESUMO ===" << endl;
+        cout << left << setw(40) << "MODELO" << right << setw(10) << "PRECISÃO" << setw(14) << "IMAGENS/S"
+             << setw(10) << "P50 (us)" << setw(10) << "P99 (us)" << endl;
+        for (const auto& r : resumos)
+        {
+            cout << left << setw(40) << r.caminho << right << setprecision(2) << setw(9) << r.precisao * 100.0 << "%"
+                 << setprecision(0) << setw(14) << r.imagens_por_segundo
+                 << setprecision(1) << setw(10) << r.p50_us << setw(10) << r.p99_us << endl;
+        }
+    }
+
+    return 0;
+}
+
 void print_img (vector<double> img)
 {
     const char full[] = "██";
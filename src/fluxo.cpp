@@ -0,0 +1,200 @@
+#include "fluxo.h"
+
+#include <algorithm>
+
+using namespace nn;
+
+//
+// FILA DE AMOSTRAS
+//
+
+FilaAmostras::FilaAmostras(size_t capacidade, bool descartar_antigas)
+    : m_capacidade(std::max<size_t>(capacidade, 1)), m_descartar_antigas(descartar_antigas)
+{
+}
+
+bool FilaAmostras::inserir(Amostra amostra)
+{
+    std::unique_lock<std::mutex> lk(m_mtx);
+
+    if (m_descartar_antigas)
+    {
+        if (m_amostras.size() >= m_capacidade && !m_fechada)
+        {
+            m_amostras.pop_front();
+            m_descartadas++;
+        }
+    }
+    else
+    {
+        m_cv_espaco.wait(lk, [&] { return m_fechada || m_amostras.size() < m_capacidade; });
+    }
+
+    if (m_fechada)
+        return false;
+
+    m_amostras.push_back(std::move(amostra));
+    lk.unlock();
+    m_cv_dados.notify_one();
+
+    return true;
+}
+
+bool FilaAmostras::retirar(Amostra &amostra, std::chrono::milliseconds espera)
+{
+    std::unique_lock<std::mutex> lk(m_mtx);
+
+    if (!m_cv_dados.wait_for(lk, espera, [&] { return m_fechada || !m_amostras.empty(); }))
+        return false;
+
+    if (m_amostras.empty())
+        return false; // fechada e vazia
+
+    amostra = std::move(m_amostras.front());
+    m_amostras.pop_front();
+    lk.unlock();
+    m_cv_espaco.notify_one();
+
+    return true;
+}
+
+void FilaAmostras::fechar()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_fechada = true;
+    }
+    m_cv_dados.notify_all();
+    m_cv_espaco.notify_all();
+}
+
+bool FilaAmostras::fechada() const
+{
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_fechada;
+}
+
+size_t FilaAmostras::tamanho() const
+{
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_amostras.size();
+}
+
+size_t FilaAmostras::descartadas() const
+{
+    std::lock_guard<std::mutex> lk(m_mtx);
+    return m_descartadas;
+}
+
+//
+// TREINO CONTÍNUO
+//
+
+detalhe::LoteFluxo::LoteFluxo(size_t tamanho_lote)
+    : m_entradas(std::max<size_t>(tamanho_lote, 1)), m_saidas(m_entradas.size())
+{
+    m_sobra_entradas.reserve(m_entradas.size());
+    m_sobra_saidas.reserve(m_entradas.size());
+}
+
+void detalhe::LoteFluxo::adicionar(const Vetor &entrada, const Vetor &saida)
+{
+    // assign reaproveita a memória da vaga quando o tamanho cabe nela
+    m_entradas[m_n].assign(entrada.begin(), entrada.end());
+    m_saidas[m_n].assign(saida.begin(), saida.end());
+    m_n++;
+}
+
+void detalhe::LoteFluxo::adicionar(Amostra &&amostra)
+{
+    // A amostra já é nossa: troca de memória com a vaga, sem copiar
+    m_entradas[m_n].swap(amostra.entrada);
+    m_saidas[m_n].swap(amostra.saida);
+    m_n++;
+}
+
+void detalhe::LoteFluxo::atualizar(Sequencial &rede, const ConfigFluxo &config, ResultadoFluxo &resultado)
+{
+    // train_step usa os vetores inteiros: as vagas livres de um lote
+    // incompleto saem de lado durante o passo (movidas, sem liberar memória)
+    while (m_entradas.size() > m_n)
+    {
+        m_sobra_entradas.push_back(std::move(m_entradas.back()));
+        m_sobra_saidas.push_back(std::move(m_saidas.back()));
+        m_entradas.pop_back();
+        m_saidas.pop_back();
+    }
+
+    double perda;
+    try
+    {
+        perda = rede.train_step(m_entradas, m_saidas, config.taxa_aprendizagem);
+    }
+    catch (...)
+    {
+        devolver_sobra();
+        throw;
+    }
+    devolver_sobra();
+
+    resultado.perda_media = resultado.passos == 0 ? perda : 0.99 * resultado.perda_media + 0.01 * perda;
+    resultado.passos++;
+
+    if (config.ao_atualizar)
+        config.ao_atualizar(resultado.passos, perda);
+}
+
+void detalhe::LoteFluxo::devolver_sobra()
+{
+    while (!m_sobra_entradas.empty())
+    {
+        m_entradas.push_back(std::move(m_sobra_entradas.back()));
+        m_saidas.push_back(std::move(m_sobra_saidas.back()));
+        m_sobra_entradas.pop_back();
+        m_sobra_saidas.pop_back();
+    }
+    m_n = 0;
+}
+
+ResultadoFluxo nn::treinar_fluxo(Sequencial &rede, FilaAmostras &fila, const ConfigFluxo &config)
+{
+    ResultadoFluxo resultado;
+
+    detalhe::LoteFluxo lote(config.tamanho_lote);
+
+    using relogio = std::chrono::steady_clock;
+    relogio::time_point prazo; // do lote atual, contado da sua primeira amostra
+
+    Amostra amostra;
+    for (;;)
+    {
+        // Com um lote começado, só espera o que sobra do prazo dele
+        auto espera = config.espera_maxima;
+        if (!lote.vazio())
+            espera = std::max(std::chrono::milliseconds(0),
+                              std::chrono::ceil<std::chrono::milliseconds>(prazo - relogio::now()));
+
+        if (fila.retirar(amostra, espera))
+        {
+            if (lote.vazio())
+                prazo = relogio::now() + config.espera_maxima;
+
+            lote.adicionar(std::move(amostra));
+            resultado.amostras++;
+
+            // Cheio, ou com o prazo vencido mesmo com amostras ainda chegando
+            if (lote.cheio() || relogio::now() >= prazo)
+                lote.atualizar(rede, config, resultado);
+            continue;
+        }
+
+        // Prazo vencido (ou nenhuma amostra por 'espera_maxima'): usa o que já chegou
+        if (!lote.vazio())
+            lote.atualizar(rede, config, resultado);
+
+        if (fila.fechada() && fila.tamanho() == 0)
+            break;
+    }
+
+    return resultado;
+}
@@ -0,0 +1,140 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace nn;
+
+InferenciaIncremental::InferenciaIncremental(const Sequencial &rede)
+    : m_rede(rede)
+{
+    m_rede.alocar_area_trabalho(m_area);
+
+    // Estado da entrada toda em zero: 'atualizar' já parte de algo válido
+    iniciar(Vetor(m_rede.get_tamanho_entrada(), 0.0));
+}
+
+const Vetor &InferenciaIncremental::iniciar(const Vetor &entrada)
+{
+    if (entrada.size() != m_rede.get_tamanho_entrada())
+        throw std::invalid_argument("entrada com tamanho diferente da camada de entrada da rede");
+
+    if (!m_rede.m_extrator.empty())
+    {
+        m_imagem = entrada;
+        return m_rede.feed_forward(m_imagem, m_area);
+    }
+
+    std::copy(entrada.begin(), entrada.end(), m_area.ativacoes[0].begin());
+    recalcular_primeira_camada();
+
+    return propagar_restante();
+}
+
+const Vetor &InferenciaIncremental::atualizar(const size_t *indices, const double *deltas, size_t n)
+{
+    const size_t n_entradas = m_rede.get_tamanho_entrada();
+
+    // Valida tudo antes de mexer no estado
+    for (size_t i = 0; i < n; i++)
+    {
+        if (indices[i] >= n_entradas)
+            throw std::out_of_range("índice de entrada fora da rede: " + std::to_string(indices[i]));
+    }
+
+    if (!m_rede.m_extrator.empty())
+    {
+        for (size_t i = 0; i < n; i++)
+            m_imagem[indices[i]] += deltas[i];
+        return m_rede.feed_forward(m_imagem, m_area);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        aplicar(indices[i], deltas[i]);
+
+    if (m_intervalo_recalculo != 0 && ++m_atualizacoes >= m_intervalo_recalculo)
+        recalcular_primeira_camada();
+
+    return propagar_restante();
+}
+
+const Vetor &InferenciaIncremental::atualizar(const std::vector<size_t> &indices, const Vetor &deltas)
+{
+    if (indices.size() != deltas.size())
+        throw std::invalid_argument("número de índices diferente do número de deltas");
+
+    return atualizar(indices.data(), deltas.data(), indices.size());
+}
+
+const Vetor &InferenciaIncremental::atualizar(const Vetor &nova_entrada)
+{
+    const Vetor &entrada = m_area.ativacoes[0];
+
+    if (nova_entrada.size() != m_rede.get_tamanho_entrada())
+        throw std::invalid_argument("entrada com tamanho diferente da camada de entrada da rede");
+
+    if (!m_rede.m_extrator.empty())
+    {
+        m_imagem = nova_entrada;
+        return m_rede.feed_forward(m_imagem, m_area);
+    }
+
+    for (size_t k = 0; k < entrada.size(); k++)
+    {
+        if (nova_entrada[k] != entrada[k])
+            aplicar(k, nova_entrada[k] - entrada[k]);
+    }
+
+    // Aplicar os deltas não reproduz exatamente os valores novos: copia-os
+    std::copy(nova_entrada.begin(), nova_entrada.end(), m_area.ativacoes[0].begin());
+
+    if (m_intervalo_recalculo != 0 && ++m_atualizacoes >= m_intervalo_recalculo)
+        recalcular_primeira_camada();
+
+    return propagar_restante();
+}
+
+void InferenciaIncremental::aplicar(size_t k, double delta)
+{
+    m_area.ativacoes[0][k] += delta;
+
+    // m_pesos[0][k] são os pesos da entrada k para cada neurônio da primeira camada
+    const Vetor &linha = m_rede.m_pesos[0][k];
+    Vetor &logits = m_area.logits[0];
+
+    for (size_t j = 0; j < logits.size(); j++)
+        logits[j] += delta * linha[j];
+}
+
+void InferenciaIncremental::recalcular_primeira_camada()
+{
+    // Mesma ordem do aplicar (linha a linha), começando pelos biases
+    const Vetor &entrada = m_area.ativacoes[0];
+    Vetor &logits = m_area.logits[0];
+
+    std::copy(m_rede.m_biases[0].begin(), m_rede.m_biases[0].end(), logits.begin());
+
+    for (size_t k = 0; k < entrada.size(); k++)
+    {
+        const double x = entrada[k];
+        if (x == 0.0)
+            continue;
+
+        const Vetor &linha = m_rede.m_pesos[0][k];
+        for (size_t j = 0; j < logits.size(); j++)
+            logits[j] += x * linha[j];
+    }
+
+    m_atualizacoes = 0;
+}
+
+const Vetor &InferenciaIncremental::propagar_restante()
+{
+    m_rede.ativar_camada(0, m_area);
+
+    for (size_t i = 1; i < m_rede.m_pesos.size(); i++)
+        m_rede.propagar_camada(i, m_area);
+
+    return m_area.ativacoes.back();
+}
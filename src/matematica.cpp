@@ -0,0 +1,579 @@
+#include "matematica.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__F16C__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+using namespace nn;
+
+namespace
+{
+    std::atomic<PrecisaoMatematica> precisao_atual{PrecisaoMatematica::PRECISA};
+
+    /*
+    Todas as funções são escritas uma única vez como template sobre o tipo do
+    valor: 'double' para o caso escalar e 'vd' (LARGURA doubles) quando há
+    extensões vetoriais. Não há desvios, só seleções ('cond ? a : b'), então a
+    versão vetorial processa todas as posições juntas.
+
+    A largura acompanha os registradores disponíveis na compilação: 4 doubles
+    com AVX (ver a opção NN_NATIVO no CMake) e 2 com SSE2/NEON.
+    */
+#if defined(__GNUC__)
+#if defined(__AVX__)
+    constexpr size_t LARGURA = 4;
+#else
+    constexpr size_t LARGURA = 2;
+#endif
+    typedef double vd __attribute__((vector_size(LARGURA * sizeof(double))));
+    typedef int64_t vi __attribute__((vector_size(LARGURA * sizeof(int64_t))));
+#endif
+
+    template <class T>
+    struct Inteiro
+    {
+        using tipo = int64_t;
+    };
+
+#if defined(__GNUC__)
+    template <>
+    struct Inteiro<vd>
+    {
+        using tipo = vi;
+    };
+#endif
+
+    template <class Para, class De>
+    inline Para converter_bits(De x)
+    {
+        static_assert(sizeof(Para) == sizeof(De), "tamanhos diferentes");
+        Para r;
+        std::memcpy(&r, &x, sizeof(r));
+        return r;
+    }
+
+    // Repete um valor escalar em todas as posições
+    template <class T>
+    inline T repetir(double v) { return T{} + v; }
+
+    inline double para_double(int64_t v) { return static_cast<double>(v); }
+#if defined(__GNUC__)
+    inline vd para_double(vi v) { return __builtin_convertvector(v, vd); }
+#endif
+
+    template <class T>
+    inline T horner(T x, const double *coef, size_t n)
+    {
+        // coef[0] é o termo de maior grau
+        T r = repetir<T>(coef[0]);
+        for (size_t i = 1; i < n; i++)
+            r = r * x + coef[i];
+        return r;
+    }
+
+    // Taylor de e^r em |r| <= ln(2)/2, termo de maior grau primeiro
+    const double COEF_EXP[] = {
+        1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+        1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0,
+        1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0};
+    const size_t N_EXP_PRECISA = 13; // grau 12: erro de truncamento < 2e-16
+    const size_t N_EXP_RAPIDA = 7;   // grau 6: erro de truncamento < 2e-7
+
+    // Série de atanh: log(m) = 2s (1 + s²/3 + s⁴/5 + ...), s = (m-1)/(m+1)
+    const double COEF_LOG[] = {
+        1.0 / 19.0, 1.0 / 17.0, 1.0 / 15.0, 1.0 / 13.0, 1.0 / 11.0,
+        1.0 / 9.0, 1.0 / 7.0, 1.0 / 5.0, 1.0 / 3.0, 1.0};
+    const size_t N_LOG_PRECISA = 10;
+    const size_t N_LOG_RAPIDA = 4;
+
+    const double LN2_ALTO = 6.93147180369123816490e-01; // últimos bits zerados: n * LN2_ALTO é exato
+    const double LN2_BAIXO = 1.90821492927058770002e-10;
+
+    template <bool PRECISA, class T>
+    inline T exp_nucleo(T x)
+    {
+        using I = typename Inteiro<T>::tipo;
+
+        const double LOG2E = 1.4426950408889634;
+        const double DESLOCADOR = 6755399441055744.0; // 1.5 * 2^52: arredonda para inteiro ao somar
+
+        T xc = x < -708.0 ? repetir<T>(-708.0) : x;
+        xc = xc > 709.0 ? repetir<T>(709.0) : xc;
+
+        // x = n ln(2) + r, com n inteiro e |r| <= ln(2)/2
+        T k = xc * LOG2E + DESLOCADOR;
+        T n = k - DESLOCADOR;
+        T r = xc - n * LN2_ALTO - n * LN2_BAIXO;
+
+        T p = PRECISA ? horner(r, COEF_EXP, N_EXP_PRECISA)
+                      : horner(r, COEF_EXP + (N_EXP_PRECISA - N_EXP_RAPIDA), N_EXP_RAPIDA);
+
+        // 2^n montado direto nos bits do expoente
+        I n_inteiro = converter_bits<I>(k) - converter_bits<int64_t>(DESLOCADOR);
+        T escala = converter_bits<T>((n_inteiro + 1023) << 52);
+        T y = p * escala;
+
+        y = x < -708.0 ? repetir<T>(0.0) : y;
+        y = x > 709.0 ? repetir<T>(std::numeric_limits<double>::infinity()) : y;
+        return x != x ? x : y; // NaN
+    }
+
+    template <bool PRECISA, class T>
+    inline T log_nucleo(T x)
+    {
+        using I = typename Inteiro<T>::tipo;
+
+        const double MINIMO_NORMAL = std::numeric_limits<double>::min();
+        const double RAIZ2 = 1.4142135623730951;
+
+        // Subnormais: multiplica por 2^52 para que o expoente fique normal
+        auto subnormal = x < MINIMO_NORMAL;
+        T xn = subnormal ? x * 4503599627370496.0 : x;
+
+        // x = m 2^e, com m em [1, 2)
+        I bits = converter_bits<I>(xn);
+        T e = para_double(((bits >> 52) & 0x7ff) - 1023);
+        T m = converter_bits<T>((bits & 0x000fffffffffffffLL) | converter_bits<int64_t>(1.0));
+
+        // Centraliza m em [raiz(2)/2, raiz(2)) para a série convergir rápido
+        auto grande = m > RAIZ2;
+        m = grande ? m * 0.5 : m;
+        e = grande ? e + 1.0 : e;
+        e = subnormal ? e - 52.0 : e;
+
+        T s = (m - 1.0) / (m + 1.0);
+        T s2 = s * s;
+        T serie = PRECISA ? horner(s2, COEF_LOG, N_LOG_PRECISA)
+                          : horner(s2, COEF_LOG + (N_LOG_PRECISA - N_LOG_RAPIDA), N_LOG_RAPIDA);
+
+        T y = e * LN2_ALTO + (e * LN2_BAIXO + 2.0 * s * serie);
+
+        y = x == std::numeric_limits<double>::infinity() ? x : y;
+        y = x <= 0.0 ? repetir<T>(-std::numeric_limits<double>::infinity()) : y;
+        return x != x ? x : y; // NaN
+    }
+
+    template <bool PRECISA, class T>
+    inline T tanh_nucleo(T x)
+    {
+        // tanh(|x|) = (1 - e^(-2|x|)) / (1 + e^(-2|x|)), sem estouro para |x| grande
+        T absoluto = x < 0.0 ? -x : x;
+        T t = exp_nucleo<PRECISA>(-2.0 * absoluto);
+        T y = (1.0 - t) / (1.0 + t);
+        return x < 0.0 ? -y : y;
+    }
+
+    template <bool PRECISA, class T>
+    inline T sigmoid_nucleo(T x)
+    {
+        return 1.0 / (1.0 + exp_nucleo<PRECISA>(-x));
+    }
+
+    template <class T>
+    inline T relu_nucleo(T x)
+    {
+        return x > 0.0 ? x : repetir<T>(0.0);
+    }
+
+    // Aplica 'nucleo' de LARGURA em LARGURA valores e termina o resto no modo escalar
+    template <class Nucleo>
+    inline void aplicar(const double *x, double *y, size_t n, Nucleo nucleo)
+    {
+        size_t i = 0;
+
+#if defined(__GNUC__)
+        for (; i + LARGURA <= n; i += LARGURA)
+        {
+            vd v;
+            std::memcpy(&v, x + i, sizeof(v));
+            v = nucleo(v);
+            std::memcpy(y + i, &v, sizeof(v));
+        }
+#endif
+
+        for (; i < n; i++)
+            y[i] = nucleo(x[i]);
+    }
+
+    // Aplica 'nucleo(ativacao, delta)' e guarda o resultado em delta
+    template <class Nucleo>
+    inline void aplicar_derivada(const double *a, double *delta, size_t n, Nucleo nucleo)
+    {
+        size_t i = 0;
+
+#if defined(__GNUC__)
+        for (; i + LARGURA <= n; i += LARGURA)
+        {
+            vd va, vdelta;
+            std::memcpy(&va, a + i, sizeof(va));
+            std::memcpy(&vdelta, delta + i, sizeof(vdelta));
+            vdelta = nucleo(va, vdelta);
+            std::memcpy(delta + i, &vdelta, sizeof(vdelta));
+        }
+#endif
+
+        for (; i < n; i++)
+            delta[i] = nucleo(a[i], delta[i]);
+    }
+
+    inline bool modo_preciso()
+    {
+        return precisao_atual.load(std::memory_order_relaxed) == PrecisaoMatematica::PRECISA;
+    }
+} // namespace
+
+//
+// PRECISÃO
+//
+
+void nn::set_precisao_matematica(PrecisaoMatematica precisao)
+{
+    precisao_atual.store(precisao, std::memory_order_relaxed);
+}
+
+PrecisaoMatematica nn::get_precisao_matematica()
+{
+    return precisao_atual.load(std::memory_order_relaxed);
+}
+
+//
+// FUNÇÕES
+//
+
+void nn::exp_vetor(const double *x, double *y, size_t n)
+{
+    if (modo_preciso())
+        aplicar(x, y, n, [](auto v) { return exp_nucleo<true>(v); });
+    else
+        aplicar(x, y, n, [](auto v) { return exp_nucleo<false>(v); });
+}
+
+void nn::log_vetor(const double *x, double *y, size_t n)
+{
+    if (modo_preciso())
+        aplicar(x, y, n, [](auto v) { return log_nucleo<true>(v); });
+    else
+        aplicar(x, y, n, [](auto v) { return log_nucleo<false>(v); });
+}
+
+void nn::tanh_vetor(const double *x, double *y, size_t n)
+{
+    if (modo_preciso())
+        aplicar(x, y, n, [](auto v) { return tanh_nucleo<true>(v); });
+    else
+        aplicar(x, y, n, [](auto v) { return tanh_nucleo<false>(v); });
+}
+
+void nn::sigmoid_vetor(const double *x, double *y, size_t n)
+{
+    if (modo_preciso())
+        aplicar(x, y, n, [](auto v) { return sigmoid_nucleo<true>(v); });
+    else
+        aplicar(x, y, n, [](auto v) { return sigmoid_nucleo<false>(v); });
+}
+
+void nn::relu_vetor(const double *x, double *y, size_t n)
+{
+    aplicar(x, y, n, [](auto v) { return relu_nucleo(v); });
+}
+
+//
+// DERIVADAS A PARTIR DAS ATIVAÇÕES
+//
+
+void nn::multiplicar_derivada_tanh(const double *ativacoes, double *delta, size_t n)
+{
+    aplicar_derivada(ativacoes, delta, n, [](auto a, auto d) { return d * (1.0 - a * a); });
+}
+
+void nn::multiplicar_derivada_sigmoid(const double *ativacoes, double *delta, size_t n)
+{
+    aplicar_derivada(ativacoes, delta, n, [](auto a, auto d) { return d * (a * (1.0 - a)); });
+}
+
+void nn::multiplicar_derivada_relu(const double *ativacoes, double *delta, size_t n)
+{
+    aplicar_derivada(ativacoes, delta, n, [](auto a, auto d) { return a > 0.0 ? d : repetir<decltype(d)>(0.0); });
+}
+
+//
+// MEIA PRECISÃO
+//
+
+namespace
+{
+#if defined(__GNUC__)
+    // Mesma largura em bytes dos registradores usados acima, agora em floats
+    constexpr size_t LARGURA_FLOAT = LARGURA * 2;
+    typedef float vf __attribute__((vector_size(LARGURA_FLOAT * sizeof(float))));
+    typedef uint32_t vu __attribute__((vector_size(LARGURA_FLOAT * sizeof(uint32_t))));
+    typedef uint16_t vh __attribute__((vector_size(LARGURA_FLOAT * sizeof(uint16_t))));
+
+    inline vu para_u32(const uint16_t *p)
+    {
+        vh h;
+        std::memcpy(&h, p, sizeof(h));
+        return __builtin_convertvector(h, vu);
+    }
+#endif
+
+    template <class T>
+    inline T repetir_u32(uint32_t v) { return T{} + v; }
+
+    struct BF16
+    {
+        static uint16_t de_float(float f)
+        {
+            uint32_t b = converter_bits<uint32_t>(f);
+            if ((b & 0x7fffffff) > 0x7f800000)
+                return (b >> 16) | 0x40; // NaN continua NaN
+
+            // Arredonda para o mais próximo (empate: para o par)
+            b += 0x7fff + ((b >> 16) & 1);
+            return b >> 16;
+        }
+
+        // 'U' são os 16 bits em um inteiro de 32 (escalar ou vetor)
+        template <class F, class U>
+        static F para_float(U h) { return converter_bits<F>(h << 16); }
+    };
+
+    struct FP16
+    {
+        static uint16_t de_float(float f)
+        {
+            uint32_t b = converter_bits<uint32_t>(f);
+            uint32_t sinal = (b >> 16) & 0x8000;
+            b &= 0x7fffffff;
+
+            if (b >= 0x7f800000) // inf e NaN
+                return sinal | 0x7c00 | (b > 0x7f800000 ? 0x200 : 0);
+            if (b >= 0x477ff000) // >= 65520: arredonda para inf
+                return sinal | 0x7c00;
+            if (b < 0x38800000) // < 2^-14: subnormal em FP16
+            {
+                // Somar 0.5 deixa a mantissa subnormal (já arredondada) nos bits baixos
+                float a = converter_bits<float>(b) + 0.5f;
+                return sinal | (converter_bits<uint32_t>(a) - 0x3f000000);
+            }
+
+            // Troca o bias do expoente (127 -> 15) e arredonda para o par
+            b += 0xc8000fff + ((b >> 13) & 1);
+            return sinal | (b >> 13);
+        }
+
+        template <class F, class U>
+        static F para_float(U h)
+        {
+            U sinal = (h & 0x8000) << 16;
+            U magnitude = h & 0x7fff;
+            U expoente_mantissa = magnitude << 13;
+
+            // Normais e subnormais: multiplicar por 2^112 corrige o bias do expoente
+            F normal = converter_bits<F>(expoente_mantissa) * 0x1p112f;
+            F especial = converter_bits<F>(expoente_mantissa | repetir_u32<U>(0x7f800000)); // inf/NaN
+
+            F f = magnitude >= repetir_u32<U>(0x7c00) ? especial : normal;
+            return converter_bits<F>(converter_bits<U>(f) | sinal);
+        }
+    };
+
+    template <class Formato>
+    inline float para_float(uint16_t h) { return Formato::template para_float<float, uint32_t>(h); }
+
+#if defined(__GNUC__)
+    // Carrega LARGURA_FLOAT valores de 16 bits já convertidos para float
+    template <class Formato>
+    inline vf carregar_float(const uint16_t *p)
+    {
+        return Formato::template para_float<vf, vu>(para_u32(p));
+    }
+
+#if defined(__F16C__) && defined(__AVX__)
+    template <>
+    inline vf carregar_float<FP16>(const uint16_t *p)
+    {
+        // LARGURA_FLOAT é 8 com AVX: uma instrução
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        return converter_bits<vf>(_mm256_cvtph_ps(h));
+    }
+#endif
+#endif
+
+    template <class Formato>
+    void converter_para(const double *x, uint16_t *y, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            y[i] = Formato::de_float(static_cast<float>(x[i]));
+    }
+
+    // Versões com as instruções de conversão, em blocos que cabem num registrador
+#if defined(__F16C__) && defined(__AVX__)
+    template <>
+    void converter_para<FP16>(const double *x, uint16_t *y, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128 baixo = _mm256_cvtpd_ps(_mm256_loadu_pd(x + i));
+            __m128 alto = _mm256_cvtpd_ps(_mm256_loadu_pd(x + i + 4));
+            __m256 f = _mm256_set_m128(alto, baixo);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(y + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+        }
+
+        for (; i < n; i++)
+            y[i] = FP16::de_float(static_cast<float>(x[i]));
+    }
+#endif
+
+#if defined(__AVX512BF16__) && defined(__AVX512F__)
+    template <>
+    void converter_para<BF16>(const double *x, uint16_t *y, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            float f[16];
+            for (size_t j = 0; j < 16; j++)
+                f[j] = static_cast<float>(x[i + j]);
+
+            __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(f));
+            std::memcpy(y + i, &h, sizeof(h));
+        }
+
+        for (; i < n; i++)
+            y[i] = BF16::de_float(static_cast<float>(x[i]));
+    }
+#endif
+
+    template <class Formato>
+    void converter_de(const uint16_t *x, float *y, size_t n)
+    {
+        size_t i = 0;
+
+#if defined(__GNUC__)
+        for (; i + LARGURA_FLOAT <= n; i += LARGURA_FLOAT)
+        {
+            vf v = carregar_float<Formato>(x + i);
+            std::memcpy(y + i, &v, sizeof(v));
+        }
+#endif
+
+        for (; i < n; i++)
+            y[i] = para_float<Formato>(x[i]);
+    }
+
+    template <class Formato>
+    void produto_matriz(const uint16_t *pesos, const float *x, size_t n_colunas, size_t inicio, size_t fim, double *y)
+    {
+        for (size_t j = inicio; j < fim; j++)
+        {
+            const uint16_t *linha = pesos + j * n_colunas;
+            float soma = 0.0f;
+            size_t k = 0;
+
+#if defined(__GNUC__)
+            // Dois acumuladores para esconder a latência da soma
+            vf soma_a = {}, soma_b = {};
+            for (; k + 2 * LARGURA_FLOAT <= n_colunas; k += 2 * LARGURA_FLOAT)
+            {
+                vf xa, xb;
+                std::memcpy(&xa, x + k, sizeof(xa));
+                std::memcpy(&xb, x + k + LARGURA_FLOAT, sizeof(xb));
+                soma_a += carregar_float<Formato>(linha + k) * xa;
+                soma_b += carregar_float<Formato>(linha + k + LARGURA_FLOAT) * xb;
+            }
+
+            soma_a += soma_b;
+            for (size_t i = 0; i < LARGURA_FLOAT; i++)
+                soma += soma_a[i];
+#endif
+
+            for (; k < n_colunas; k++)
+                soma += para_float<Formato>(linha[k]) * x[k];
+
+            y[j] = soma;
+        }
+    }
+} // namespace
+
+void nn::converter_para_meia(PrecisaoPesos formato, const double *x, uint16_t *y, size_t n)
+{
+    if (formato == PrecisaoPesos::BF16)
+        converter_para<BF16>(x, y, n);
+    else
+        converter_para<FP16>(x, y, n);
+}
+
+void nn::converter_de_meia(PrecisaoPesos formato, const uint16_t *x, float *y, size_t n)
+{
+    if (formato == PrecisaoPesos::BF16)
+        converter_de<BF16>(x, y, n);
+    else
+        converter_de<FP16>(x, y, n);
+}
+
+void nn::produto_matriz_meia(PrecisaoPesos formato, const uint16_t *pesos, const float *x, size_t n_colunas,
+                             size_t inicio, size_t fim, double *y)
+{
+    if (formato == PrecisaoPesos::BF16)
+        produto_matriz<BF16>(pesos, x, n_colunas, inicio, fim, y);
+    else
+        produto_matriz<FP16>(pesos, x, n_colunas, inicio, fim, y);
+}
+
+//
+// PRODUTO DE MATRIZES
+//
+
+void nn::produto_matrizes(const double *a, bool transpor_a, const double *b, bool transpor_b, double *c,
+                          size_t m, size_t k, size_t n, bool acumular)
+{
+    if (!acumular)
+        std::fill(c, c + m * n, 0.0);
+
+    if (transpor_b)
+    {
+        // B guardada n x k: cada C[i][j] é o produto escalar de duas linhas contínuas
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < n; j++)
+            {
+                const double *linha_b = b + j * k;
+                double soma = 0.0;
+                for (size_t p = 0; p < k; p++)
+                    soma += (transpor_a ? a[p * m + i] : a[i * k + p]) * linha_b[p];
+                c[i * n + j] += soma;
+            }
+        return;
+    }
+
+    // C[i] += A[i][p] * B[p] para cada p: linhas contínuas de B e de C. Os
+    // blocos de p mantêm as linhas de B usadas na cache enquanto C[i] passa
+    const size_t bloco = 64;
+    for (size_t p0 = 0; p0 < k; p0 += bloco)
+    {
+        const size_t p1 = std::min(k, p0 + bloco);
+
+        for (size_t i = 0; i < m; i++)
+        {
+            double *linha_c = c + i * n;
+
+            for (size_t p = p0; p < p1; p++)
+            {
+                const double a_ip = transpor_a ? a[p * m + i] : a[i * k + p];
+                if (a_ip == 0.0)
+                    continue;
+
+                const double *linha_b = b + p * n;
+                for (size_t j = 0; j < n; j++)
+                    linha_c[j] += a_ip * linha_b[j];
+            }
+        }
+    }
+}
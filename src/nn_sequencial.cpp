@@ -1,5 +1,8 @@
 #include "rede_neural.h"
 #include "camadas_saida.h"
+#include "rastreio.h"
+#include "contadores.h"
+#include "convolucao.h"
 
 #include <vector>
 #include <string>
@@ -9,12 +12,27 @@
 #include <sstream>
 #include <algorithm>
 #include <exception>
+#include <stdexcept>
 #include <cmath>
 #include <utility>
+#include <tuple>
 #include <iostream>
 #include <deque>
-#include <omp.h>
 #include <iterator>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace nn;
 
@@ -33,7 +51,10 @@ namespace nn
         {
             if (x < 0) return 0.0;
             return 1.0;
-        }
+        },
+
+        nn::relu_vetor,
+        nn::multiplicar_derivada_relu
     );
 
     const func tanh 
@@ -47,7 +68,10 @@ namespace nn
         [](double x)->double // Derivada tangente hiperbólica
         {
             return 1.0 / std::pow(std::cosh(x), 2);
-        }
+        },
+
+        nn::tanh_vetor,
+        nn::multiplicar_derivada_tanh
     );
 
     const func sigmoid
@@ -62,7 +86,10 @@ namespace nn
         {
             double etox = std::exp(-x);
             return (etox) / std::pow(1.0 + etox, 2);
-        }
+        },
+
+        nn::sigmoid_vetor,
+        nn::multiplicar_derivada_sigmoid
     );
 }
 
@@ -78,15 +105,9 @@ Sequencial::Sequencial(
                                    m_timestep(0)
 {
     // Alocação de espaço nos vetores
+    // (gradientes e Adam só no primeiro treino, em preparar_treino)
     m_pesos.resize(m_topologia.size() - 1);
-    m_pesos_m.resize(m_topologia.size() - 1);
-    m_pesos_v.resize(m_topologia.size() - 1);
-    m_gradientes_pesos.resize(m_topologia.size() - 1);
-
     m_biases.resize(m_topologia.size() - 1);
-    m_biases_m.resize(m_topologia.size() - 1);
-    m_biases_v.resize(m_topologia.size() - 1);
-    m_gradientes_biases.resize(m_topologia.size() - 1);
 
     for (int i = 0; i < m_topologia.size() - 1; i++)
     {
@@ -94,21 +115,12 @@ Sequencial::Sequencial(
         int neuronios_prox = m_topologia[i + 1];
 
         m_pesos[i].resize(neuronios_atual);
-        m_pesos_m[i].resize(neuronios_atual);
-        m_pesos_v[i].resize(neuronios_atual);
-        m_gradientes_pesos[i].resize(neuronios_atual);
         for (int j = 0; j < neuronios_atual; j++)
         {
             m_pesos[i][j].resize(neuronios_prox);
-            m_pesos_m[i][j].resize(neuronios_prox, 0.0);
-            m_pesos_v[i][j].resize(neuronios_prox, 0.0);
-            m_gradientes_pesos[i][j].resize(neuronios_prox);
         }
 
         m_biases[i].resize(neuronios_prox);
-        m_biases_m[i].resize(neuronios_prox, 0.0);
-        m_biases_v[i].resize(neuronios_prox, 0.0);
-        m_gradientes_biases[i].resize(neuronios_prox);
     }
 
     if (camada_saida_str == "SCE")
@@ -122,6 +134,12 @@ Sequencial::Sequencial(
 
     inicializar_pesos();
     inicializar_biases();
+
+    m_ativacoes.assign(m_pesos.size() - 1, funcao_ativacao_oculta);
+    m_normalizacoes.assign(m_pesos.size(), NormalizacaoLote());
+    planejar_pilha();
+
+    alocar_area_trabalho(m_area);
 } // Sequencial
 
 Sequencial::Sequencial(const std::string &caminho) : funcao_ativacao_oculta(nn::ReLU)
@@ -132,6 +150,45 @@ Sequencial::Sequencial(const std::string &caminho) : funcao_ativacao_oculta(nn::
     }
 }
 
+namespace
+{
+    // Configura as camadas de imagem em sequência a partir de 'formato' e
+    // retorna a topologia das densas, começando pela saída achatada do extrator
+    std::vector<size_t> topologia_com_extrator(const Formato3D &formato,
+                                               const std::vector<std::unique_ptr<CamadaImagem>> &extrator,
+                                               const std::vector<size_t> &camadas_densas)
+    {
+        if (extrator.empty() || camadas_densas.empty())
+            throw std::invalid_argument("a rede convolucional precisa de camadas de imagem e de camadas densas");
+
+        Formato3D atual = formato;
+        for (const auto &camada : extrator)
+        {
+            camada->configurar(atual);
+            atual = camada->get_saida();
+        }
+
+        std::vector<size_t> topologia{atual.tamanho()};
+        topologia.insert(topologia.end(), camadas_densas.begin(), camadas_densas.end());
+        return topologia;
+    }
+}
+
+Sequencial::Sequencial(
+    const Formato3D &formato_entrada,
+    std::vector<std::unique_ptr<CamadaImagem>> extrator,
+    const std::vector<size_t> &camadas_densas,
+    std::string camada_saida_str,
+    func funcao_ativacao_oculta) : Sequencial(topologia_com_extrator(formato_entrada, extrator, camadas_densas),
+                                              camada_saida_str, funcao_ativacao_oculta)
+{
+    m_extrator = std::move(extrator);
+    alocar_area_trabalho(m_area);
+} // Sequencial
+
+// Aqui CamadaImagem é um tipo completo (o unique_ptr precisa dele para destruí-la)
+Sequencial::~Sequencial() = default;
+
 void Sequencial::inicializar_pesos()
 {
     std::random_device rd;
@@ -163,702 +220,2796 @@ void Sequencial::inicializar_biases()
 // LÓGICA DA REDE
 //
 
-Vetor Sequencial::feed_forward(const Vetor &entradas) const
+namespace
 {
-    // Verifica se a entrada tem o tamanho correto
-    if (entradas.size() != m_topologia.front())
-    {
-        return {};
-    }
-
-    // Limpa os caches da chamada anterior
-    m_logits.clear();
-    m_ativacoes.clear();
+    // Retornado pelo feed_forward quando a entrada tem o tamanho errado
+    const Vetor vetor_vazio;
+}
 
-    m_ativacoes.push_back(entradas); // A ativação da camada 0 são as próprias entradas
+void Sequencial::alocar_area_trabalho(AreaTrabalho &area, bool treino) const
+{
+    size_t n_conexoes = m_topologia.size() - 1;
 
-    Vetor camada_atual_valores = entradas;
+    area.logits.resize(n_conexoes);
+    area.normalizados.resize(n_conexoes);
+    area.deltas.resize(treino ? n_conexoes : 0);
+    area.ativacoes.resize(m_topologia.size());
+    area.entrada_float.assign(*std::max_element(m_topologia.begin(), m_topologia.end()), 0.0f);
 
-    // --- Entrada -> Ocultas -> Saída ---
+    for (size_t i = 0; i < m_topologia.size(); i++)
+        area.ativacoes[i].assign(m_topologia[i], 0.0);
 
-    // Itera através de cada camada de conexão (pesos e biases)
-    // O índice 'i' representa a conexão entre a camada 'i' e 'i+1'
-    for (size_t i = 0; i < m_pesos.size(); ++i)
+    for (size_t i = 0; i < n_conexoes; i++)
     {
-        Vetor proxima_camada_logits(m_topologia[i + 1]);
+        area.logits[i].assign(m_topologia[i + 1], 0.0);
+        area.normalizados[i].assign(m_normalizacoes[i].ligada() ? m_topologia[i + 1] : 0, 0.0);
+        if (treino)
+            area.deltas[i].assign(m_topologia[i + 1], 0.0);
+    }
 
-        // Calcula a soma ponderada para cada neurônio da próxima camada (logits)
-        #pragma omp parallel for 
-        for (size_t j = 0; j < proxima_camada_logits.size(); ++j)
-        {
-            double soma_ponderada = 0.0;
-            for (size_t k = 0; k < camada_atual_valores.size(); ++k)
-            {
-                // Acesso aos pesos:
-                // m_pesos[camada][neuronio_origem][neuronio_destino]
-                soma_ponderada += camada_atual_valores[k] * m_pesos[i][k][j];
-            }
+    const size_t n_imagens = m_extrator.size();
+    area.imagens.resize(n_imagens > 0 ? n_imagens + 1 : 0);
+    area.auxiliares.resize(n_imagens);
+    area.deltas_imagens.resize(treino && n_imagens > 0 ? n_imagens + 1 : 0);
 
-            // Adiciona o bias
-            soma_ponderada += m_biases[i][j];
-            proxima_camada_logits[j] = soma_ponderada;
-        }
+    for (size_t i = 0; i < n_imagens; i++)
+    {
+        const CamadaImagem &camada = *m_extrator[i];
 
-        m_logits.push_back(proxima_camada_logits); // Guarda os logits da camada
+        if (i == 0)
+            area.imagens[0].assign(camada.get_entrada().tamanho(), 0.0);
+        area.imagens[i + 1].assign(camada.get_saida().tamanho(), 0.0);
+        area.auxiliares[i].assign(camada.tamanho_auxiliar(), 0.0);
 
-        // Aplica a ativação
-        Vetor proxima_camada_ativacoes(m_topologia[i + 1]);
-        if (i < m_pesos.size() - 1) // Camadas ocultas
-        {
-            #pragma omp parallel for
-            for (size_t j = 0; j < proxima_camada_logits.size(); j++)
-            {
-                proxima_camada_ativacoes[j] = funcao_ativacao_oculta.funcao(proxima_camada_logits[j]);
-            }
-            camada_atual_valores = proxima_camada_ativacoes;
-            m_ativacoes.push_back(camada_atual_valores);
-        }
+        // O gradiente da entrada da rede não é calculado
+        if (treino)
+            area.deltas_imagens[i + 1].assign(camada.get_saida().tamanho(), 0.0);
     }
+}
 
-    // Aplica a ativação de fato (os logits de saída)
-    Vetor saida_final = m_camada_saida->forward(m_logits.back()); // Usa os últimos logits calculados
-    m_ativacoes.push_back(saida_final);                           // Atualiza o último elemento das ativações com o resultado final
+namespace
+{
+    // Esvazia 'v' devolvendo a memória (clear() mantém a capacidade)
+    template <class T>
+    void liberar(std::vector<T> &v)
+    {
+        std::vector<T>().swap(v);
+    }
 
-    return saida_final;
-} // feed_forward
+    // Bytes dos elementos de um vetor (de vetores...)
+    template <class T>
+    size_t bytes(const std::vector<T> &v)
+    {
+        return v.capacity() * sizeof(T);
+    }
 
-// APRENDIZADO DE MÁQUINA
-void Sequencial::backpropagate(const Vetor &saida_esperada)
-{
-    /*
-    Obs: observe que, ao contrário do feed_forward, neste método estamos
-    começando da última camada (de saída) para poder calcular o gradiente
-    de erro de cada neurônio.
-    */
+    template <class T>
+    size_t bytes(const std::vector<std::vector<T>> &v)
+    {
+        size_t total = v.capacity() * sizeof(std::vector<T>);
+        for (const auto &interno : v)
+            total += bytes(interno);
+        return total;
+    }
+}
 
-    //=======================================================//
-    //  PASSO 1: Calcular o erro (delta) da CAMADA DE SAÍDA  //
-    //=======================================================//
-    Vetor ultima_ativacao = m_ativacoes.back();
-    Vetor delta = m_camada_saida->backward(ultima_ativacao, saida_esperada);
+void Sequencial::preparar_treino()
+{
+    if (m_somente_inferencia)
+        throw std::logic_error("a rede está no modo somente inferência (ver set_somente_inferencia)");
 
-    // Agora, com o delta da camada de saída, calculamos os gradientes para os
-    // pesos e biases que se conectam a ela (a última camada de pesos/biases)
+    if (!m_extrator.empty() && m_n_micro_lotes > 1)
+        throw std::logic_error("o treino em micro-lotes não suporta camadas de imagem (use n_micro_lotes = 1)");
 
-    // Índice da última camada de pesos/biases
-    size_t L = m_pesos.size() - 1;
+    if (tem_normalizacao() && m_n_micro_lotes > 1)
+        throw std::logic_error("o treino em micro-lotes não suporta normalização em lote (use n_micro_lotes = 1)");
 
-    // A ativação da penúltima camada (que alimenta a camada de saída)
-    Vetor ativacao_camada_anterior = m_ativacoes[L];
+    const size_t n_conexoes = m_pesos.size();
 
-    // Calcular gradientes para a última camada de conexões
-    // Para cada neurônio 'j' na camada de SAÍDA:
-    #pragma omp parallel for
-    for (size_t j = 0; j < m_topologia.back(); j++)
+    // Gradientes e momentos do Adam, todos com a forma dos pesos/biases
+    if (m_gradientes_pesos.size() != n_conexoes || m_pesos_m.size() != n_conexoes ||
+        m_extrator_m.size() != m_extrator.size())
     {
-        m_gradientes_biases[L][j] = delta[j];
+        auto zeros_pesos = [&](std::vector<Matriz> &matrizes)
+        {
+            matrizes.resize(n_conexoes);
+            for (size_t i = 0; i < n_conexoes; i++)
+                matrizes[i].assign(m_topologia[i], Vetor(m_topologia[i + 1], 0.0));
+        };
 
-        // Para cada neurônio 'k' na camada ANTERIOR:
-        for (size_t k = 0; k < m_topologia[L]; k++)
+        auto zeros_biases = [&](std::vector<Vetor> &vetores)
+        {
+            vetores.resize(n_conexoes);
+            for (size_t i = 0; i < n_conexoes; i++)
+                vetores[i].assign(m_topologia[i + 1], 0.0);
+        };
+
+        zeros_pesos(m_gradientes_pesos);
+        zeros_pesos(m_pesos_m);
+        zeros_pesos(m_pesos_v);
+        zeros_biases(m_gradientes_biases);
+        zeros_biases(m_biases_m);
+        zeros_biases(m_biases_v);
+
+        // Os das camadas de imagem têm a forma dos seus parâmetros
+        for (auto *vetores : {&m_gradientes_extrator, &m_extrator_m, &m_extrator_v})
         {
-            // O gradiente do peso é o sinal de erro do neurônio de destino
-            // multiplicado pela ativação do neurônio de origem.
-            m_gradientes_pesos[L][k][j] = ativacao_camada_anterior[k] * delta[j];
+            vetores->resize(m_extrator.size());
+            for (size_t i = 0; i < m_extrator.size(); i++)
+                (*vetores)[i].assign(m_extrator[i]->get_parametros().size(), 0.0);
         }
+
+        m_timestep = 0;
     }
 
-    //====================================================//
-    //  PASSO 2: Propagar o erro para as CAMADAS OCULTAS  //
-    //====================================================//
-    // Agora, iteramos para trás, da penúltima camada até a primeira.
+    // Os da normalização têm o tamanho de gama (vazios nas camadas sem ela)
+    bool normalizacao_mudou = m_gradientes_gama.size() != n_conexoes;
+    for (size_t i = 0; i < n_conexoes && !normalizacao_mudou; i++)
+        normalizacao_mudou = m_gradientes_gama[i].size() != m_normalizacoes[i].gama.size();
 
-    // O índice 'L' representa a camada de CONEXÕES (pesos/biases).
-    for (long L = m_pesos.size() - 2; L >= 0; L--)
+    if (normalizacao_mudou)
     {
-        const Vetor &delta_camada_seguinte = delta; // 'delta' da iteração anterior
-        const Matriz &pesos_camada_seguinte = m_pesos[L + 1];
-        const Vetor &logits_camada_atual = m_logits[L];
-
-        Vetor novo_delta(m_topologia[L + 1]); // O novo delta para a camada (L+1)
-
-        // Para cada neurônio 'k' na camada atual (L+1)
-        #pragma omp parallel for
-        for (size_t k = 0; k < m_topologia[L + 1]; k++)
+        for (auto *vetores : {&m_gradientes_gama, &m_gradientes_beta, &m_gama_m, &m_gama_v, &m_beta_m, &m_beta_v,
+                              &m_inversos_desvio})
         {
-            double erro_propagado = 0.0;
-            // Somar o erro vindo de cada neurônio 'j' da camada seguinte (L+2)
-            for (size_t j = 0; j < m_topologia[L + 2]; j++)
-            {
-                erro_propagado += delta_camada_seguinte[j] * pesos_camada_seguinte[k][j];
-            }
-
-            double derivada_ativacao = funcao_ativacao_oculta.derivada(logits_camada_atual[k]);
-            novo_delta[k] = erro_propagado * derivada_ativacao;
+            vetores->resize(n_conexoes);
+            for (size_t i = 0; i < n_conexoes; i++)
+                (*vetores)[i].assign(m_normalizacoes[i].gama.size(), 0.0);
         }
+    }
 
-        delta = novo_delta;
+    if (m_area.deltas.size() != n_conexoes)
+        alocar_area_trabalho(m_area, true);
 
-        // Agora, com o novo delta, calculamos os gradientes para a camada de pesos L
-        const Vetor &ativacao_camada_anterior = m_ativacoes[L];
-        #pragma omp parallel for
-        for (size_t j = 0; j < m_topologia[L + 1]; j++)
+    // Uma área de trabalho por amostra do lote (as ativações precisam
+    // sobreviver até o backward daquela amostra)
+    if (m_n_micro_lotes > 1 && m_areas_lote.size() != m_tamanho_lote)
+    {
+        m_areas_lote.resize(m_tamanho_lote);
+        for (auto &area : m_areas_lote)
         {
-            m_gradientes_biases[L][j] = delta[j];
-            for (size_t k = 0; k < m_topologia[L]; k++)
-            {
-                m_gradientes_pesos[L][k][j] = ativacao_camada_anterior[k] * delta[j];
-            }
+            if (m_intervalo_checkpoint > 0)
+                alocar_area_checkpoint(area);
+            else
+                alocar_area_trabalho(area, true);
         }
+        m_perdas_lote.assign(m_areas_lote.size(), 0.0);
+
+        // Com checkpoints, as camadas recalculadas ficam numa área por micro-lote
+        m_areas_recomputo.resize(m_intervalo_checkpoint > 0 ? m_n_micro_lotes : 0);
+        for (auto &area : m_areas_recomputo)
+            alocar_area_trabalho(area, true);
     }
-} // backpropagate
+} // preparar_treino
 
-void Sequencial::otimizar(double taxa_aprendizagem, double beta1 = 0.9,
-                          double beta2 = 0.999, double epsilon = 1e-8)
+void Sequencial::liberar_estado_treino()
 {
-    double gradiente, atualizacao;
-    double m, v;         // momentos
-    double m_hat, v_hat; // biases dos momentos
+    liberar(m_gradientes_pesos);
+    liberar(m_gradientes_biases);
+    liberar(m_pesos_m);
+    liberar(m_pesos_v);
+    liberar(m_biases_m);
+    liberar(m_biases_v);
+    liberar(m_gradientes_extrator);
+    liberar(m_extrator_m);
+    liberar(m_extrator_v);
+    for (auto *vetores : {&m_gradientes_gama, &m_gradientes_beta, &m_gama_m, &m_gama_v, &m_beta_m, &m_beta_v,
+                          &m_inversos_desvio})
+        liberar(*vetores);
+    m_timestep = 0;
+
+    liberar(m_area.deltas);
+    liberar(m_area.deltas_imagens);
+    liberar(m_areas_lote);
+    liberar(m_areas_recomputo);
+    liberar(m_perdas_lote);
+    for (auto *vetor : {&m_logits_saida_lote, &m_esperadas_lote, &m_ativacoes_saida_lote, &m_deltas_saida_lote})
+        liberar(*vetor);
+    m_grafo_pipeline.limpar();
+
+    m_lotes_acumulados = 0;
+    m_amostras_acumuladas = 0;
+}
 
-    // Incrementa o contador de tempo (para correção de bias)
-    m_timestep++;
-    long t = m_timestep;
+const Vetor &Sequencial::feed_forward(const Vetor &entradas) const
+{
+    return feed_forward(entradas, m_area);
+}
 
-    //===============================//
-    //  PASSO 1: Atualizar os pesos  //
-    //===============================//
-    // Para cada camada de pesos L
-    #pragma omp parallel for
-    for (size_t L = 0; L < m_pesos.size(); L++)
-        // Para cada neurônio de origem k
-        #pragma omp parallel for
-        for (size_t k = 0; k < m_pesos[L].size(); k++)
-            // Para cada neurônio de destino j
-            #pragma omp parallel for
-            for (size_t j = 0; j < m_pesos[L][k].size(); j++)
-            {
-                // Pega o gradiente calculado pelo backpropagate
-                gradiente = m_gradientes_pesos[L][k][j];
+size_t Sequencial::prever_classe(const Vetor &entradas) const
+{
+    const Vetor &logits = feed_forward(entradas, m_area, false);
+    if (logits.empty())
+        throw std::invalid_argument("entrada com tamanho diferente da camada de entrada da rede");
 
-                // 1. Atualiza o primeiro momento (média dos gradientes)
-                m = m_pesos_m[L][k][j];
-                m_pesos_m[L][k][j] = beta1 * m + (1.0 - beta1) * gradiente;
+    return m_camada_saida->argmax(logits.data(), logits.size());
+}
+
+void Sequencial::prever_top_k(const Vetor &entradas, size_t k, std::vector<size_t> &indices) const
+{
+    const Vetor &logits = feed_forward(entradas, m_area, false);
+    if (logits.empty())
+        throw std::invalid_argument("entrada com tamanho diferente da camada de entrada da rede");
 
-                // 2. atualiza o segundo momento (média dos gradientes ao quadrado)
-                v = m_pesos_v[L][k][j];
-                m_pesos_v[L][k][j] = beta2 * v + (1.0 - beta2) * pow(gradiente, 2.0);
+    indices.resize(std::min(k, logits.size()));
+    m_camada_saida->top_k(logits.data(), logits.size(), indices.size(), indices.data());
+}
 
-                // 3. Corrige o bias dos momentos
-                m_hat = m_pesos_m[L][k][j] / (1.0 - pow(beta1, t));
-                v_hat = m_pesos_v[L][k][j] / (1.0 - pow(beta2, t));
+void Sequencial::prever_classes(const std::vector<Vetor> &entradas, std::vector<size_t> &classes) const
+{
+    // Valida antes: uma exceção dentro do paralelo_para não chegaria a quem chamou
+    for (const Vetor &entrada : entradas)
+    {
+        if (entrada.size() != get_tamanho_entrada())
+            throw std::invalid_argument("entrada com tamanho diferente da camada de entrada da rede");
+    }
 
-                // 4. Calcula a atualização do peso
-                // epsilon é usado para evitar divisão por zero
-                atualizacao = taxa_aprendizagem * m_hat / (sqrt(v_hat) + epsilon);
+    classes.resize(entradas.size());
 
-                // 5. Aplica a atualização
-                m_pesos[L][k][j] -= atualizacao;
-            }
+    size_t custo_amostra = 0;
+    for (size_t i = 0; i < m_pesos.size(); i++)
+        custo_amostra += m_topologia[i] * m_topologia[i + 1];
 
-    //================================//
-    //  PASSO 2: Atualizar os biases  //
-    //================================//
-    // Para cada camada de pesos L
-    #pragma omp parallel for
-    for (size_t L = 0; L < m_biases.size(); L++)
-        // Para cada bias j
-        #pragma omp parallel for
-        for (size_t j = 0; j < m_biases[L].size(); j++)
+    m_execucao->paralelo_para(entradas.size(), custo_amostra,
+        [&](size_t inicio, size_t fim)
         {
-            // Pega o gradiente calculado pelo backpropagate
-            gradiente = m_gradientes_biases[L][j];
+            AreaTrabalho area;
+            alocar_area_trabalho(area);
 
-            // 1. Atualiza o primeiro momento
-            m = m_biases_m[L][j];
-            m_biases_m[L][j] = beta1 * m + (1.0 - beta1) * gradiente;
+            for (size_t i = inicio; i < fim; ++i)
+            {
+                const Vetor &logits = feed_forward(entradas[i], area, false);
+                classes[i] = m_camada_saida->argmax(logits.data(), logits.size());
+            }
+        });
+}
 
-            // 2. Atualiza o segundo momento
-            v = m_biases_v[L][j];
-            m_biases_v[L][j] = beta2 * v + (1.0 - beta2) * pow(gradiente, 2.0);
+const Vetor &Sequencial::feed_forward(const Vetor &entradas, AreaTrabalho &area, bool ativar_saida) const
+{
+    NN_SPAN("feed_forward");
 
-            // 3. Corrige o bias dos momentos
-            m_hat = m_biases_m[L][j] / (1.0 - pow(beta1, t));
-            v_hat = m_biases_v[L][j] / (1.0 - pow(beta2, t));
+    // Verifica se a entrada tem o tamanho correto
+    if (entradas.size() != get_tamanho_entrada())
+    {
+        return vetor_vazio;
+    }
 
-            // 4. Calcula a atualização do peso
-            atualizacao = taxa_aprendizagem * m_hat / (sqrt(v_hat) + epsilon);
+    // A ativação da camada 0 são as próprias entradas (ou a saída das camadas de imagem)
+    if (m_extrator.empty())
+        std::copy(entradas.begin(), entradas.end(), area.ativacoes[0].begin());
+    else
+        propagar_extrator(entradas, area);
 
-            // 5. Aplica a atualização
-            m_biases[L][j] -= atualizacao;
-        }
-} // otimizar
+    // --- Entrada -> Ocultas -> Saída ---
 
-double Sequencial::calc_loss(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas_esperadas) const
-{
-    double perda_total = 0.0;
-    for (size_t i = 0; i < entradas.size(); i++)
-    {
-        auto saida_ativada = feed_forward(entradas[i]);
-        perda_total += m_camada_saida->calcular_loss(saida_ativada, saidas_esperadas[i]);
-    }
+    // Itera através de cada camada de conexão (pesos e biases)
+    // O índice 'i' representa a conexão entre a camada 'i' e 'i+1'
+    for (size_t i = 0; i < m_pesos.size(); ++i)
+        propagar_camada(i, area, ativar_saida);
 
-    perda_total /= entradas.size();
-    return perda_total;
-}
+    return ativar_saida ? area.ativacoes.back() : area.logits.back();
+} // feed_forward
 
-namespace
+void Sequencial::propagar_camada(size_t i, AreaTrabalho &area, bool ativar_saida) const
 {
-    size_t argmax(const nn::Vetor& vec)
-    {
-        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
-    }
-}
+    NN_SPAN("forward camada", i);
+    contadores::Escopo medir(contadores::FORWARD, 2.0 * m_topologia[i] * m_topologia[i + 1]);
 
-double Sequencial::calc_accuracy(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas_esperadas) const
+    if (!calcular_logits(i, area))
+        ativar_camada(i, area, ativar_saida);
+} // propagar_camada
+
+bool Sequencial::calcular_logits(size_t i, AreaTrabalho &area) const
 {
-    if (entradas.empty() || entradas.size() != saidas_esperadas.size())
-    {
-        return 0.0;
-    }
+    const Vetor &camada_atual_valores = area.ativacoes[i];
+    Vetor &proxima_camada_logits = area.logits[i];
 
-    int acertos = 0;
+    // Ativação fundida: cada bloco de logits é ativado logo depois dos biases
+    auto ativacao = m_fundir_ativacao[i] ? m_ativacoes[i].funcao_vetor : nullptr;
+    double *ativado = ativacao ? area.ativacoes[i + 1].data() : nullptr;
 
-    #pragma omp parallel for reduction(+:acertos)
-    for (size_t i = 0; i < entradas.size(); ++i)
+    // Calcula a soma ponderada para cada neurônio da próxima camada (logits)
+    // Cada neurônio custa uma multiplicação por neurônio da camada atual
+    if (m_precisao_pesos != PrecisaoPesos::DOUBLE)
     {
-        Vetor previsao = feed_forward(entradas[i]);
-
-        if (previsao.empty()) continue;
+        // Pesos em 16 bits: a entrada vira float uma vez e cada neurônio lê
+        // uma linha contínua de m_pesos_meia
+        float *entrada = area.entrada_float.data();
+        for (size_t k = 0; k < camada_atual_valores.size(); k++)
+            entrada[k] = static_cast<float>(camada_atual_valores[k]);
+
+        m_execucao->paralelo_para(proxima_camada_logits.size(), camada_atual_valores.size(),
+            [&](size_t inicio, size_t fim)
+            {
+                produto_matriz_meia(m_precisao_pesos, m_pesos_meia[i].data(), entrada, camada_atual_valores.size(),
+                                    inicio, fim, proxima_camada_logits.data());
 
-        size_t index_previsto = argmax(previsao);
-        size_t index_real     = argmax(saidas_esperadas[i]);
+                for (size_t j = inicio; j < fim; ++j)
+                    proxima_camada_logits[j] += m_biases[i][j];
 
-        if (index_previsto == index_real)
-        {
-            acertos++;
-        }
+                if (ativacao)
+                    ativacao(proxima_camada_logits.data() + inicio, ativado + inicio, fim - inicio);
+            });
+    }
+    else
+    {
+        // Sem autoajuste, o plano padrão é o laço por neurônio dividido pelo grão mínimo
+        produto_camada(m_planos[i], m_pesos[i], m_biases[i], camada_atual_valores, proxima_camada_logits,
+                       *m_execucao, ativacao, ativado);
     }
 
-    return static_cast<double>(acertos) / entradas.size();
-}
+    return ativacao != nullptr;
+} // calcular_logits
 
-void Sequencial::train(const std::vector<Vetor> &entradas_treino, const std::vector<Vetor> &saidas_treino,
-                       const std::vector<Vetor> &entradas_validacao, const std::vector<Vetor> &saidas_validacao,
-                       double taxa_aprendizagem, size_t janela_analise, double target_loss, double threshold)
+void Sequencial::ativar_camada(size_t i, AreaTrabalho &area, bool ativar_saida) const
 {
-    if (janela_analise < 2) janela_analise = 2;
-    double melhor_perda = INFINITY;
-
-    std::vector<Matriz> melhores_pesos;
-    std::vector<Vetor>  melhores_biases;
-
-    std::deque<double> historico_loss;
+    const Vetor &proxima_camada_logits = area.logits[i];
 
-    for (size_t epoca = 1; epoca > 0; epoca ++)
+    if (i < m_pesos.size() - 1) // Camadas ocultas
     {
-        for (size_t i = 0; i < entradas_treino.size(); i++)
-        {
-            feed_forward(entradas_treino[i]); // para gerar os logits
-            backpropagate(saidas_treino[i]);
-            otimizar(taxa_aprendizagem);
-        }
+        // Aplica a ativação (barata demais para valer a pena paralelizar)
+        Vetor &proxima_camada_ativacoes = area.ativacoes[i + 1];
+        const func &ativacao = m_ativacoes[i];
 
-        auto perda_atual = calc_loss(entradas_validacao, saidas_validacao);
-        
-        historico_loss.push_front(perda_atual);
-        
-        long double desvio_padrao = 0.0;
-        if (historico_loss.size() > janela_analise)
-        {
-            historico_loss.pop_back();
+        // Com normalização (médias móveis), a ativação recebe gama * x̂ + beta
+        // em vez dos logits, que ficam intactos (ver InferenciaIncremental)
+        const Vetor *entrada_ativacao = &proxima_camada_logits;
+        const NormalizacaoLote &normalizacao = m_normalizacoes[i];
 
-            long double media = 0.0;
-            for (double loss : historico_loss)
-            {
-                media += loss;
-            }
-    
-            media /= historico_loss.size();
-    
-            for (double loss : historico_loss)
-            {
-                desvio_padrao += pow((loss - media), 2);
-            }
-    
-            desvio_padrao = sqrt(desvio_padrao / (double)historico_loss.size());
-    
-            
-            if (desvio_padrao <= threshold)
+        if (normalizacao.ligada())
+        {
+            Vetor &normalizados = area.normalizados[i];
+            for (size_t j = 0; j < proxima_camada_logits.size(); j++)
             {
-                std::cout << ">>> LOSS ESTABILIZADO <<<\n";
-                std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
-                break;
+                normalizados[j] = (proxima_camada_logits[j] - normalizacao.media[j]) /
+                                  std::sqrt(normalizacao.variancia[j] + normalizacao.epsilon);
+                proxima_camada_ativacoes[j] = normalizacao.gama[j] * normalizados[j] + normalizacao.beta[j];
             }
-            
-        }
-        
-        if (epoca % 1 == 0)
-        {
-            auto precisao = calc_accuracy(entradas_validacao, saidas_validacao);
-            std::cout << "ÉPOCA: " << epoca <<
-            "\nLOSS: "<< perda_atual << 
-            "\nPRECISÃO: " << precisao * 100.0 << "% (SCE)"<<
-            "\nDP: " << desvio_padrao << std::endl << std::endl;
+            entrada_ativacao = &proxima_camada_ativacoes;
         }
 
-        if (perda_atual < melhor_perda)
+        if (ativacao.funcao_vetor)
         {
-            melhores_pesos = m_pesos;
-            melhores_biases= m_biases;
-            melhor_perda = perda_atual;
+            ativacao.funcao_vetor(entrada_ativacao->data(), proxima_camada_ativacoes.data(),
+                                  proxima_camada_logits.size());
         }
-
-        if (melhor_perda >= 0 && melhor_perda <= target_loss)
+        else
         {
-            std::cout << ">>> ALVO ATINGIDO <<<\n";
-            std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
-            break;
+            for (size_t j = 0; j < proxima_camada_logits.size(); j++)
+            {
+                proxima_camada_ativacoes[j] = ativacao.funcao((*entrada_ativacao)[j]);
+            }
         }
+    }
+    else if (ativar_saida)
+    {
+        // Aplica a ativação de fato (os logits de saída)
+        m_camada_saida->forward(proxima_camada_logits, area.ativacoes.back());
+    }
+} // ativar_camada
+
+// APRENDIZADO DE MÁQUINA
+void Sequencial::backpropagate(const Vetor &saida_esperada, AreaTrabalho &area)
+{
+    NN_SPAN("backpropagate");
+
+    /*
+    Obs: observe que, ao contrário do feed_forward, neste método estamos
+    começando da última camada (de saída) para poder calcular o gradiente
+    de erro de cada neurônio.
+    */
+
+    // O índice 'L' representa a camada de CONEXÕES (pesos/biases).
+    for (long L = m_pesos.size() - 1; L >= 0; L--)
+    {
+        retropropagar_camada(L, saida_esperada, area, false);
 
+        if (m_grupo)
+            enviar_gradientes_camada(L);
     }
-    
 
-    std::cout << ">>> FIM DO TREINO <<< " << std::endl << std::endl;
-    std::cout << "LOSS FINAL: " << melhor_perda << std::endl;
+    if (!m_extrator.empty())
+        retropropagar_extrator(area, false);
+} // backpropagate
 
-    m_pesos = melhores_pesos;
-    m_biases = melhores_biases;
-} // train
+void Sequencial::propagar_extrator(const Vetor &entradas, AreaTrabalho &area) const
+{
+    // A entrada fica guardada: o backward da primeira camada precisa dela
+    std::copy(entradas.begin(), entradas.end(), area.imagens[0].begin());
 
-//
-// SETTERS
-//
+    for (size_t i = 0; i < m_extrator.size(); i++)
+        m_extrator[i]->forward(area.imagens[i].data(), area.imagens[i + 1].data(), area.auxiliares[i].data(),
+                               *m_execucao);
 
-void Sequencial::set_pesos(int index_camada, const Matriz &novos_pesos)
+    const Vetor &saida = area.imagens.back();
+    std::copy(saida.begin(), saida.end(), area.ativacoes[0].begin());
+}
+
+void Sequencial::retropropagar_extrator(AreaTrabalho &area, bool acumular)
 {
-    if (index_camada < m_pesos.size() && novos_pesos.size() == m_pesos[index_camada].size())
-    {
-        for (int i = 0; i < m_pesos[index_camada].size(); ++i)
+    NN_SPAN("backward extrator");
+
+    // Gradiente em relação à entrada das densas (a saída do extrator):
+    // o delta da camada 1 volta pelos pesos da camada 0
+    const Vetor &delta = area.deltas[0];
+    Vetor &gradiente_saida = area.deltas_imagens.back();
+
+    m_execucao->paralelo_para(m_topologia[0], m_topologia[1],
+        [&](size_t inicio, size_t fim)
         {
-            if (novos_pesos[i].size() != m_pesos[index_camada][i].size())
+            for (size_t k = inicio; k < fim; k++)
             {
-                throw std::runtime_error("O index da camada é inválido");
+                const Vetor &linha = m_pesos[0][k];
+                double soma = 0.0;
+                for (size_t j = 0; j < delta.size(); j++)
+                    soma += linha[j] * delta[j];
+                gradiente_saida[k] = soma;
             }
-        }
-        m_pesos[index_camada] = novos_pesos;
-    }
-}
+        });
 
-void Sequencial::set_biases(int index_camada, const Vetor &novos_biases)
-{
-    if (index_camada < m_biases.size() && novos_biases.size() == m_biases[index_camada].size())
-    {
-        m_biases[index_camada] = novos_biases;
-    }
-    else
+    for (long i = m_extrator.size() - 1; i >= 0; i--)
     {
-        throw std::runtime_error("O index da camada é inválido");
+        // A primeira camada não precisa do gradiente da entrada da rede
+        double *dx = i > 0 ? area.deltas_imagens[i].data() : nullptr;
+
+        m_extrator[i]->backward(area.imagens[i].data(), area.imagens[i + 1].data(), area.auxiliares[i].data(),
+                                area.deltas_imagens[i + 1].data(), dx, m_gradientes_extrator[i].data(), acumular,
+                                *m_execucao);
+    }
+}
+
+double Sequencial::retropropagar_camada(size_t L, const Vetor &saida_esperada, AreaTrabalho &area, bool acumular)
+{
+    NN_SPAN("backward camada", L);
+
+    // Gradientes dos pesos e, nas ocultas, o delta vindo da camada seguinte
+    double flops = 2.0 * m_topologia[L] * m_topologia[L + 1];
+    if (L + 1 < m_pesos.size())
+        flops += 2.0 * m_topologia[L + 1] * m_topologia[L + 2];
+    contadores::Escopo medir(contadores::BACKWARD, flops);
+
+    double perda = calcular_delta(L, saida_esperada, area);
+
+    // Sem as estatísticas do lote, média e variância (móveis) são constantes:
+    // a normalização é só uma escala de cada neurônio
+    const NormalizacaoLote &normalizacao = m_normalizacoes[L];
+    if (normalizacao.ligada())
+    {
+        Vetor &delta = area.deltas[L];
+        const Vetor &normalizados = area.normalizados[L];
+
+        for (size_t j = 0; j < delta.size(); j++)
+        {
+            m_gradientes_gama[L][j] = (acumular ? m_gradientes_gama[L][j] : 0.0) + delta[j] * normalizados[j];
+            m_gradientes_beta[L][j] = (acumular ? m_gradientes_beta[L][j] : 0.0) + delta[j];
+            delta[j] *= normalizacao.gama[j] / std::sqrt(normalizacao.variancia[j] + normalizacao.epsilon);
+        }
+    }
+
+    acumular_gradientes(L, area, acumular);
+
+    return perda;
+} // retropropagar_camada
+
+double Sequencial::calcular_delta(size_t L, const Vetor &saida_esperada, AreaTrabalho &area)
+{
+    Vetor &delta = area.deltas[L]; // O delta para a camada (L+1)
+    double perda = 0.0;
+
+    if (L == m_pesos.size() - 1)
+    {
+        //=======================================================//
+        //  PASSO 1: Calcular o erro (delta) da CAMADA DE SAÍDA  //
+        //=======================================================//
+        // A ativação de saída, o loss e o delta saem juntos dos logits
+        perda = m_camada_saida->forward_backward_lote(area.logits.back(), saida_esperada, area.ativacoes.back(), delta);
+    }
+    else
+    {
+        //====================================================//
+        //  PASSO 2: Propagar o erro para as CAMADAS OCULTAS  //
+        //====================================================//
+        const Vetor &delta_camada_seguinte = area.deltas[L + 1]; // 'delta' da camada seguinte
+        const Matriz &pesos_camada_seguinte = m_pesos[L + 1];
+        const Vetor &logits_camada_atual = area.logits[L];
+        const Vetor &ativacoes_camada_atual = area.ativacoes[L + 1];
+        const func &ativacao = m_ativacoes[L];
+        auto multiplicar_derivada = ativacao.multiplicar_derivada;
+
+        // Com normalização, a derivada é em relação a gama * x̂ + beta
+        const NormalizacaoLote &normalizacao = m_normalizacoes[L];
+        auto entrada_ativacao = [&](size_t k)
+        {
+            if (!normalizacao.ligada())
+                return logits_camada_atual[k];
+            return normalizacao.gama[k] * area.normalizados[L][k] + normalizacao.beta[k];
+        };
+
+        // Para cada neurônio 'k' na camada atual (L+1)
+        m_execucao->paralelo_para(m_topologia[L + 1], m_topologia[L + 2],
+            [&](size_t inicio, size_t fim)
+            {
+                for (size_t k = inicio; k < fim; k++)
+                {
+                    double erro_propagado = 0.0;
+                    // Somar o erro vindo de cada neurônio 'j' da camada seguinte (L+2)
+                    for (size_t j = 0; j < m_topologia[L + 2]; j++)
+                    {
+                        erro_propagado += delta_camada_seguinte[j] * pesos_camada_seguinte[k][j];
+                    }
+
+                    if (multiplicar_derivada)
+                        delta[k] = erro_propagado;
+                    else
+                        delta[k] = erro_propagado * ativacao.derivada(entrada_ativacao(k));
+                }
+
+                // Derivada a partir das ativações guardadas no feed_forward
+                if (multiplicar_derivada)
+                    multiplicar_derivada(ativacoes_camada_atual.data() + inicio, delta.data() + inicio, fim - inicio);
+            });
+    }
+
+    return perda;
+} // calcular_delta
+
+void Sequencial::acumular_gradientes(size_t L, AreaTrabalho &area, bool acumular)
+{
+    const Vetor &delta = area.deltas[L];
+
+    // Agora, com o delta, calculamos os gradientes para a camada de pesos L.
+    // Ao acumular (mini-lotes), os gradientes de cada amostra são somados.
+    const Vetor &ativacao_camada_anterior = area.ativacoes[L];
+
+    for (size_t j = 0; j < m_topologia[L + 1]; j++)
+        m_gradientes_biases[L][j] = (acumular ? m_gradientes_biases[L][j] : 0.0) + delta[j];
+
+    // Para cada neurônio 'k' na camada ANTERIOR:
+    m_execucao->paralelo_para(m_topologia[L], m_topologia[L + 1],
+        [&](size_t inicio, size_t fim)
+        {
+            for (size_t k = inicio; k < fim; k++)
+            {
+                Vetor &gradientes = m_gradientes_pesos[L][k];
+                double ativacao = ativacao_camada_anterior[k];
+
+                // O gradiente do peso é o sinal de erro do neurônio de destino
+                // multiplicado pela ativação do neurônio de origem.
+                if (acumular)
+                    for (size_t j = 0; j < m_topologia[L + 1]; j++)
+                        gradientes[j] += ativacao * delta[j];
+                else
+                    for (size_t j = 0; j < m_topologia[L + 1]; j++)
+                        gradientes[j] = ativacao * delta[j];
+            }
+        });
+} // acumular_gradientes
+
+void Sequencial::escalar_gradientes(double fator)
+{
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        for (auto &linha : m_gradientes_pesos[L])
+            for (auto &g : linha)
+                g *= fator;
+
+        for (auto &g : m_gradientes_biases[L])
+            g *= fator;
+    }
+
+    for (auto &gradientes : m_gradientes_extrator)
+        for (auto &g : gradientes)
+            g *= fator;
+
+    for (auto *vetores : {&m_gradientes_gama, &m_gradientes_beta})
+        for (auto &gradientes : *vetores)
+            for (auto &g : gradientes)
+                g *= fator;
+}
+
+//
+// TREINO EM MINI-LOTES (PIPELINE)
+//
+
+void Sequencial::configurar_pipeline(size_t tamanho_lote, size_t n_micro_lotes, EscalonadorTarefas *escalonador)
+{
+    m_tamanho_lote = std::max<size_t>(tamanho_lote, 1);
+    m_n_micro_lotes = std::min(std::max<size_t>(n_micro_lotes, 1), m_tamanho_lote);
+    m_escalonador = escalonador;
+
+    // As áreas de trabalho de cada amostra são alocadas no próximo treino
+    // (preparar_treino)
+    liberar(m_areas_lote);
+    liberar(m_areas_recomputo);
+    liberar(m_perdas_lote);
+
+    // O grafo depende da topologia e do número de micro-lotes: é refeito
+    m_grafo_pipeline.limpar();
+}
+
+void Sequencial::configurar_acumulacao(size_t lotes_por_passo)
+{
+    m_lotes_por_passo = std::max<size_t>(lotes_por_passo, 1);
+    m_lotes_acumulados = 0;
+    m_amostras_acumuladas = 0;
+}
+
+void Sequencial::configurar_checkpoint(size_t intervalo)
+{
+    m_intervalo_checkpoint = intervalo;
+
+    // As áreas das amostras mudam de formato: são refeitas no próximo treino
+    liberar(m_areas_lote);
+    liberar(m_areas_recomputo);
+    liberar(m_perdas_lote);
+}
+
+void Sequencial::alocar_area_checkpoint(AreaTrabalho &area) const
+{
+    // Só as ativações das camadas 0, k, 2k... (antes da saída)
+    area.ativacoes.assign(m_topologia.size(), Vetor());
+    for (size_t i = 0; i + 1 < m_topologia.size(); i += m_intervalo_checkpoint)
+        area.ativacoes[i].assign(m_topologia[i], 0.0);
+
+    // e o delta da última camada retropropagada, que a próxima vai usar
+    size_t maior = *std::max_element(m_topologia.begin() + 1, m_topologia.end());
+    area.deltas.assign(1, Vetor(maior, 0.0));
+
+    liberar(area.logits);
+    liberar(area.entrada_float);
+}
+
+void Sequencial::recalcular_ate(size_t L, const AreaTrabalho &amostra, AreaTrabalho &area)
+{
+    // Forward desde o checkpoint mais próximo abaixo de L até a camada L
+    size_t checkpoint = L / m_intervalo_checkpoint * m_intervalo_checkpoint;
+
+    const Vetor &origem = amostra.ativacoes[checkpoint];
+    std::copy(origem.begin(), origem.end(), area.ativacoes[checkpoint].begin());
+
+    for (size_t i = checkpoint; i <= L; i++)
+        propagar_camada(i, area, false);
+}
+
+void Sequencial::processar_micro_lote(size_t micro, bool forward, size_t L)
+{
+    size_t tamanho = m_lote.fim - m_lote.inicio;
+    size_t inicio = micro * tamanho / m_n_micro_lotes;
+    size_t fim = (micro + 1) * tamanho / m_n_micro_lotes;
+
+    const size_t ultima = m_pesos.size() - 1;
+    const size_t k = m_intervalo_checkpoint;
+
+    for (size_t s = inicio; s < fim; s++)
+    {
+        AreaTrabalho &area = m_areas_lote[s];
+
+        if (forward)
+        {
+            if (L == 0)
+            {
+                const Vetor &entrada = m_lote.dados->entrada(m_lote.inicio + s);
+                std::copy(entrada.begin(), entrada.end(), area.ativacoes[0].begin());
+            }
+
+            if (k == 0)
+            {
+                // A ativação de saída fica para o backward (junto com o loss)
+                propagar_camada(L, area, false);
+            }
+            else if ((L + 1) % k == 0 && L < ultima)
+            {
+                // Fecha um trecho: calcula desde o checkpoint anterior na área
+                // do micro-lote e guarda só o próximo checkpoint. As outras
+                // camadas são recalculadas no backward
+                AreaTrabalho &recomputo = m_areas_recomputo[micro];
+                recalcular_ate(L, area, recomputo);
+
+                const Vetor &saida = recomputo.ativacoes[L + 1];
+                std::copy(saida.begin(), saida.end(), area.ativacoes[L + 1].begin());
+            }
+        }
+        else
+        {
+            // A primeira amostra do lote sobrescreve os gradientes do lote
+            // anterior (a não ser que eles estejam sendo acumulados)
+            bool acumular = m_lote.acumular || s > 0;
+            const Vetor &esperada = m_lote.dados->saida(m_lote.inicio + s);
+            double perda;
+
+            if (k == 0)
+            {
+                perda = retropropagar_camada(L, esperada, area, acumular);
+            }
+            else
+            {
+                AreaTrabalho &recomputo = m_areas_recomputo[micro];
+                recalcular_ate(L, area, recomputo);
+
+                // O delta da camada seguinte vem da amostra, e o desta volta para ela
+                Vetor &delta_pendente = area.deltas[0];
+                if (L < ultima)
+                    std::copy(delta_pendente.begin(), delta_pendente.begin() + m_topologia[L + 2],
+                              recomputo.deltas[L + 1].begin());
+
+                perda = retropropagar_camada(L, esperada, recomputo, acumular);
+
+                std::copy(recomputo.deltas[L].begin(), recomputo.deltas[L].end(), delta_pendente.begin());
+            }
+
+            if (L == ultima)
+                m_perdas_lote[s] = perda;
+        }
+    }
+
+    // O último micro-lote fecha os gradientes da camada L
+    if (!forward && m_grupo && m_lote.fechar && micro == m_n_micro_lotes - 1)
+        enviar_gradientes_camada(L);
+}
+
+void Sequencial::montar_grafo_pipeline()
+{
+    /*
+    Tarefas: F(L, m) e B(L, m) para cada camada de conexões L e micro-lote m.
+    - F(L, m) depende de F(L-1, m): a camada anterior do mesmo micro-lote
+    - B(ultima, m) depende de F(ultima, m)
+    - B(L, m) depende de B(L+1, m)
+    - B(L, m) depende de B(L, m-1): os gradientes da camada L são somados
+      por um micro-lote de cada vez, sem travas
+    Assim, enquanto o micro-lote m ainda está nas primeiras camadas, o
+    micro-lote m-1 já pode estar nas últimas, ou voltando no backward.
+    */
+    m_grafo_pipeline.limpar();
+
+    size_t n_camadas = m_pesos.size();
+    std::vector<size_t> fwd(n_camadas * m_n_micro_lotes), bwd(n_camadas * m_n_micro_lotes);
+
+    for (size_t m = 0; m < m_n_micro_lotes; m++)
+        for (size_t L = 0; L < n_camadas; L++)
+        {
+            fwd[m * n_camadas + L] = m_grafo_pipeline.adicionar_tarefa([this, m, L] { processar_micro_lote(m, true, L); });
+            bwd[m * n_camadas + L] = m_grafo_pipeline.adicionar_tarefa([this, m, L] { processar_micro_lote(m, false, L); });
+        }
+
+    for (size_t m = 0; m < m_n_micro_lotes; m++)
+        for (size_t L = 0; L < n_camadas; L++)
+        {
+            size_t f = fwd[m * n_camadas + L];
+            size_t b = bwd[m * n_camadas + L];
+
+            if (L > 0)
+                m_grafo_pipeline.adicionar_dependencia(fwd[m * n_camadas + L - 1], f);
+
+            if (L == n_camadas - 1)
+                m_grafo_pipeline.adicionar_dependencia(f, b);
+            else
+                m_grafo_pipeline.adicionar_dependencia(bwd[m * n_camadas + L + 1], b);
+
+            if (m > 0)
+                m_grafo_pipeline.adicionar_dependencia(bwd[(m - 1) * n_camadas + L], b);
+        }
+}
+
+double Sequencial::treinar_lote(const VisaoDados &dados, size_t inicio, size_t fim, bool fechar)
+{
+    NN_SPAN("treinar_lote");
+
+    m_lote = {&dados, inicio, fim, m_lotes_acumulados > 0, fechar};
+    double perda = 0.0;
+
+    // As estatísticas do lote precisam dele inteiro a cada camada
+    if (tem_normalizacao() && fim - inicio > 1)
+    {
+        perda = treinar_lote_normalizado(dados, inicio, fim);
+    }
+    // O pipeline precisa de uma área de trabalho por amostra do lote
+    else if (m_n_micro_lotes > 1 && fim - inicio <= m_areas_lote.size())
+    {
+        if (m_grafo_pipeline.vazio())
+            montar_grafo_pipeline();
+
+        EscalonadorTarefas &escalonador = m_escalonador ? *m_escalonador : escalonador_padrao();
+        escalonador.executar(m_grafo_pipeline);
+
+        for (size_t s = 0; s < fim - inicio; s++)
+            perda += m_perdas_lote[s];
+    }
+    else
+    {
+        // Um único micro-lote: amostra por amostra, acumulando os gradientes
+        for (size_t s = 0; s < fim - inicio; s++)
+        {
+            AreaTrabalho &area = m_area;
+            feed_forward(dados.entrada(inicio + s), area, false);
+
+            bool ultima_amostra = s + 1 == fim - inicio;
+            for (long L = m_pesos.size() - 1; L >= 0; L--)
+            {
+                perda += retropropagar_camada(L, dados.saida(inicio + s), area, m_lote.acumular || s > 0);
+
+                if (m_grupo && fechar && ultima_amostra)
+                    enviar_gradientes_camada(L);
+            }
+
+            if (!m_extrator.empty())
+                retropropagar_extrator(area, m_lote.acumular || s > 0);
+        }
+    }
+
+    m_lotes_acumulados++;
+    m_amostras_acumuladas += fim - inicio;
+
+    // O otimizador recebe a média dos gradientes de todas as amostras
+    // acumuladas (de todos os processos)
+    if (fechar)
+    {
+        if (m_grupo)
+            receber_gradientes(1.0 / (m_amostras_acumuladas * m_grupo->get_n_processos()));
+        else
+            escalar_gradientes(1.0 / m_amostras_acumuladas);
+
+        m_lotes_acumulados = 0;
+        m_amostras_acumuladas = 0;
+    }
+
+    return perda / (fim - inicio);
+}
+
+//
+// NORMALIZAÇÃO EM LOTE
+//
+
+double Sequencial::treinar_lote_normalizado(const VisaoDados &dados, size_t inicio, size_t fim)
+{
+    const size_t n = fim - inicio;
+    const bool acumular = m_lote.acumular;
+    double perda = 0.0;
+
+    // Sem pipeline (n_micro_lotes = 1), as áreas do lote ficam livres para
+    // guardar as ativações de cada amostra
+    if (m_areas_lote.size() < n)
+    {
+        size_t antes = m_areas_lote.size();
+        m_areas_lote.resize(n);
+        for (size_t s = antes; s < n; s++)
+            alocar_area_trabalho(m_areas_lote[s], true);
+    }
+
+    for (size_t s = 0; s < n; s++)
+    {
+        const Vetor &entrada = dados.entrada(inicio + s);
+        AreaTrabalho &area = m_areas_lote[s];
+
+        if (m_extrator.empty())
+            std::copy(entrada.begin(), entrada.end(), area.ativacoes[0].begin());
+        else
+            propagar_extrator(entrada, area);
+    }
+
+    // Forward: a camada L de todas as amostras antes da L + 1
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        NN_SPAN("forward camada", L);
+        contadores::Escopo medir(contadores::FORWARD, 2.0 * n * m_topologia[L] * m_topologia[L + 1]);
+
+        for (size_t s = 0; s < n; s++)
+            calcular_logits(L, m_areas_lote[s]);
+
+        if (m_normalizacoes[L].ligada())
+            normalizar_lote(L, n);
+        else if (!m_fundir_ativacao[L])
+            for (size_t s = 0; s < n; s++)
+                ativar_camada(L, m_areas_lote[s], false);
+    }
+
+    // Backward: idem, da saída para a entrada
+    for (long L = m_pesos.size() - 1; L >= 0; L--)
+    {
+        NN_SPAN("backward camada", L);
+
+        double flops = 2.0 * m_topologia[L] * m_topologia[L + 1];
+        if (L + 1 < (long)m_pesos.size())
+            flops += 2.0 * m_topologia[L + 1] * m_topologia[L + 2];
+        contadores::Escopo medir(contadores::BACKWARD, n * flops);
+
+        if (L == (long)m_pesos.size() - 1)
+            perda += calcular_delta_saida_lote(dados, inicio, n);
+        else
+            for (size_t s = 0; s < n; s++)
+                perda += calcular_delta(L, dados.saida(inicio + s), m_areas_lote[s]);
+
+        if (m_normalizacoes[L].ligada())
+            retropropagar_normalizacao_lote(L, n, acumular);
+
+        for (size_t s = 0; s < n; s++)
+            acumular_gradientes(L, m_areas_lote[s], acumular || s > 0);
+    }
+
+    if (!m_extrator.empty())
+        for (size_t s = 0; s < n; s++)
+            retropropagar_extrator(m_areas_lote[s], acumular || s > 0);
+
+    return perda;
+} // treinar_lote_normalizado
+
+double Sequencial::calcular_delta_saida_lote(const VisaoDados &dados, size_t inicio, size_t n)
+{
+    const size_t largura = m_topologia.back();
+    const size_t total = n * largura;
+    if (m_logits_saida_lote.size() < total)
+        for (auto *vetor : {&m_logits_saida_lote, &m_esperadas_lote, &m_ativacoes_saida_lote, &m_deltas_saida_lote})
+            vetor->resize(total);
+
+    for (size_t s = 0; s < n; s++)
+    {
+        const Vetor &logits = m_areas_lote[s].logits.back();
+        const Vetor &esperada = dados.saida(inicio + s);
+        std::copy(logits.begin(), logits.end(), m_logits_saida_lote.begin() + s * largura);
+        std::copy(esperada.begin(), esperada.end(), m_esperadas_lote.begin() + s * largura);
+    }
+
+    double perda = m_camada_saida->forward_backward_lote(
+        LoteConstante(m_logits_saida_lote.data(), n, largura), LoteConstante(m_esperadas_lote.data(), n, largura),
+        LoteValores(m_ativacoes_saida_lote.data(), n, largura), LoteValores(m_deltas_saida_lote.data(), n, largura));
+
+    for (size_t s = 0; s < n; s++)
+    {
+        auto ativacoes = m_ativacoes_saida_lote.begin() + s * largura;
+        auto deltas = m_deltas_saida_lote.begin() + s * largura;
+        std::copy(ativacoes, ativacoes + largura, m_areas_lote[s].ativacoes.back().begin());
+        std::copy(deltas, deltas + largura, m_areas_lote[s].deltas.back().begin());
+    }
+
+    return perda;
+} // calcular_delta_saida_lote
+
+void Sequencial::normalizar_lote(size_t L, size_t n)
+{
+    NormalizacaoLote &normalizacao = m_normalizacoes[L];
+    Vetor &inversos = m_inversos_desvio[L];
+    const func &ativacao = m_ativacoes[L];
+
+    // Cada neurônio é independente: estatísticas, x̂, saída e médias móveis
+    // numa passada por neurônio, sem buffers do lote
+    m_execucao->paralelo_para(normalizacao.gama.size(), 4 * n,
+        [&](size_t inicio, size_t fim)
+        {
+            for (size_t j = inicio; j < fim; j++)
+            {
+                double media = 0.0;
+                for (size_t s = 0; s < n; s++)
+                    media += m_areas_lote[s].logits[L][j];
+                media /= n;
+
+                // Em duas passadas: E[z²] - E[z]² perde precisão
+                double variancia = 0.0;
+                for (size_t s = 0; s < n; s++)
+                {
+                    double d = m_areas_lote[s].logits[L][j] - media;
+                    variancia += d * d;
+                }
+                variancia /= n;
+
+                const double inverso = 1.0 / std::sqrt(variancia + normalizacao.epsilon);
+                inversos[j] = inverso;
+
+                for (size_t s = 0; s < n; s++)
+                {
+                    AreaTrabalho &area = m_areas_lote[s];
+                    double normalizado = (area.logits[L][j] - media) * inverso;
+                    area.normalizados[L][j] = normalizado;
+                    area.ativacoes[L + 1][j] = normalizacao.gama[j] * normalizado + normalizacao.beta[j];
+                }
+
+                // A média móvel guarda a variância sem viés (n - 1)
+                const double momento = normalizacao.momento;
+                normalizacao.media[j] = (1.0 - momento) * normalizacao.media[j] + momento * media;
+                normalizacao.variancia[j] =
+                    (1.0 - momento) * normalizacao.variancia[j] + momento * variancia * n / (n - 1);
+            }
+        });
+
+    // A ativação, no lugar
+    for (size_t s = 0; s < n; s++)
+    {
+        Vetor &saida = m_areas_lote[s].ativacoes[L + 1];
+
+        if (ativacao.funcao_vetor)
+            ativacao.funcao_vetor(saida.data(), saida.data(), saida.size());
+        else
+            for (double &valor : saida)
+                valor = ativacao.funcao(valor);
+    }
+} // normalizar_lote
+
+void Sequencial::retropropagar_normalizacao_lote(size_t L, size_t n, bool acumular)
+{
+    const NormalizacaoLote &normalizacao = m_normalizacoes[L];
+    const Vetor &inversos = m_inversos_desvio[L];
+    Vetor &gradientes_gama = m_gradientes_gama[L];
+    Vetor &gradientes_beta = m_gradientes_beta[L];
+
+    /*
+    Com δ o gradiente em relação a y = gama * x̂ + beta, o gradiente em
+    relação aos logits leva em conta a média e a variância do lote:
+      δz = gama / (n * desvio) * (n * δ - Σδ - x̂ * Σ(δ * x̂))
+    e as duas somas já são os gradientes de beta e gama.
+    */
+    m_execucao->paralelo_para(normalizacao.gama.size(), 4 * n,
+        [&](size_t inicio, size_t fim)
+        {
+            for (size_t j = inicio; j < fim; j++)
+            {
+                double soma_delta = 0.0, soma_delta_normalizado = 0.0;
+                for (size_t s = 0; s < n; s++)
+                {
+                    const AreaTrabalho &area = m_areas_lote[s];
+                    soma_delta += area.deltas[L][j];
+                    soma_delta_normalizado += area.deltas[L][j] * area.normalizados[L][j];
+                }
+
+                gradientes_gama[j] = (acumular ? gradientes_gama[j] : 0.0) + soma_delta_normalizado;
+                gradientes_beta[j] = (acumular ? gradientes_beta[j] : 0.0) + soma_delta;
+
+                const double escala = normalizacao.gama[j] * inversos[j] / n;
+                for (size_t s = 0; s < n; s++)
+                {
+                    AreaTrabalho &area = m_areas_lote[s];
+                    double &delta = area.deltas[L][j];
+                    delta = escala * (n * delta - soma_delta - area.normalizados[L][j] * soma_delta_normalizado);
+                }
+            }
+        });
+} // retropropagar_normalizacao_lote
+
+double Sequencial::train_step(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas,
+                              double taxa_aprendizagem)
+{
+    if (entradas.empty() || entradas.size() != saidas.size())
+        throw std::invalid_argument("o lote deve ter o mesmo número (não nulo) de entradas e saídas");
+
+    for (size_t s = 0; s < entradas.size(); s++)
+    {
+        if (entradas[s].size() != get_tamanho_entrada() || saidas[s].size() != m_topologia.back())
+            throw std::invalid_argument("amostra com tamanho diferente da topologia da rede");
+    }
+
+    preparar_treino();
+
+    bool fechar = m_lotes_acumulados + 1 >= m_lotes_por_passo;
+    double perda = treinar_lote(VisaoDados(entradas, saidas), 0, entradas.size(), fechar);
+
+    if (fechar)
+        otimizar(taxa_aprendizagem);
+
+    return perda;
+}
+
+//
+// TREINO DISTRIBUÍDO
+//
+
+void Sequencial::set_grupo_processos(GrupoProcessos *grupo)
+{
+    if (grupo && !m_extrator.empty())
+        throw std::logic_error("o treino distribuído não suporta camadas de imagem");
+
+    if (grupo && tem_normalizacao())
+        throw std::logic_error("o treino distribuído não suporta normalização em lote");
+
+    m_grupo = grupo;
+    m_gradientes_planos.clear();
+
+    if (!m_grupo)
+        return;
+
+    m_gradientes_planos.resize(m_pesos.size());
+    for (size_t L = 0; L < m_pesos.size(); L++)
+        m_gradientes_planos[L].assign(m_topologia[L] * m_topologia[L + 1] + m_topologia[L + 1], 0.0);
+
+    // Todos começam com os pesos do rank 0
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        for (auto &linha : m_pesos[L])
+            m_grupo->broadcast(linha.data(), linha.size());
+
+        m_grupo->broadcast(m_biases[L].data(), m_biases[L].size());
+    }
+
+    atualizar_pesos_meia();
+}
+
+void Sequencial::enviar_gradientes_camada(size_t L)
+{
+    Vetor &plano = m_gradientes_planos[L];
+    auto it = plano.begin();
+
+    for (const auto &linha : m_gradientes_pesos[L])
+        it = std::copy(linha.begin(), linha.end(), it);
+    std::copy(m_gradientes_biases[L].begin(), m_gradientes_biases[L].end(), it);
+
+    m_grupo->allreduce_assincrono(plano.data(), plano.size());
+}
+
+void Sequencial::receber_gradientes(double fator)
+{
+    NN_SPAN("receber_gradientes");
+
+    m_grupo->esperar();
+
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        const double *p = m_gradientes_planos[L].data();
+
+        for (auto &linha : m_gradientes_pesos[L])
+            for (auto &g : linha)
+                g = *p++ * fator;
+
+        for (auto &g : m_gradientes_biases[L])
+            g = *p++ * fator;
+    }
+}
+
+void Sequencial::otimizar(double taxa_aprendizagem, double beta1, double beta2, double epsilon)
+{
+    NN_SPAN("otimizar");
+
+    // ~14 operações por parâmetro (momentos, correções, raiz e atualização)
+    size_t n_parametros = 0;
+    for (size_t L = 0; L < m_pesos.size(); L++)
+        n_parametros += (m_topologia[L] + 1) * m_topologia[L + 1];
+    for (const auto &camada : m_extrator)
+        n_parametros += camada->get_parametros().size();
+    for (const auto &normalizacao : m_normalizacoes)
+        n_parametros += 2 * normalizacao.gama.size();
+    contadores::Escopo medir(contadores::OTIMIZADOR, 14.0 * n_parametros);
+
+    // Incrementa o contador de tempo (para correção de bias)
+    m_timestep++;
+    long t = m_timestep;
+
+    // Fatores de correção do bias dos momentos (iguais para todos os parâmetros)
+    const double correcao1 = 1.0 - pow(beta1, t);
+    const double correcao2 = 1.0 - pow(beta2, t);
+
+    // Atualiza um vetor de parâmetros com seus momentos e gradientes
+    auto adam = [&](Vetor &parametros, Vetor &momento_m, Vetor &momento_v, const Vetor &gradientes)
+    {
+        for (size_t j = 0; j < parametros.size(); j++)
+        {
+            // Pega o gradiente calculado pelo backpropagate
+            double gradiente = gradientes[j];
+
+            // 1. Atualiza o primeiro momento (média dos gradientes)
+            momento_m[j] = beta1 * momento_m[j] + (1.0 - beta1) * gradiente;
+
+            // 2. atualiza o segundo momento (média dos gradientes ao quadrado)
+            momento_v[j] = beta2 * momento_v[j] + (1.0 - beta2) * gradiente * gradiente;
+
+            // 3. Corrige o bias dos momentos
+            double m_hat = momento_m[j] / correcao1;
+            double v_hat = momento_v[j] / correcao2;
+
+            // 4. Calcula a atualização do peso
+            // epsilon é usado para evitar divisão por zero
+            double atualizacao = taxa_aprendizagem * m_hat / (sqrt(v_hat) + epsilon);
+
+            // 5. Aplica a atualização
+            parametros[j] -= atualizacao;
+        }
+    };
+
+    //===============================//
+    //  PASSO 1: Atualizar os pesos  //
+    //===============================//
+    // Para cada camada de pesos L, as linhas (neurônio de origem k) são
+    // divididas entre as threads
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        m_execucao->paralelo_para(m_pesos[L].size(), m_topologia[L + 1],
+            [&](size_t inicio, size_t fim)
+            {
+                for (size_t k = inicio; k < fim; k++)
+                    adam(m_pesos[L][k], m_pesos_m[L][k], m_pesos_v[L][k], m_gradientes_pesos[L][k]);
+            });
+    }
+
+    //================================//
+    //  PASSO 2: Atualizar os biases  //
+    //================================//
+    for (size_t L = 0; L < m_biases.size(); L++)
+        adam(m_biases[L], m_biases_m[L], m_biases_v[L], m_gradientes_biases[L]);
+
+    //=================================================//
+    //  PASSO 3: Atualizar as camadas de imagem        //
+    //=================================================//
+    for (size_t i = 0; i < m_extrator.size(); i++)
+        adam(m_extrator[i]->get_parametros(), m_extrator_m[i], m_extrator_v[i], m_gradientes_extrator[i]);
+
+    //=================================================//
+    //  PASSO 4: Atualizar a normalização em lote      //
+    //=================================================//
+    for (size_t L = 0; L < m_normalizacoes.size(); L++)
+    {
+        if (!m_normalizacoes[L].ligada())
+            continue;
+
+        adam(m_normalizacoes[L].gama, m_gama_m[L], m_gama_v[L], m_gradientes_gama[L]);
+        adam(m_normalizacoes[L].beta, m_beta_m[L], m_beta_v[L], m_gradientes_beta[L]);
+    }
+
+    // A cópia em 16 bits (se houver) acompanha os pesos mestres
+    atualizar_pesos_meia();
+} // otimizar
+
+double Sequencial::calc_loss(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas_esperadas) const
+{
+    return calc_loss(VisaoDados(entradas, saidas_esperadas));
+}
+
+double Sequencial::calc_loss(const VisaoDados &dados) const
+{
+    NN_SPAN("calc_loss");
+
+    double perda_total = 0.0;
+    for (size_t i = 0; i < dados.tamanho(); i++)
+    {
+        const Vetor &saida_ativada = feed_forward(dados.entrada(i));
+        perda_total += m_camada_saida->calcular_loss(saida_ativada, dados.saida(i));
+    }
+
+    perda_total /= dados.tamanho();
+    return perda_total;
+}
+
+namespace
+{
+    size_t argmax(const nn::Vetor& vec)
+    {
+        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
+    }
+}
+
+double Sequencial::calc_accuracy(const std::vector<Vetor> &entradas, const std::vector<Vetor> &saidas_esperadas) const
+{
+    if (entradas.empty() || entradas.size() != saidas_esperadas.size())
+    {
+        return 0.0;
+    }
+
+    return calc_accuracy(VisaoDados(entradas, saidas_esperadas));
+}
+
+double Sequencial::calc_accuracy(const VisaoDados &dados) const
+{
+    NN_SPAN("calc_accuracy");
+
+    if (dados.vazia())
+    {
+        return 0.0;
+    }
+
+    std::atomic<int> acertos{0};
+
+    // Custo de uma amostra: aproximadamente o número de pesos da rede
+    size_t custo_amostra = 0;
+    for (size_t i = 0; i < m_pesos.size(); i++)
+        custo_amostra += m_topologia[i] * m_topologia[i + 1];
+
+    m_execucao->paralelo_para(dados.tamanho(), custo_amostra,
+        [&](size_t inicio, size_t fim)
+        {
+            // Cada bloco usa a sua própria área de trabalho
+            AreaTrabalho area;
+            alocar_area_trabalho(area);
+
+            int acertos_bloco = 0;
+            for (size_t i = inicio; i < fim; ++i)
+            {
+                // Só a classe importa: a ativação de saída (exp do softmax) é pulada
+                const Vetor &logits = feed_forward(dados.entrada(i), area, false);
+
+                if (logits.empty()) continue;
+
+                size_t index_previsto = m_camada_saida->argmax(logits.data(), logits.size());
+                size_t index_real     = argmax(dados.saida(i));
+
+                if (index_previsto == index_real)
+                {
+                    acertos_bloco++;
+                }
+            }
+
+            acertos += acertos_bloco;
+        });
+
+    return static_cast<double>(acertos) / dados.tamanho();
+}
+
+void Sequencial::train(const std::vector<Vetor> &entradas_treino, const std::vector<Vetor> &saidas_treino,
+                       const std::vector<Vetor> &entradas_validacao, const std::vector<Vetor> &saidas_validacao,
+                       double taxa_aprendizagem, size_t janela_analise, double target_loss, double threshold)
+{
+    ConfigTreino config;
+    config.taxa_aprendizagem = taxa_aprendizagem;
+    config.janela_analise = janela_analise;
+    config.target_loss = target_loss;
+    config.threshold = threshold;
+
+    train(entradas_treino, saidas_treino, entradas_validacao, saidas_validacao, config);
+} // train
+
+ResultadoTreino Sequencial::train(const std::vector<Vetor> &entradas_treino, const std::vector<Vetor> &saidas_treino,
+                                  const std::vector<Vetor> &entradas_validacao, const std::vector<Vetor> &saidas_validacao,
+                                  const ConfigTreino &config)
+{
+    return train(VisaoDados(entradas_treino, saidas_treino), VisaoDados(entradas_validacao, saidas_validacao), config);
+} // train
+
+ResultadoTreino Sequencial::train(const VisaoDados &treino, const VisaoDados &validacao, const ConfigTreino &config)
+{
+    auto inicio_treino = std::chrono::steady_clock::now();
+
+    size_t janela_analise = std::max<size_t>(config.janela_analise, 2);
+    double melhor_perda = INFINITY;
+
+    ResultadoTreino resultado;
+
+    preparar_treino();
+
+    if (tem_normalizacao() && m_tamanho_lote < 2)
+        throw std::logic_error("a normalização em lote precisa de lotes de 2 ou mais amostras (ver configurar_pipeline)");
+
+    // Sobras de train_step acumuladas antes não entram no primeiro passo
+    m_lotes_acumulados = 0;
+    m_amostras_acumuladas = 0;
+
+    // No treino distribuído, só o rank 0 imprime, e todos precisam dar o
+    // mesmo número de passos por época
+    bool imprimir = config.verbose && (!m_grupo || m_grupo->get_rank() == 0);
+    bool medir_precisao = config.verbose || config.target_accuracy > 0.0;
+    if (m_grupo)
+    {
+        double n_total = treino.tamanho();
+        m_grupo->allreduce(&n_total, 1);
+
+        if (n_total != (double)treino.tamanho() * m_grupo->get_n_processos())
+            throw std::invalid_argument("todos os processos devem treinar com fatias do mesmo tamanho");
+    }
+
+    std::vector<Matriz> melhores_pesos;
+    std::vector<Vetor>  melhores_biases;
+    std::vector<Vetor>  melhores_extrator;
+    std::vector<NormalizacaoLote> melhores_normalizacoes;
+
+    std::deque<double> historico_loss;
+
+    // Redução no platô: multiplica a taxa da agenda
+    double fator_plateau = 1.0;
+    size_t epocas_sem_melhora = 0;          // desde o melhor loss (parada antecipada)
+    size_t epocas_sem_melhora_plateau = 0;  // desde a última redução da taxa
+
+    size_t tamanho_lote = std::max<size_t>(m_tamanho_lote, 1);
+    size_t passos_por_epoca = (treino.tamanho() + tamanho_lote - 1) / tamanho_lote;
+
+    // Ordem das amostras de treino, embaralhada a cada época. Só os índices
+    // mudam de lugar: as amostras continuam onde estão
+    auto ordem = std::make_shared<std::vector<size_t>>(treino.tamanho());
+    for (size_t i = 0; i < treino.tamanho(); i++)
+        (*ordem)[i] = treino.indice(i);
+
+    VisaoDados amostras(treino.entradas_originais(), treino.saidas_originais(), ordem);
+    std::mt19937_64 gerador(config.semente != 0 ? config.semente : std::random_device{}());
+
+    // Taxa do passo 'passo' da época 'epoca' (começando em 1)
+    auto taxa_do_passo = [&](size_t epoca, size_t passo)
+    {
+        double progresso = (epoca - 1) + (double)passo / std::max<size_t>(passos_por_epoca, 1);
+        double taxa = config.agenda ? config.agenda->taxa(config.taxa_aprendizagem, progresso)
+                                    : config.taxa_aprendizagem;
+        return std::max(taxa * fator_plateau, config.taxa_minima);
+    };
+
+    for (size_t epoca = 1; config.max_epocas == 0 || epoca <= config.max_epocas; epoca ++)
+    {
+        NN_SPAN("epoca", epoca);
+        resultado.epocas = epoca;
+
+        if (config.embaralhar)
+            std::shuffle(ordem->begin(), ordem->end(), gerador);
+
+        if (m_tamanho_lote > 1 || m_lotes_por_passo > 1)
+        {
+            for (size_t i = 0, passo = 0; i < amostras.tamanho(); i += m_tamanho_lote, passo++)
+            {
+                size_t fim = std::min(i + m_tamanho_lote, amostras.tamanho());
+
+                // A cada 'm_lotes_por_passo' lotes (e no fim da época) o otimizador dá um passo
+                bool fechar = (passo + 1) % m_lotes_por_passo == 0 || fim == amostras.tamanho();
+                treinar_lote(amostras, i, fim, fechar);
+
+                if (fechar)
+                    otimizar(taxa_do_passo(epoca, passo));
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < amostras.tamanho(); i++)
+            {
+                feed_forward(amostras.entrada(i), m_area, false); // para gerar os logits
+                backpropagate(amostras.saida(i), m_area);
+
+                if (m_grupo)
+                    receber_gradientes(1.0 / m_grupo->get_n_processos());
+
+                otimizar(taxa_do_passo(epoca, i));
+            }
+        }
+
+        double perda_atual = calc_loss(validacao);
+
+        // Todos os processos decidem a parada com o mesmo loss
+        if (m_grupo)
+        {
+            m_grupo->allreduce(&perda_atual, 1);
+            perda_atual /= m_grupo->get_n_processos();
+        }
+
+        // A precisão só é calculada quando alguém vai usá-la. A condição não
+        // pode depender do rank: todos precisam entrar no allreduce
+        double precisao = 0.0;
+        if (medir_precisao)
+        {
+            precisao = calc_accuracy(validacao);
+            if (m_grupo)
+            {
+                m_grupo->allreduce(&precisao, 1);
+                precisao /= m_grupo->get_n_processos();
+            }
+        }
+        
+        historico_loss.push_front(perda_atual);
+        
+        long double desvio_padrao = 0.0;
+        bool estabilizou = false;
+        if (historico_loss.size() > janela_analise)
+        {
+            historico_loss.pop_back();
+
+            long double media = 0.0;
+            for (double loss : historico_loss)
+            {
+                media += loss;
+            }
+    
+            media /= historico_loss.size();
+    
+            for (double loss : historico_loss)
+            {
+                desvio_padrao += pow((loss - media), 2);
+            }
+    
+            desvio_padrao = sqrt(desvio_padrao / (double)historico_loss.size());
+
+            estabilizou = desvio_padrao <= config.threshold;
+        }
+        
+        if (imprimir)
+        {
+            std::cout << "ÉPOCA: " << epoca <<
+            "\nLOSS: "<< perda_atual << 
+            "\nPRECISÃO: " << precisao * 100.0 << "% (SCE)"<<
+            "\nTAXA: " << taxa_do_passo(epoca, passos_por_epoca) <<
+            "\nDP: " << desvio_padrao << std::endl << std::endl;
+        }
+
+        if (estabilizou)
+        {
+            if (imprimir)
+            {
+                std::cout << ">>> LOSS ESTABILIZADO <<<\n";
+                std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
+            }
+            break;
+        }
+
+        if (perda_atual < melhor_perda - config.melhora_minima)
+        {
+            epocas_sem_melhora = 0;
+            epocas_sem_melhora_plateau = 0;
+        }
+        else
+        {
+            epocas_sem_melhora++;
+            epocas_sem_melhora_plateau++;
+        }
+
+        if (perda_atual < melhor_perda)
+        {
+            melhores_pesos = m_pesos;
+            melhores_biases= m_biases;
+
+            melhores_extrator.resize(m_extrator.size());
+            for (size_t i = 0; i < m_extrator.size(); i++)
+                melhores_extrator[i] = m_extrator[i]->get_parametros();
+            melhores_normalizacoes = m_normalizacoes;
+            melhor_perda = perda_atual;
+            resultado.melhor_epoca = epoca;
+        }
+
+        if (melhor_perda >= 0 && melhor_perda <= config.target_loss)
+        {
+            if (imprimir)
+            {
+                std::cout << ">>> ALVO ATINGIDO <<<\n";
+                std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
+            }
+            break;
+        }
+
+        if (config.target_accuracy > 0.0 && precisao >= config.target_accuracy)
+        {
+            resultado.precisao_atingida = true;
+            if (imprimir)
+            {
+                std::cout << ">>> PRECISÃO ALVO ATINGIDA <<<\n";
+                std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
+            }
+            break;
+        }
+
+        if (config.paciencia > 0 && epocas_sem_melhora >= config.paciencia)
+        {
+            if (imprimir)
+            {
+                std::cout << ">>> SEM MELHORA HÁ " << epocas_sem_melhora << " ÉPOCAS <<<\n";
+                std::cout << "TREINAMENTO FINALIZADO NA ÉPOCA " << epoca << std::endl;
+            }
+            break;
+        }
+
+        if (config.paciencia_plateau > 0 && epocas_sem_melhora_plateau >= config.paciencia_plateau)
+        {
+            fator_plateau *= config.fator_plateau;
+            epocas_sem_melhora_plateau = 0;
+        }
+    }
+    
+
+    if (imprimir)
+    {
+        std::cout << ">>> FIM DO TREINO <<< " << std::endl << std::endl;
+        std::cout << "LOSS FINAL: " << melhor_perda << std::endl;
+    }
+
+    // Se nenhuma época produziu um loss válido (ex.: NaN), mantém os pesos atuais
+    if (!melhores_pesos.empty())
+    {
+        m_pesos = melhores_pesos;
+        m_biases = melhores_biases;
+        for (size_t i = 0; i < m_extrator.size(); i++)
+            m_extrator[i]->get_parametros() = melhores_extrator[i];
+        m_normalizacoes = melhores_normalizacoes;
+        atualizar_pesos_meia();
+    }
+
+    resultado.melhor_perda = melhor_perda;
+    resultado.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio_treino).count();
+
+    return resultado;
+} // train
+
+//
+// SETTERS
+//
+
+void Sequencial::set_pesos(int index_camada, const Matriz &novos_pesos)
+{
+    if (index_camada < m_pesos.size() && novos_pesos.size() == m_pesos[index_camada].size())
+    {
+        for (int i = 0; i < m_pesos[index_camada].size(); ++i)
+        {
+            if (novos_pesos[i].size() != m_pesos[index_camada][i].size())
+            {
+                throw std::runtime_error("O index da camada é inválido");
+            }
+        }
+        m_pesos[index_camada] = novos_pesos;
+        atualizar_pesos_meia();
+    }
+}
+
+void Sequencial::set_biases(int index_camada, const Vetor &novos_biases)
+{
+    if (index_camada < m_biases.size() && novos_biases.size() == m_biases[index_camada].size())
+    {
+        m_biases[index_camada] = novos_biases;
+    }
+    else
+    {
+        throw std::runtime_error("O index da camada é inválido");
     }
 }
 
 void Sequencial::set_func(func ativ_oculta, std::unique_ptr<CamadaSaida> camada_saida)
 {
-    funcao_ativacao_oculta = ativ_oculta;
-    m_camada_saida = std::move(camada_saida);
+    funcao_ativacao_oculta = ativ_oculta;
+    m_ativacoes.assign(m_pesos.size() - 1, funcao_ativacao_oculta);
+    m_camada_saida = std::move(camada_saida);
+
+    planejar_pilha();
+}
+
+void Sequencial::set_ativacao_camada(size_t index_camada, func ativacao)
+{
+    if (index_camada < 1 || index_camada > m_ativacoes.size())
+        throw std::out_of_range("a camada deve ser uma camada oculta");
+
+    m_ativacoes[index_camada - 1] = ativacao;
+    planejar_pilha();
+}
+
+void Sequencial::set_plano_camada(size_t index_camada, const PlanoCamada &plano)
+{
+    if (index_camada >= m_pesos.size())
+        throw std::out_of_range("O index da camada é inválido");
+
+    m_planos_fixos[index_camada] = plano;
+    planejar_pilha();
+}
+
+void Sequencial::set_normalizacao(size_t index_camada, bool ligada, double momento, double epsilon)
+{
+    if (index_camada < 1 || index_camada > m_ativacoes.size())
+        throw std::out_of_range("a camada deve ser uma camada oculta");
+
+    if (ligada && m_grupo)
+        throw std::logic_error("o treino distribuído não suporta normalização em lote");
+
+    const size_t n = m_topologia[index_camada];
+    NormalizacaoLote &normalizacao = m_normalizacoes[index_camada - 1];
+
+    normalizacao = NormalizacaoLote();
+    if (ligada)
+    {
+        normalizacao.gama.assign(n, 1.0);
+        normalizacao.beta.assign(n, 0.0);
+        normalizacao.media.assign(n, 0.0);
+        normalizacao.variancia.assign(n, 1.0);
+        normalizacao.momento = momento;
+        normalizacao.epsilon = epsilon;
+    }
+
+    // x̂ entra nas áreas de trabalho; as do lote são refeitas no próximo treino
+    alocar_area_trabalho(m_area, !m_area.deltas.empty());
+    liberar(m_areas_lote);
+    liberar(m_areas_recomputo);
+    liberar(m_perdas_lote);
+    m_grafo_pipeline.limpar();
+
+    planejar_pilha();
+}
+
+void Sequencial::incorporar_normalizacao()
+{
+    for (size_t L = 0; L < m_normalizacoes.size(); L++)
+    {
+        NormalizacaoLote &normalizacao = m_normalizacoes[L];
+        if (!normalizacao.ligada())
+            continue;
+
+        for (size_t j = 0; j < normalizacao.gama.size(); j++)
+        {
+            const double escala = normalizacao.gama[j] / std::sqrt(normalizacao.variancia[j] + normalizacao.epsilon);
+
+            for (size_t k = 0; k < m_topologia[L]; k++)
+                m_pesos[L][k][j] *= escala;
+            m_biases[L][j] = (m_biases[L][j] - normalizacao.media[j]) * escala + normalizacao.beta[j];
+        }
+
+        normalizacao = NormalizacaoLote();
+    }
+
+    // Os gradientes e momentos de gama e beta não servem mais
+    for (auto *vetores : {&m_gradientes_gama, &m_gradientes_beta, &m_gama_m, &m_gama_v, &m_beta_m, &m_beta_v,
+                          &m_inversos_desvio})
+        liberar(*vetores);
+
+    alocar_area_trabalho(m_area, !m_area.deltas.empty());
+    liberar(m_areas_lote);
+    atualizar_pesos_meia();
+    planejar_pilha();
+}
+
+bool Sequencial::tem_normalizacao() const
+{
+    for (const auto &normalizacao : m_normalizacoes)
+        if (normalizacao.ligada())
+            return true;
+    return false;
+}
+
+void Sequencial::set_contexto_execucao(ContextoExecucao &contexto)
+{
+    m_execucao = &contexto;
+
+    // O melhor número de threads depende do contexto
+    if (m_autoajuste)
+        planejar_pilha();
+}
+
+void Sequencial::set_autoajuste(bool ligado)
+{
+    m_autoajuste = ligado;
+    planejar_pilha();
+}
+
+void Sequencial::planejar_pilha()
+{
+    const size_t n_camadas = m_pesos.size();
+
+    m_planos.assign(n_camadas, PlanoCamada());
+    m_fundir_ativacao.assign(n_camadas, false);
+
+    for (size_t L = 0; L < n_camadas; L++)
+    {
+        auto fixo = m_planos_fixos.find(L);
+        if (fixo != m_planos_fixos.end())
+            m_planos[L] = fixo->second;
+        else if (m_autoajuste)
+            m_planos[L] = autoajuste::plano(m_topologia[L], m_topologia[L + 1], *m_execucao);
+
+        // Só as ocultas com a versão vetorial da ativação: a saída é ativada
+        // junto com o loss (ver ativar_camada)
+        m_fundir_ativacao[L] = L + 1 < n_camadas && m_ativacoes[L].funcao_vetor != nullptr &&
+                               !m_normalizacoes[L].ligada();
+    }
+}
+
+void Sequencial::set_somente_inferencia(bool somente_inferencia)
+{
+    m_somente_inferencia = somente_inferencia;
+
+    if (m_somente_inferencia)
+        liberar_estado_treino();
+}
+
+void Sequencial::set_precisao_pesos(PrecisaoPesos precisao)
+{
+    m_precisao_pesos = precisao;
+    atualizar_pesos_meia();
+}
+
+void Sequencial::atualizar_pesos_meia()
+{
+    if (m_precisao_pesos == PrecisaoPesos::DOUBLE)
+    {
+        m_pesos_meia.clear();
+        m_pesos_meia.shrink_to_fit();
+        return;
+    }
+
+    m_pesos_meia.resize(m_pesos.size());
+
+    for (size_t L = 0; L < m_pesos.size(); L++)
+    {
+        const size_t origem = m_topologia[L];
+        m_pesos_meia[L].resize(origem * m_topologia[L + 1]);
+
+        // Cada neurônio de destino j vira uma linha contínua (a coluna j de
+        // m_pesos[L]). Chamado a cada passo do otimizador: a coluna é lida em
+        // blocos na pilha, sem alocar
+        m_execucao->paralelo_para(m_topologia[L + 1], origem,
+            [&](size_t inicio, size_t fim)
+            {
+                constexpr size_t TAMANHO_BLOCO = 256;
+                double bloco[TAMANHO_BLOCO];
+
+                for (size_t j = inicio; j < fim; j++)
+                {
+                    uint16_t *linha = m_pesos_meia[L].data() + j * origem;
+                    for (size_t k0 = 0; k0 < origem; k0 += TAMANHO_BLOCO)
+                    {
+                        const size_t n = std::min(TAMANHO_BLOCO, origem - k0);
+                        for (size_t k = 0; k < n; k++)
+                            bloco[k] = m_pesos[L][k0 + k][j];
+
+                        converter_para_meia(m_precisao_pesos, bloco, linha + k0, n);
+                    }
+                }
+            });
+    }
+} // atualizar_pesos_meia
+
+//
+// GETTERS
+//
+
+const Matriz &Sequencial::get_pesos(int index_camada) const
+{
+    if (index_camada < 0 || index_camada >= m_topologia.size() - 1)
+    {
+        throw std::runtime_error("O index da camada é inválido");
+    }
+
+    return m_pesos[index_camada];
+}
+
+const Vetor &Sequencial::get_biases(int index_camada) const
+{
+    if (index_camada < 1 || index_camada >= m_topologia.size())
+    {
+        throw std::runtime_error("O index da camada é inválido");
+    }
+
+    return m_biases[index_camada - 1];
+}
+
+const std::vector<size_t> &Sequencial::get_topologia() const
+{
+    return m_topologia;
+}
+
+size_t Sequencial::get_tamanho_entrada() const
+{
+    return m_extrator.empty() ? m_topologia.front() : m_extrator.front()->get_entrada().tamanho();
+}
+
+const std::vector<std::unique_ptr<CamadaImagem>> &Sequencial::get_extrator() const
+{
+    return m_extrator;
+}
+
+ContextoExecucao &Sequencial::get_contexto_execucao() const
+{
+    return *m_execucao;
+}
+
+const std::vector<PlanoCamada> &Sequencial::get_planos() const
+{
+    return m_planos;
 }
 
-//
-// GETTERS
-//
+PrecisaoPesos Sequencial::get_precisao_pesos() const
+{
+    return m_precisao_pesos;
+}
 
-const Matriz &Sequencial::get_pesos(int index_camada) const
+bool Sequencial::get_somente_inferencia() const
 {
-    if (index_camada < 0 || index_camada >= m_topologia.size() - 1)
+    return m_somente_inferencia;
+}
+
+UsoMemoria Sequencial::uso_memoria() const
+{
+    UsoMemoria uso;
+
+    uso.pesos = bytes(m_pesos);
+    uso.biases = bytes(m_biases);
+    uso.pesos_meia = bytes(m_pesos_meia);
+    uso.gradientes = bytes(m_gradientes_pesos) + bytes(m_gradientes_biases) + bytes(m_gradientes_planos);
+    uso.otimizador = bytes(m_pesos_m) + bytes(m_pesos_v) + bytes(m_biases_m) + bytes(m_biases_v);
+
+    // Camadas de imagem: parâmetros (pesos e biases juntos) com os pesos
+    for (const auto &camada : m_extrator)
+        uso.pesos += bytes(camada->get_parametros());
+    uso.gradientes += bytes(m_gradientes_extrator);
+    uso.otimizador += bytes(m_extrator_m) + bytes(m_extrator_v);
+
+    // Normalização em lote: gama, beta e médias móveis com os biases
+    for (const auto &normalizacao : m_normalizacoes)
+        uso.biases += bytes(normalizacao.gama) + bytes(normalizacao.beta) + bytes(normalizacao.media) +
+                      bytes(normalizacao.variancia);
+    uso.gradientes += bytes(m_gradientes_gama) + bytes(m_gradientes_beta);
+    uso.otimizador += bytes(m_gama_m) + bytes(m_gama_v) + bytes(m_beta_m) + bytes(m_beta_v) +
+                      bytes(m_inversos_desvio);
+
+    auto bytes_area = [](const AreaTrabalho &area)
     {
-        throw std::runtime_error("O index da camada é inválido");
-    }
+        return bytes(area.logits) + bytes(area.ativacoes) + bytes(area.deltas) + bytes(area.entrada_float) +
+               bytes(area.normalizados) + bytes(area.imagens) + bytes(area.auxiliares) + bytes(area.deltas_imagens);
+    };
 
-    return m_pesos[index_camada];
+    uso.area_trabalho = bytes_area(m_area);
+    for (const auto &area : m_areas_lote)
+        uso.pipeline += bytes_area(area);
+    for (const auto &area : m_areas_recomputo)
+        uso.pipeline += bytes_area(area);
+    uso.pipeline += bytes(m_perdas_lote);
+
+    return uso;
 }
 
-const Vetor &Sequencial::get_biases(int index_camada) const
+const func &Sequencial::get_func_oculta() const
 {
-    if (index_camada < 1 || index_camada >= m_topologia.size())
-    {
-        throw std::runtime_error("O index da camada é inválido");
-    }
+    return funcao_ativacao_oculta;
+}
 
-    return m_biases[index_camada - 1];
+const NormalizacaoLote &Sequencial::get_normalizacao(size_t index_camada) const
+{
+    if (index_camada < 1 || index_camada > m_ativacoes.size())
+        throw std::out_of_range("a camada deve ser uma camada oculta");
+
+    return m_normalizacoes[index_camada - 1];
 }
 
-const std::vector<size_t> &Sequencial::get_topologia() const
+const func &Sequencial::get_ativacao_camada(size_t index_camada) const
 {
-    return m_topologia;
+    if (index_camada < 1 || index_camada > m_ativacoes.size())
+        throw std::out_of_range("a camada deve ser uma camada oculta");
+
+    return m_ativacoes[index_camada - 1];
+}
+
+const CamadaSaida &Sequencial::get_camada_saida() const
+{
+    return *m_camada_saida;
 }
 
 //
 // MÉTODOS DE PERSISTÊNCIA
 //
 
-bool Sequencial::salvar_rede(const std::string &caminho) const
+namespace
 {
-    std::ofstream file(caminho, std::fstream::out | std::fstream::trunc);
+    /*
+    Conteúdo de um arquivo inteiro na memória: mapeado com mmap quando
+    possível (sem cópia), ou lido de uma vez em um buffer.
+    */
+    class ArquivoMapeado
+    {
+    public:
+        explicit ArquivoMapeado(const std::string &caminho)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            int fd = ::open(caminho.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void *mapa = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapa != MAP_FAILED)
+                {
+                    m_mapa = mapa;
+                    m_dados = static_cast<const char *>(mapa);
+                    m_tamanho = info.st_size;
+                    ::madvise(mapa, m_tamanho, MADV_SEQUENTIAL);
+                }
+            }
+            ::close(fd);
+
+            if (m_mapa)
+            {
+                m_aberto = true;
+                return;
+            }
+#endif
+            // Sem mmap (ou arquivo vazio): lê tudo de uma vez
+            std::ifstream file(caminho, std::ios::binary);
+            if (!file.is_open())
+                return;
+
+            m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            m_dados = m_buffer.data();
+            m_tamanho = m_buffer.size();
+            m_aberto = true;
+        }
+
+        ~ArquivoMapeado()
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            if (m_mapa)
+                ::munmap(m_mapa, m_tamanho);
+#endif
+        }
+
+        ArquivoMapeado(const ArquivoMapeado &) = delete;
+        ArquivoMapeado &operator=(const ArquivoMapeado &) = delete;
+
+        bool aberto() const { return m_aberto; }
+        const char *inicio() const { return m_dados; }
+        const char *fim() const { return m_dados + m_tamanho; }
+
+    private:
+        void *m_mapa = nullptr;
+        std::string m_buffer;
+        const char *m_dados = "";
+        size_t m_tamanho = 0;
+        bool m_aberto = false;
+    };
+
+    // Lê os campos de uma linha do arquivo de modelo, sem alocações nem locale
+    class LeitorLinha
+    {
+    public:
+        LeitorLinha(const char *inicio, const char *fim) : m_p(inicio), m_fim(fim) {}
+
+        // Próxima palavra (vazia no fim da linha)
+        std::string_view palavra()
+        {
+            pular_espacos();
+            const char *inicio = m_p;
+            while (m_p < m_fim && !espaco(*m_p))
+                m_p++;
+            return std::string_view(inicio, m_p - inicio);
+        }
+
+        bool ler(long &valor)
+        {
+            pular_espacos();
+            auto [fim, erro] = std::from_chars(m_p, m_fim, valor);
+            if (erro != std::errc())
+                return false;
+            m_p = fim;
+            return true;
+        }
+
+        bool ler(double &valor)
+        {
+            pular_espacos();
+            if (m_p < m_fim && *m_p == '+')
+                m_p++;
+#if defined(__cpp_lib_to_chars)
+            auto [fim, erro] = std::from_chars(m_p, m_fim, valor);
+            if (erro != std::errc())
+                return false;
+            m_p = fim;
+#else
+            // strtod precisa de uma string terminada em '\0'
+            char numero[64];
+            size_t n = 0;
+            while (m_p + n < m_fim && !espaco(m_p[n]) && n + 1 < sizeof(numero))
+            {
+                numero[n] = m_p[n];
+                n++;
+            }
+            numero[n] = '\0';
+
+            char *fim = nullptr;
+            valor = std::strtod(numero, &fim);
+            if (fim == numero)
+                return false;
+            m_p += fim - numero;
+#endif
+            return true;
+        }
+
+    private:
+        static bool espaco(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        void pular_espacos()
+        {
+            while (m_p < m_fim && espaco(*m_p))
+                m_p++;
+        }
+
+        const char *m_p;
+        const char *m_fim;
+    };
 
-    file << "#######################################" << std::endl;
-    file << "# ARQUIVO DE DESCRIÇÃO DE REDE NEURAL #" << std::endl;
-    file << "# -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- #" << std::endl;
-    file << "#       >>> REDE SEQUENCIAL <<<       #" << std::endl;
-    file << "#######################################" << std::endl;
+    // Ativação pelo nome gravado no arquivo (ReLU se desconhecido)
+    func ativacao_por_nome(std::string_view nome)
+    {
+        if (nome == "tanh")
+            return nn::tanh;
+        if (nome == "sigmoid")
+            return nn::sigmoid;
+        return nn::ReLU; // valor padrão
+    }
+
+    // Fim da linha que começa em 'p' (posição do '\n' ou 'fim')
+    const char *fim_da_linha(const char *p, const char *fim)
+    {
+        const void *nl = std::memchr(p, '\n', fim - p);
+        return nl ? static_cast<const char *>(nl) : fim;
+    }
 
-    file << std::endl;
+    // Acrescenta 'valor' ao texto com o menor número de dígitos que o reproduz exatamente
+    void escrever_numero(std::string &texto, double valor)
+    {
+        char numero[32];
+#if defined(__cpp_lib_to_chars)
+        auto [fim, erro] = std::to_chars(numero, numero + sizeof(numero), valor);
+        texto.append(numero, fim);
+#else
+        int n = std::snprintf(numero, sizeof(numero), "%.17g", valor);
+        texto.append(numero, n);
+#endif
+    }
 
-    file << "##########################" << std::endl;
-    file << "# definição da topologia #" << std::endl;
-    file << "##########################" << std::endl;
+    void escrever_numero(std::string &texto, float valor)
+    {
+        char numero[32];
+#if defined(__cpp_lib_to_chars)
+        auto [fim, erro] = std::to_chars(numero, numero + sizeof(numero), valor);
+        texto.append(numero, fim);
+#else
+        int n = std::snprintf(numero, sizeof(numero), "%.9g", valor);
+        texto.append(numero, n);
+#endif
+    }
 
-    file << std::endl;
+    void escrever_numero(std::string &texto, size_t valor)
+    {
+        char numero[24];
+        auto [fim, erro] = std::to_chars(numero, numero + sizeof(numero), valor);
+        texto.append(numero, fim);
+    }
+}
 
-    file << "#" << std::endl;
-    file << "# CAMADA index número_de_entradas" << std::endl;
-    file << "#" << std::endl;
+bool Sequencial::salvar_rede(const std::string &caminho) const
+{
+    NN_SPAN("salvar_rede");
 
-    file << std::endl;
+    /*
+    O arquivo inteiro é montado em memória e escrito de uma vez. Os números
+    saem com to_chars: sem locale e com todos os dígitos necessários para que
+    carregar_rede recupere exatamente os mesmos pesos.
+    */
+    std::string texto;
+
+    size_t n_pesos = 0;
+    for (size_t i = 0; i + 1 < m_topologia.size(); i++)
+        n_pesos += m_topologia[i] * m_topologia[i + 1];
+    texto.reserve(2048 + n_pesos * 48);
+
+    texto += "#######################################\n";
+    texto += "# ARQUIVO DE DESCRIÇÃO DE REDE NEURAL #\n";
+    texto += "# -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=- #\n";
+    texto += "#       >>> REDE SEQUENCIAL <<<       #\n";
+    texto += "#######################################\n";
+    texto += "\n";
+
+    texto += "##########################\n";
+    texto += "# definição da topologia #\n";
+    texto += "##########################\n";
+    texto += "\n";
+
+    texto += "#\n";
+    texto += "# CAMADA index número_de_entradas\n";
+    texto += "#\n";
+    texto += "\n";
 
     for (size_t i = 0; i < m_topologia.size(); i++)
     {
-        file << "CAMADA " << i << " " << m_topologia[i] << std::endl;
+        texto += "CAMADA ";
+        escrever_numero(texto, i);
+        texto += ' ';
+        escrever_numero(texto, m_topologia[i]);
+        texto += '\n';
     }
 
-    file << std::endl;
+    texto += "\n";
 
-    file << "#" << std::endl;
-    file << "# ATIVACAO_SAIDA SCE / LMSE" << std::endl;
-    file << "#" << std::endl;
-    file << std::endl;
+    texto += "#\n";
+    texto += "# ATIVACAO_SAIDA SCE / LMSE\n";
+    texto += "#\n";
+    texto += "\n";
 
-    file << "ATIVACAO_SAIDA " << m_camada_saida->get_tipo() << std::endl;
-    file << std::endl;
+    texto += "ATIVACAO_SAIDA " + m_camada_saida->get_tipo() + "\n";
+    texto += "\n";
 
-    file << "#" << std::endl;
-    file << "# ATIVACAO_OCULTA ReLU / tanh / sigmoid" << std::endl;
-    file << "#" << std::endl;
-    file << std::endl;
+    texto += "#\n";
+    texto += "# ATIVACAO_OCULTA ReLU / tanh / sigmoid\n";
+    texto += "#\n";
+    texto += "\n";
+
+    texto += "ATIVACAO_OCULTA " + std::string(funcao_ativacao_oculta.nome) + "\n";
+    texto += "\n";
+
+    // Só as camadas com uma ativação diferente da oculta da rede
+    bool ativacoes_proprias = false;
+    for (const func &ativacao : m_ativacoes)
+        ativacoes_proprias |= std::string(ativacao.nome) != funcao_ativacao_oculta.nome;
+
+    if (ativacoes_proprias)
+    {
+        texto += "#\n";
+        texto += "# ATIVACAO_CAMADA index ReLU / tanh / sigmoid\n";
+        texto += "#\n";
+        texto += "\n";
 
-    file << "ATIVACAO_OCULTA" << funcao_ativacao_oculta.nome << std::endl;
-    file << std::endl;
+        for (size_t L = 0; L < m_ativacoes.size(); L++)
+        {
+            if (std::string(m_ativacoes[L].nome) == funcao_ativacao_oculta.nome)
+                continue;
 
-    file << "#######################" << std::endl;
-    file << "# definição de biases #" << std::endl;
-    file << "#######################" << std::endl;
-    file << std::endl;
+            texto += "ATIVACAO_CAMADA ";
+            escrever_numero(texto, L + 1);
+            texto += ' ' + std::string(m_ativacoes[L].nome) + '\n';
+        }
 
-    file << "#" << std::endl;
-    file << "# BIAS camada bias_0 bias_1 ... bias_n-1" << std::endl;
-    file << "#" << std::endl;
-    file << std::endl;
+        texto += "\n";
+    }
 
-    for (size_t i = 0; i <= m_biases.size() - 1; i++)
+    // Só as camadas com normalização em lote (os parâmetros vêm antes dos biases)
+    if (tem_normalizacao())
     {
-        file << "BIAS " << i + 1;
-        for (auto bias : m_biases[i])
+        texto += "#\n";
+        texto += "# NORMALIZACAO index momento epsilon\n";
+        texto += "#\n";
+        texto += "\n";
+
+        for (size_t L = 0; L < m_normalizacoes.size(); L++)
         {
-            file << " " << bias;
+            if (!m_normalizacoes[L].ligada())
+                continue;
+
+            texto += "NORMALIZACAO ";
+            escrever_numero(texto, L + 1);
+            texto += ' ';
+            escrever_numero(texto, m_normalizacoes[L].momento);
+            texto += ' ';
+            escrever_numero(texto, m_normalizacoes[L].epsilon);
+            texto += '\n';
         }
-        file << std::endl;
+
+        texto += "\n";
+    }
+
+    // Só aparece nos modelos em 16 bits: os arquivos em double ficam iguais aos de antes
+    if (m_precisao_pesos != PrecisaoPesos::DOUBLE)
+    {
+        texto += "#\n";
+        texto += "# PRECISAO_PESOS FP16 / BF16\n";
+        texto += "#\n";
+        texto += "\n";
+
+        texto += m_precisao_pesos == PrecisaoPesos::FP16 ? "PRECISAO_PESOS FP16\n" : "PRECISAO_PESOS BF16\n";
+        texto += "\n";
     }
 
-    file << std::endl;
+    // Só aparece nas redes convolucionais: CAMADA 0 é a saída achatada do extrator
+    if (!m_extrator.empty())
+    {
+        texto += "####################################\n";
+        texto += "# definição das camadas de imagem  #\n";
+        texto += "####################################\n";
+        texto += "\n";
+
+        texto += "#\n";
+        texto += "# ENTRADA_IMAGEM canais altura largura\n";
+        texto += "# CONV2D index filtros kernel passo preenchimento ativação\n";
+        texto += "# MAXPOOL2D index tamanho passo\n";
+        texto += "# FLATTEN index\n";
+        texto += "#\n";
+        texto += "\n";
+
+        const Formato3D &entrada = m_extrator.front()->get_entrada();
+        texto += "ENTRADA_IMAGEM ";
+        escrever_numero(texto, entrada.canais);
+        texto += ' ';
+        escrever_numero(texto, entrada.altura);
+        texto += ' ';
+        escrever_numero(texto, entrada.largura);
+        texto += '\n';
+
+        for (size_t i = 0; i < m_extrator.size(); i++)
+        {
+            texto += m_extrator[i]->get_tipo() + ' ';
+            escrever_numero(texto, i);
+
+            std::string descricao = m_extrator[i]->descricao();
+            if (!descricao.empty())
+                texto += ' ' + descricao;
+            texto += '\n';
+        }
+
+        texto += "\n";
+
+        texto += "#\n";
+        texto += "# PARAMETROS_IMAGEM index p_0 p_1 ... (pesos de cada filtro e depois os biases)\n";
+        texto += "#\n";
+        texto += "\n";
 
-    file << "#######################" << std::endl;
-    file << "# criação de ligações #" << std::endl;
-    file << "#######################" << std::endl;
+        for (size_t i = 0; i < m_extrator.size(); i++)
+        {
+            const Vetor &parametros = m_extrator[i]->get_parametros();
+            if (parametros.empty())
+                continue;
 
-    file << std::endl;
+            texto += "PARAMETROS_IMAGEM ";
+            escrever_numero(texto, i);
+            for (double p : parametros)
+            {
+                texto += ' ';
+                escrever_numero(texto, p);
+            }
+            texto += '\n';
+        }
 
-    file << "#" << std::endl;
-    file << "# LIGACAO de_camada de_neuronio para_camada para_neuronio peso" << std::endl;
-    file << "#" << std::endl;
+        texto += "\n";
+    }
 
-    for (size_t i = 0; i < m_topologia.size() - 1; i++)
+    if (tem_normalizacao())
     {
-        file << std::endl;
-        file << "# Da camada " << i << " para a camada " << i + 1 << std::endl
-             << std::endl;
-        for (size_t j = 0; j < m_topologia[i]; j++)
-            for (size_t k = 0; k < m_topologia[i + 1]; k++)
+        texto += "#\n";
+        texto += "# PARAMETROS_NORMALIZACAO index gama_0 ... beta_0 ... media_0 ... variancia_0 ...\n";
+        texto += "#\n";
+        texto += "\n";
+
+        for (size_t L = 0; L < m_normalizacoes.size(); L++)
+        {
+            const NormalizacaoLote &normalizacao = m_normalizacoes[L];
+            if (!normalizacao.ligada())
+                continue;
+
+            texto += "PARAMETROS_NORMALIZACAO ";
+            escrever_numero(texto, L + 1);
+            for (const Vetor *valores : {&normalizacao.gama, &normalizacao.beta, &normalizacao.media,
+                                         &normalizacao.variancia})
             {
-                file << "LIGACAO " << i << " " << j << " " << i + 1 << " " << k << " " << m_pesos[i][j][k] << std::endl;
+                for (double valor : *valores)
+                {
+                    texto += ' ';
+                    escrever_numero(texto, valor);
+                }
             }
+            texto += '\n';
+        }
+
+        texto += "\n";
     }
 
-    file.close();
+    texto += "#######################\n";
+    texto += "# definição de biases #\n";
+    texto += "#######################\n";
+    texto += "\n";
 
-    return true;
-} // salvar_rede
+    texto += "#\n";
+    texto += "# BIAS camada bias_0 bias_1 ... bias_n-1\n";
+    texto += "#\n";
+    texto += "\n";
 
-namespace
-{
-    struct set
+    for (size_t i = 0; i < m_biases.size(); i++)
     {
-        int index;
-        int qtd;
-    };
+        texto += "BIAS ";
+        escrever_numero(texto, i + 1);
+        for (auto bias : m_biases[i])
+        {
+            texto += ' ';
+            escrever_numero(texto, bias);
+        }
+        texto += '\n';
+    }
+
+    texto += "\n";
+
+    texto += "#######################\n";
+    texto += "# criação de ligações #\n";
+    texto += "#######################\n";
+    texto += "\n";
+
+    texto += "#\n";
+    texto += "# LIGACAO de_camada de_neuronio para_camada para_neuronio peso\n";
+    texto += "#\n";
 
-    bool setcomp(set a, set b)
+    // Em 16 bits, os pesos salvos são os já arredondados (como float, com
+    // poucos dígitos); carregar o arquivo reproduz exatamente a mesma rede
+    std::vector<float> pesos_float;
+
+    for (size_t i = 0; i + 1 < m_topologia.size(); i++)
     {
-        return a.index < b.index;
+        if (m_precisao_pesos != PrecisaoPesos::DOUBLE)
+        {
+            pesos_float.resize(m_pesos_meia[i].size());
+            converter_de_meia(m_precisao_pesos, m_pesos_meia[i].data(), pesos_float.data(), pesos_float.size());
+        }
+
+        texto += "\n# Da camada ";
+        escrever_numero(texto, i);
+        texto += " para a camada ";
+        escrever_numero(texto, i + 1);
+        texto += "\n\n";
+
+        for (size_t j = 0; j < m_topologia[i]; j++)
+            for (size_t k = 0; k < m_topologia[i + 1]; k++)
+            {
+                texto += "LIGACAO ";
+                escrever_numero(texto, i);
+                texto += ' ';
+                escrever_numero(texto, j);
+                texto += ' ';
+                escrever_numero(texto, i + 1);
+                texto += ' ';
+                escrever_numero(texto, k);
+                texto += ' ';
+                if (m_precisao_pesos != PrecisaoPesos::DOUBLE)
+                    escrever_numero(texto, pesos_float[k * m_topologia[i] + j]);
+                else
+                    escrever_numero(texto, m_pesos[i][j][k]);
+                texto += '\n';
+            }
     }
-}
+
+    std::ofstream file(caminho, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(texto.data(), texto.size());
+    file.close();
+
+    return static_cast<bool>(file);
+} // salvar_rede
 
 bool Sequencial::carregar_rede(const std::string &caminho, func funcao_ativacao_oculta)
 {
-    this->funcao_ativacao_oculta = funcao_ativacao_oculta;
+    NN_SPAN("carregar_rede");
 
-    std::ifstream file(caminho);
+    // Tudo é lido para variáveis locais e só passa para a rede no fim: um
+    // arquivo inválido deixa a rede exatamente como estava
+    PrecisaoPesos precisao = PrecisaoPesos::DOUBLE;
+    std::unique_ptr<CamadaSaida> camada_saida;
 
-    if (!file.is_open())
+    ArquivoMapeado arquivo(caminho);
+
+    if (!arquivo.aberto())
         return false;
 
-    std::string line;
-    std::string keyword;
+    const char *p = arquivo.inicio();
+    const char *fim = arquivo.fim();
 
-    // --- PASSADA 1: LER A ESTRUTURA E ALOCAR MEMÓRIA ---
-    std::vector<set> temp_top;
+    /*
+    Uma única passada pelo arquivo:
+    1. O cabeçalho (CAMADA, ATIVACAO_SAIDA, ATIVACAO_OCULTA e, nas redes
+       convolucionais, as camadas de imagem) é lido em série até a primeira
+       linha de BIAS, LIGACAO ou PARAMETROS_*. Aí a topologia está
+       completa e a memória é alocada.
+    2. O resto (parâmetros, a maior parte do arquivo) é dividido em
+       pedaços que terminam em fim de linha e lidos em paralelo: cada linha
+       escreve em uma posição diferente dos pesos.
+    3. Se tudo foi válido, a rede troca os seus membros pelos lidos.
+    */
 
-    while (getline(file, line))
+    // --- PARTE 1: CABEÇALHO ---
+    std::vector<std::pair<long, long>> camadas; // (index, neurônios)
+    std::vector<std::pair<long, func>> ativacoes_camadas; // (index, ativação)
+    std::vector<std::tuple<long, double, double>> normalizacoes; // (index, momento, epsilon)
+    std::vector<std::pair<long, std::unique_ptr<CamadaImagem>>> camadas_imagem; // (index, camada)
+    Formato3D formato_imagem;
+
+    while (p < fim)
     {
-        if (line.empty() || line[0] == '#')
-            continue;
+        const char *fim_linha = fim_da_linha(p, fim);
+        LeitorLinha linha(p, fim_linha);
+        std::string_view keyword = linha.palavra();
 
-        std::stringstream ss(line);
-        ss >> keyword;
+        if (keyword == "BIAS" || keyword == "LIGACAO" || keyword == "PARAMETROS_IMAGEM" ||
+            keyword == "PARAMETROS_NORMALIZACAO")
+            break; // 'p' continua no começo desta linha
 
-        if (keyword == "CAMADA")
+        if (keyword.empty() || keyword[0] == '#')
         {
-            int index, neuronios;
-            ss >> index >> neuronios;
+            // linha vazia ou comentário
+        }
+        else if (keyword == "CAMADA")
+        {
+            long index, neuronios;
+            if (!linha.ler(index) || !linha.ler(neuronios) || neuronios <= 0)
+                return false;
 
-            temp_top.push_back({index, neuronios});
+            camadas.push_back({index, neuronios});
         }
         else if (keyword == "ATIVACAO_SAIDA")
         {
-            std::string tipo;
-            ss >> tipo;
+            std::string_view tipo = linha.palavra();
 
             if (tipo == "SCE")
             {
-                m_camada_saida = std::make_unique<SoftmaxCrossEntropy>();
+                camada_saida = std::make_unique<SoftmaxCrossEntropy>();
             }
             else // valor padrão
             {
-                m_camada_saida = std::make_unique<LinearMeanSquareError>();
+                camada_saida = std::make_unique<LinearMeanSquareError>();
             }
         }
-        else if (keyword == "ATIVACAO_OCULTA")
+        else if (keyword.substr(0, 15) == "ATIVACAO_OCULTA")
         {
-            std::string tipo;
-            ss >> tipo;
+            // Arquivos antigos foram salvos sem o espaço (ex.: "ATIVACAO_OCULTAtanh")
+            std::string_view tipo = keyword.substr(15);
+            if (tipo.empty())
+                tipo = linha.palavra();
 
+            funcao_ativacao_oculta = ativacao_por_nome(tipo);
+        }
+        else if (keyword == "ATIVACAO_CAMADA")
+        {
+            long index;
+            if (!linha.ler(index))
+                return false;
 
-            if (tipo == "tanh")
-            {
-                funcao_ativacao_oculta = nn::tanh;
-            }
-            else if (tipo == "sigmoid")
-            {
-                funcao_ativacao_oculta = nn::sigmoid;
-            }
-            else // valor padrão
-            {
-                funcao_ativacao_oculta = nn::ReLU;
-            }
+            ativacoes_camadas.push_back({index, ativacao_por_nome(linha.palavra())});
+        }
+        else if (keyword == "NORMALIZACAO")
+        {
+            long index;
+            double momento, epsilon;
+            if (!linha.ler(index) || !linha.ler(momento) || !linha.ler(epsilon))
+                return false;
+
+            normalizacoes.emplace_back(index, momento, epsilon);
+        }
+        else if (keyword == "PRECISAO_PESOS")
+        {
+            std::string_view tipo = linha.palavra();
+
+            if (tipo == "FP16")
+                precisao = PrecisaoPesos::FP16;
+            else if (tipo == "BF16")
+                precisao = PrecisaoPesos::BF16;
+        }
+        else if (keyword == "ENTRADA_IMAGEM")
+        {
+            long canais, altura, largura;
+            if (!linha.ler(canais) || !linha.ler(altura) || !linha.ler(largura) ||
+                canais <= 0 || altura <= 0 || largura <= 0)
+                return false;
+
+            formato_imagem = {(size_t)canais, (size_t)altura, (size_t)largura};
+        }
+        else if (keyword == "CONV2D")
+        {
+            long index, filtros, kernel, passo, preenchimento;
+            if (!linha.ler(index) || !linha.ler(filtros) || !linha.ler(kernel) || !linha.ler(passo) ||
+                !linha.ler(preenchimento) || filtros <= 0 || kernel <= 0 || passo <= 0 || preenchimento < 0)
+                return false;
+
+            camadas_imagem.push_back({index, std::make_unique<Conv2D>(filtros, kernel, passo, preenchimento,
+                                                                      ativacao_por_nome(linha.palavra()))});
+        }
+        else if (keyword == "MAXPOOL2D")
+        {
+            long index, tamanho, passo;
+            if (!linha.ler(index) || !linha.ler(tamanho) || !linha.ler(passo) || tamanho <= 0 || passo < 0)
+                return false;
+
+            camadas_imagem.push_back({index, std::make_unique<MaxPool2D>(tamanho, passo)});
         }
+        else if (keyword == "FLATTEN")
+        {
+            long index;
+            if (!linha.ler(index))
+                return false;
+
+            camadas_imagem.push_back({index, std::make_unique<Flatten>()});
+        }
+
+        p = fim_linha < fim ? fim_linha + 1 : fim;
     }
 
-    if (temp_top.size() < 2)
+    if (camadas.size() < 2)
         return false;
 
-    sort(temp_top.begin(), temp_top.end(), setcomp);
+    std::sort(camadas.begin(), camadas.end());
 
-    m_topologia.resize(temp_top.size());
-    for (size_t i = 0; i < temp_top.size(); i++)
+    std::vector<size_t> topologia(camadas.size());
+    for (size_t i = 0; i < camadas.size(); i++)
     {
-        m_topologia[i] = temp_top[i].qtd;
+        topologia[i] = camadas[i].second;
     }
 
-    // alocando memória nos vetores
+    // Camadas de imagem: configuradas em ordem, a saída da última é a CAMADA 0
+    std::sort(camadas_imagem.begin(), camadas_imagem.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
 
-    m_pesos.resize(m_topologia.size() - 1);
-    m_biases.resize(m_topologia.size() - 1);
-    m_gradientes_pesos.resize(m_topologia.size() - 1);
-    m_gradientes_biases.resize(m_topologia.size() - 1);
+    std::vector<std::unique_ptr<CamadaImagem>> extrator;
+    Formato3D atual = formato_imagem;
+    for (auto &[index, camada] : camadas_imagem)
+    {
+        try
+        {
+            camada->configurar(atual);
+        }
+        catch (const std::invalid_argument &)
+        {
+            return false;
+        }
 
-    for (int i = 0; i < m_topologia.size() - 1; i++)
+        atual = camada->get_saida();
+        extrator.push_back(std::move(camada));
+    }
+
+    if (!extrator.empty() && atual.tamanho() != topologia[0])
+        return false;
+
+    std::vector<func> ativacoes(topologia.size() - 2, funcao_ativacao_oculta);
+    for (const auto &[index, ativacao] : ativacoes_camadas)
+    {
+        if (index < 1 || index > (long)ativacoes.size())
+            return false;
+        ativacoes[index - 1] = ativacao;
+    }
+
+    // Os parâmetros da normalização são lidos com os biases
+    std::vector<NormalizacaoLote> normalizacoes_camadas(topologia.size() - 1);
+    for (const auto &[index, momento, epsilon] : normalizacoes)
+    {
+        if (index < 1 || index > (long)ativacoes.size())
+            return false;
+
+        NormalizacaoLote &normalizacao = normalizacoes_camadas[index - 1];
+        normalizacao.gama.assign(topologia[index], 1.0);
+        normalizacao.beta.assign(topologia[index], 0.0);
+        normalizacao.media.assign(topologia[index], 0.0);
+        normalizacao.variancia.assign(topologia[index], 1.0);
+        normalizacao.momento = momento;
+        normalizacao.epsilon = epsilon;
+    }
+
+    // alocando memória nos vetores
+    std::vector<Matriz> pesos(topologia.size() - 1);
+    std::vector<Vetor> biases(topologia.size() - 1);
+
+    for (size_t i = 0; i < topologia.size() - 1; i++)
     {
-        m_biases[i].resize(m_topologia[i + 1], 0.0);
-        m_gradientes_biases[i].resize(m_topologia[i + 1], 0.0);
+        biases[i].assign(topologia[i + 1], 0.0);
 
-        m_pesos[i].resize(m_topologia[i]);
-        m_gradientes_pesos[i].resize(m_topologia[i]);
+        pesos[i].resize(topologia[i]);
 
-        for (int j = 0; j < m_topologia[i]; j++)
+        for (size_t j = 0; j < topologia[i]; j++)
         {
-            m_pesos[i][j].resize(m_topologia[i + 1], 0.0);
-            m_gradientes_pesos[i][j].resize(m_topologia[i + 1], 0.0);
+            pesos[i][j].assign(topologia[i + 1], 0.0);
         }
     }
 
-    // --- PASSADA 2: FAZENDO AS LIGAÇÕES, ATRIBUINDO PESOS E BIASES ---
+    // --- PARTE 2: BIASES E LIGAÇÕES, EM PARALELO ---
 
-    file.clear();
-    file.seekg(0, std::ios::beg);
+    // Camadas de imagem cujos parâmetros apareceram (sem eles, ficariam com
+    // os pesos sorteados no configurar)
+    std::vector<std::atomic<bool>> parametros_lidos(extrator.size());
+    for (auto &lido : parametros_lidos)
+        lido = false;
 
-    while (getline(file, line))
+    // Lê as linhas de [inicio, fim_pedaco). Retorna false se alguma for inválida
+    auto ler_pedaco = [&](const char *inicio, const char *fim_pedaco) -> bool
     {
-        if (line.empty() || line[0] == '#')
-            continue;
-
-        std::stringstream ss(line);
+        const long n_camadas = topologia.size();
 
-        ss >> keyword;
-
-        if (keyword == "BIAS")
+        while (inicio < fim_pedaco)
         {
-            int camada;
-            ss >> camada;
+            const char *fim_linha = fim_da_linha(inicio, fim_pedaco);
+            LeitorLinha linha(inicio, fim_linha);
+            std::string_view keyword = linha.palavra();
 
-            if (camada < 1 || camada >= m_topologia.size())
-                return false;
+            if (keyword == "LIGACAO")
+            {
+                long de_camada, de_neuronio, para_camada, para_neuronio;
+                double peso;
+
+                if (!linha.ler(de_camada) || !linha.ler(de_neuronio) || !linha.ler(para_camada) ||
+                    !linha.ler(para_neuronio) || !linha.ler(peso))
+                    return false;
 
-            double bias;
+                if (de_camada < 0 || de_camada >= n_camadas - 1 || de_camada + 1 != para_camada ||
+                    de_neuronio < 0 || de_neuronio >= (long)topologia[de_camada] ||
+                    para_neuronio < 0 || para_neuronio >= (long)topologia[para_camada])
+                {
+                    return false;
+                }
 
-            for (int i = 0; i < m_topologia[camada]; i++)
+                pesos[de_camada][de_neuronio][para_neuronio] = peso;
+            }
+            else if (keyword == "BIAS")
+            {
+                long camada;
+                if (!linha.ler(camada) || camada < 1 || camada >= n_camadas)
+                    return false;
+
+                for (size_t i = 0; i < topologia[camada]; i++)
+                {
+                    if (!linha.ler(biases[camada - 1][i]))
+                        return false;
+                }
+            }
+            else if (keyword == "PARAMETROS_IMAGEM")
+            {
+                long index;
+                if (!linha.ler(index) || index < 0 || index >= (long)extrator.size())
+                    return false;
+
+                for (double &parametro : extrator[index]->get_parametros())
+                {
+                    if (!linha.ler(parametro))
+                        return false;
+                }
+                parametros_lidos[index] = true;
+            }
+            else if (keyword == "PARAMETROS_NORMALIZACAO")
+            {
+                long camada;
+                if (!linha.ler(camada) || camada < 1 || camada >= n_camadas - 1 ||
+                    !normalizacoes_camadas[camada - 1].ligada())
+                    return false;
+
+                NormalizacaoLote &normalizacao = normalizacoes_camadas[camada - 1];
+                for (Vetor *valores : {&normalizacao.gama, &normalizacao.beta, &normalizacao.media,
+                                       &normalizacao.variancia})
+                {
+                    for (double &valor : *valores)
+                    {
+                        if (!linha.ler(valor))
+                            return false;
+                    }
+                }
+            }
+            else if (!keyword.empty() && keyword[0] != '#')
             {
-                ss >> bias;
-                m_biases[camada - 1][i] = bias;
+                // A topologia já foi fechada: CAMADA/ATIVACAO_*/PRECISAO_PESOS depois das
+                // ligações (ou palavras desconhecidas) não são aceitas aqui
+                return false;
             }
+
+            inicio = fim_linha < fim_pedaco ? fim_linha + 1 : fim_pedaco;
         }
-        else if (keyword == "LIGACAO")
-        {
-            int de_camada, de_neuronio, para_camada, para_neuronio;
-            double peso;
 
-            ss >> de_camada >> de_neuronio >> para_camada >> para_neuronio >> peso;
+        return true;
+    };
+
+    // Pedaços de ~64KiB, cortados no fim de uma linha
+    const size_t tamanho_pedaco = 1 << 16;
+    std::vector<const char *> cortes{p};
+    while (cortes.back() < fim)
+    {
+        const char *corte = cortes.back() + std::min<size_t>(tamanho_pedaco, fim - cortes.back());
+        corte = corte < fim ? fim_da_linha(corte, fim) : fim;
+        cortes.push_back(corte < fim ? corte + 1 : fim);
+    }
 
-            if (de_camada >= m_topologia.size() - 1 || de_camada + 1 != para_camada ||
-                de_neuronio >= m_topologia[de_camada] || para_neuronio >= m_topologia[para_camada])
+    std::atomic<bool> valido{true};
+    m_execucao->paralelo_para(cortes.size() - 1, tamanho_pedaco,
+        [&](size_t inicio, size_t fim_bloco)
+        {
+            for (size_t i = inicio; i < fim_bloco && valido.load(std::memory_order_relaxed); i++)
             {
-                return false;
+                if (!ler_pedaco(cortes[i], cortes[i + 1]))
+                    valido = false;
             }
+        });
 
-            m_pesos[de_camada][de_neuronio][para_neuronio] = peso;
-        }
+    if (!valido)
+        return false;
+
+    for (size_t i = 0; i < extrator.size(); i++)
+    {
+        if (!extrator[i]->get_parametros().empty() && !parametros_lidos[i])
+            return false;
     }
 
-    file.close();
+    // --- PARTE 3: A REDE PASSA A SER A LIDA ---
+
+    // (o estado do treino da rede anterior não vale mais: é refeito no
+    // próximo treino, com o Adam do zero)
+    liberar_estado_treino();
+
+    m_topologia = std::move(topologia);
+    m_pesos = std::move(pesos);
+    m_biases = std::move(biases);
+    m_extrator = std::move(extrator);
+    this->funcao_ativacao_oculta = funcao_ativacao_oculta;
+    m_ativacoes = std::move(ativacoes);
+    m_normalizacoes = std::move(normalizacoes_camadas);
+
+    // Sem ATIVACAO_SAIDA, a rede mantém a camada de saída que já tinha
+    if (camada_saida)
+        m_camada_saida = std::move(camada_saida);
+    else if (!m_camada_saida)
+        m_camada_saida = std::make_unique<LinearMeanSquareError>();
+
+    m_precisao_pesos = precisao;
+    atualizar_pesos_meia();
+
+    alocar_area_trabalho(m_area);
+
+    // A topologia pode ter mudado
+    m_planos_fixos.clear();
+    planejar_pilha();
 
     return true;
 } // carregar_rede
 
+
 //
 // OPERADORES
 //
@@ -873,10 +3024,36 @@ Sequencial &Sequencial::operator=(const Sequencial &other)
     this->m_pesos = other.m_pesos;
     this->m_biases = other.m_biases;
     this->funcao_ativacao_oculta = other.funcao_ativacao_oculta;
+    this->m_ativacoes = other.m_ativacoes;
+    this->m_execucao = other.m_execucao;
+    this->m_planos = other.m_planos;
+    this->m_fundir_ativacao = other.m_fundir_ativacao;
+    this->m_planos_fixos = other.m_planos_fixos;
+    this->m_autoajuste = other.m_autoajuste;
+
+    this->m_normalizacoes = other.m_normalizacoes;
+    this->m_gradientes_gama = other.m_gradientes_gama;
+    this->m_gradientes_beta = other.m_gradientes_beta;
+    this->m_gama_m = other.m_gama_m;
+    this->m_gama_v = other.m_gama_v;
+    this->m_beta_m = other.m_beta_m;
+    this->m_beta_v = other.m_beta_v;
+    this->m_inversos_desvio = other.m_inversos_desvio;
+
+    this->m_extrator.clear();
+    for (const auto &camada : other.m_extrator)
+        this->m_extrator.push_back(camada->clone());
+    this->m_gradientes_extrator = other.m_gradientes_extrator;
+    this->m_extrator_m = other.m_extrator_m;
+    this->m_extrator_v = other.m_extrator_v;
 
     this->m_gradientes_pesos = other.m_gradientes_pesos;
     this->m_gradientes_biases = other.m_gradientes_biases;
 
+    this->m_somente_inferencia = other.m_somente_inferencia;
+    this->m_precisao_pesos = other.m_precisao_pesos;
+    this->m_pesos_meia = other.m_pesos_meia;
+
     // Membros do otimizador Adam
     this->m_pesos_m = other.m_pesos_m;
     this->m_pesos_v = other.m_pesos_v;
@@ -894,9 +3071,15 @@ Sequencial &Sequencial::operator=(const Sequencial &other)
         m_camada_saida.reset();
     }
 
-    // As variáveis de chache são temporárias, portanto não precisam ser copiadas
-    this->m_logits.clear();
-    this->m_ativacoes.clear();
+    // As variáveis de cache são temporárias, portanto não precisam ser copiadas,
+    // apenas redimensionadas para a nova topologia
+    alocar_area_trabalho(this->m_area);
+
+    // O grafo do pipeline guarda ponteiros para 'other', então é refeito
+    // (as acumulações em andamento não são copiadas)
+    configurar_pipeline(other.m_tamanho_lote, other.m_n_micro_lotes, other.m_escalonador);
+    configurar_acumulacao(other.m_lotes_por_passo);
+    configurar_checkpoint(other.m_intervalo_checkpoint);
 
     return *this;
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
@@ -9,14 +15,108 @@
 #include <ftxui/component/event.hpp>
 
 #include "rede_neural.h"
+#include "incremental.h"
 
 const char* model_path = "data/models/number_rec_model.txt";
 using matriz = std::vector<std::vector<u_char>>;
+using relogio = std::chrono::steady_clock;
 using namespace ftxui;
 
-void insertCircle (matriz&, int, int, double);
-void deleteCircle (matriz&, int, int, double);
-nn::Vetor padronizar (const matriz&);
+// Retângulo [x0, x1) x [y0, y1) da tela
+struct Retangulo
+{
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+  bool vazio() const { return x0 >= x1 || y0 >= y1; }
+
+  void unir(const Retangulo& r)
+  {
+    if (r.vazio()) return;
+    if (vazio()) { *this = r; return; }
+
+    x0 = std::min(x0, r.x0);
+    y0 = std::min(y0, r.y0);
+    x1 = std::max(x1, r.x1);
+    y1 = std::max(y1, r.y1);
+  }
+};
+
+/*
+Área de desenho. Além dos pixels, guarda a entrada 28x28 da rede já
+reduzida: cada pixel que muda atualiza só a contagem da célula que o
+contém, então a entrada fica sempre em dia sem refazer a média da tela
+inteira. O que mudou desde o último quadro fica em 'sujo', para que o
+canvas seja redesenhado só ali.
+*/
+struct Desenho
+{
+  static const int TARGET_DIM = 28;
+
+  matriz pixels;
+  nn::Vetor entrada;
+
+  // Célula de destino de cada linha/coluna da tela (-1 = fora de todas)
+  std::vector<int> celula_y, celula_x;
+  // Pixels pintados e pixels totais de cada célula
+  std::vector<int> pintados, tamanho_celula;
+
+  Retangulo sujo;
+
+  Desenho(int largura, int altura);
+};
+
+/*
+Inferência numa thread separada, para que o tratamento de eventos nunca
+espere pela rede.
+
+A caixa de entrada tem um único lugar: 'enviar' substitui o desenho que
+ainda não foi processado (só o mais recente importa), então a thread nunca
+acumula atraso atrás do mouse. Cada resultado é entregue a 'entregar' na
+própria thread de inferência; o pAInt o repassa à thread da interface com
+screen.Post.
+
+Entre um desenho e o seguinte só mudam as células sob o pincel, então a
+rede é calculada incrementalmente (ver nn::InferenciaIncremental).
+*/
+class InferenciaAssincrona
+{
+public:
+  struct Resultado
+  {
+    nn::Vetor previsoes;
+    unsigned long geracao;        // a do desenho que gerou o resultado
+    relogio::time_point enviado;  // quando o desenho foi enviado
+  };
+
+  InferenciaAssincrona(nn::Sequencial& rede, std::function<void(Resultado)> entregar);
+  ~InferenciaAssincrona();
+
+  void enviar(const nn::Vetor& entrada, unsigned long geracao);
+
+  // Desenhos substituídos antes de serem processados
+  unsigned long descartados() const;
+
+private:
+  void executar();
+
+  nn::InferenciaIncremental m_rede;
+  std::function<void(Resultado)> m_entregar;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  nn::Vetor m_pendente;
+  unsigned long m_geracao = 0;
+  relogio::time_point m_enviado;
+  bool m_tem_pendente = false;
+  bool m_fechar = false;
+  unsigned long m_descartados = 0;
+
+  std::thread m_thread;
+};
+
+Retangulo insertCircle (Desenho&, int, int, double);
+Retangulo deleteCircle (Desenho&, int, int, double);
+void limpar (Desenho&);
 
 int main()
 {
@@ -26,41 +126,82 @@ int main()
 
   double raio_pincel = 6;
 
-  matriz tela_pixels(
-    ALTURA,
-    std::vector<u_char>(LARGURA, 0)
-  );
+  Desenho desenho(LARGURA, ALTURA);
+
+  // O canvas fica entre os quadros: a cada quadro só é redesenhado o
+  // retângulo sujo (traços novos e o contorno anterior do pincel)
+  Canvas tela_canvas(LARGURA, ALTURA);
+  Retangulo contorno_pincel;
 
   int mouse_x = 0;
   int mouse_y = 0;
 
   bool desenhando = false;
   bool apagando   = false;
-  bool preveu = true;
 
   auto screen = ScreenInteractive::FitComponent();
 
+  // Inferência de uma amostra por vez: acordar threads só atrapalharia
+  nn::contexto_padrao().set_modo(nn::ModoExecucao::LATENCIA);
+
   auto rede = nn::Sequencial(model_path);
+  rede.incorporar_normalizacao(); // só inferência: a normalização vira parte dos pesos
+  rede.set_autoajuste(true);
   nn::Vetor previsoes(10, 0.0);
-  nn::Vetor entrada(28*28, 0.0);
+
+  // Incrementada ao limpar a tela: resultados de desenhos anteriores a
+  // ela são ignorados quando chegam
+  unsigned long geracao = 0;
+
+  // HUD: intervalo entre quadros e tempo do evento do mouse até a previsão
+  // (médias móveis, em ms)
+  double tempo_quadro = 0.0;
+  double tempo_previsao = 0.0;
+  auto ultimo_quadro = relogio::now();
+
+  auto media_movel = [](double &media, double valor) {
+    media = media == 0.0 ? valor : 0.9 * media + 0.1 * valor;
+  };
+
+  auto ms_desde = [](relogio::time_point inicio) {
+    return std::chrono::duration<double, std::milli>(relogio::now() - inicio).count();
+  };
+
+  // Daqui em diante a rede só é usada pela thread de inferência. Os
+  // resultados voltam pela fila de tarefas da tela, então 'previsoes' e o
+  // HUD só são tocados pela thread da interface
+  InferenciaAssincrona inferencia(rede, [&](InferenciaAssincrona::Resultado resultado) {
+    screen.Post([&, resultado = std::move(resultado)] {
+      if (resultado.geracao != geracao)
+        return;
+
+      previsoes = resultado.previsoes;
+      media_movel(tempo_previsao, ms_desde(resultado.enviado));
+    });
+    screen.PostEvent(Event::Custom); // redesenha com o novo resultado
+  });
 
   // O Renderer é a funcao que desenha tudo na tela a cada frame
   auto renderer_pintura = Renderer([&]{
-    auto c = Canvas(LARGURA, ALTURA);
+    media_movel(tempo_quadro, ms_desde(ultimo_quadro));
+    ultimo_quadro = relogio::now();
 
-    // pincel
-    c.DrawPointCircle(mouse_x, mouse_y, raio_pincel);
+    Retangulo sujo = desenho.sujo;
+    sujo.unir(contorno_pincel);
 
-    for (int y = 0; y < ALTURA; ++y)
-    for (int x = 0; x < LARGURA; ++x)
+    for (int y = std::max(sujo.y0, 0); y < std::min(sujo.y1, ALTURA); ++y)
+    for (int x = std::max(sujo.x0, 0); x < std::min(sujo.x1, LARGURA); ++x)
     {
-      if (tela_pixels[y][x] == 1)
-      {
-        c.DrawPoint(x, y, true);
-      }
+      tela_canvas.DrawPoint(x, y, desenho.pixels[y][x] == 1);
     }
-    
-    return window (text(" pAInt 2000 "), canvas(std::move(c)) | flex) ;
+    desenho.sujo = Retangulo();
+
+    // pincel (apagado no próximo quadro, quando a área dele é redesenhada)
+    int raio = static_cast<int>(raio_pincel);
+    tela_canvas.DrawPointCircle(mouse_x, mouse_y, raio);
+    contorno_pincel = {mouse_x - raio, mouse_y - raio, mouse_x + raio + 1, mouse_y + raio + 1};
+
+    return window (text(" pAInt 2000 "), canvas(&tela_canvas) | flex) ;
   });
 
   auto painel_direito = Renderer([&]{
@@ -77,6 +218,10 @@ int main()
       );
     }
 
+    char hud[96];
+    std::snprintf(hud, sizeof(hud), "quadro: %.1f ms | previsão: %.3f ms | descartadas: %lu",
+                  tempo_quadro, tempo_previsao, inferencia.descartados());
+
     auto instrucoes = vbox({
       text("Botão Direito do Mouse: Apagar"),
       text("Botão Esquerdo do Mouse: Desenhar"),
@@ -87,6 +232,7 @@ int main()
     return window(text(" previsão "), vbox({
       vbox(barras_previsao),
       filler(),
+      text(hud) | dim,
       separator(),
       instrucoes,
     }) | size(WIDTH, GREATER_THAN, 40));
@@ -96,9 +242,9 @@ int main()
     renderer_pintura,
     painel_direito
   });
-  
+
   auto listener = CatchEvent(layout_final, [&](Event e) {
-    if (e.is_mouse()) 
+    if (e.is_mouse())
     {
       mouse_x = (e.mouse().x - 1) * 2;
       mouse_y = (e.mouse().y - 1) * 4;
@@ -118,29 +264,30 @@ int main()
       if (e.mouse().button == Mouse::WheelUp && raio_pincel <= 20) raio_pincel += 0.5;
       if (e.mouse().button == Mouse::WheelDown && raio_pincel > 0) raio_pincel -= 0.5;
 
+      Retangulo mudou;
+
       if (desenhando)
       {
-        preveu = false;
-        insertCircle (tela_pixels, mouse_x, mouse_y, raio_pincel);
+        mudou.unir(insertCircle (desenho, mouse_x, mouse_y, raio_pincel));
       }
 
       if (apagando)
       {
-        preveu = false;
-        deleteCircle (tela_pixels, mouse_x, mouse_y, raio_pincel);
+        mudou.unir(deleteCircle (desenho, mouse_x, mouse_y, raio_pincel));
       }
-    }
 
-    if (!desenhando && !apagando && !preveu)
-    {
-      entrada = padronizar(tela_pixels);
-      previsoes = rede.feed_forward(entrada);
-      preveu = true;
+      // A entrada já foi atualizada pelo pincel: prevê a cada traço, não só
+      // ao soltar o botão
+      if (!mudou.vazio())
+      {
+        desenho.sujo.unir(mudou);
+        inferencia.enviar(desenho.entrada, geracao);
+      }
     }
-    
+
     if (e.is_character())
     {
-      if (e.character() == "q") 
+      if (e.character() == "q")
       {
         screen.Exit();
         return true;
@@ -148,14 +295,12 @@ int main()
 
       if (e.character() == "c")
       {
-        for (size_t y = 0; y < tela_pixels.size(); ++y)
-        for (size_t x = 0; x < tela_pixels[y].size(); ++x)
-          tela_pixels[y][x] = 0;
+        limpar(desenho);
+        geracao++;
 
         for (auto& p : previsoes)
           p = 0.0;
-        
-        preveu = true;
+
         return true;
       }
     }
@@ -168,79 +313,148 @@ int main()
   return 0;
 }
 
-void insertCircle (matriz& tela, int a, int b, double raio)
+InferenciaAssincrona::InferenciaAssincrona(nn::Sequencial& rede, std::function<void(Resultado)> entregar)
+  : m_rede(rede), m_entregar(std::move(entregar))
+{
+  m_thread = std::thread(&InferenciaAssincrona::executar, this);
+}
+
+InferenciaAssincrona::~InferenciaAssincrona()
 {
-  for (size_t y = 0; y < tela.size(); ++y)
-  for (size_t x = 0; x < tela[y].size(); ++x)
   {
-    // Verifica se o ponto (x, y) esta dentro do circulo
-    if ((x - a) * (x - a) + (y - b) * (y - b) <= raio * raio)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fechar = true;
+  }
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void InferenciaAssincrona::enviar(const nn::Vetor& entrada, unsigned long geracao)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_tem_pendente)
+      m_descartados++;
+
+    m_pendente = entrada; // mesmo tamanho: reaproveita a memória
+    m_geracao = geracao;
+    m_enviado = relogio::now();
+    m_tem_pendente = true;
+  }
+  m_cv.notify_one();
+}
+
+unsigned long InferenciaAssincrona::descartados() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_descartados;
+}
+
+void InferenciaAssincrona::executar()
+{
+  nn::Vetor entrada;
+
+  while (true)
+  {
+    Resultado resultado;
     {
-      tela[y][x] = 1;
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [&] { return m_tem_pendente || m_fechar; });
+      if (m_fechar)
+        return;
+
+      std::swap(entrada, m_pendente);
+      resultado.geracao = m_geracao;
+      resultado.enviado = m_enviado;
+      m_tem_pendente = false;
     }
+
+    // Fora do lock: a interface pode enviar outro desenho enquanto este roda
+    resultado.previsoes = m_rede.atualizar(entrada);
+    m_entregar(std::move(resultado));
   }
 }
 
-void deleteCircle (matriz& tela, int a, int b, double raio)
+Desenho::Desenho(int largura, int altura)
+  : pixels(altura, std::vector<u_char>(largura, 0)),
+    entrada(TARGET_DIM * TARGET_DIM, 0.0),
+    celula_y(altura, -1),
+    celula_x(largura, -1),
+    pintados(TARGET_DIM * TARGET_DIM, 0),
+    tamanho_celula(TARGET_DIM * TARGET_DIM, 0)
 {
-  for (size_t y = 0; y < tela.size(); ++y)
-  for (size_t x = 0; x < tela[y].size(); ++x)
+  // Média de blocos da tela: a célula t cobre os pixels [t * ratio, (t + 1) * ratio)
+  const double ratio_y = static_cast<double>(altura) / TARGET_DIM;
+  const double ratio_x = static_cast<double>(largura) / TARGET_DIM;
+
+  for (int t = 0; t < TARGET_DIM; ++t)
+  {
+    for (int y = static_cast<int>(t * ratio_y); y < static_cast<int>((t + 1) * ratio_y) && y < altura; ++y)
+      celula_y[y] = t;
+
+    for (int x = static_cast<int>(t * ratio_x); x < static_cast<int>((t + 1) * ratio_x) && x < largura; ++x)
+      celula_x[x] = t;
+  }
+
+  for (int y = 0; y < altura; ++y)
+  for (int x = 0; x < largura; ++x)
+  {
+    if (celula_y[y] >= 0 && celula_x[x] >= 0)
+      tamanho_celula[celula_y[y] * TARGET_DIM + celula_x[x]]++;
+  }
+}
+
+// Pinta o círculo com 'valor' percorrendo só o retângulo que o contém.
+// Retorna o retângulo dos pixels que mudaram (vazio se nenhum mudou)
+Retangulo pintarCirculo (Desenho& desenho, int a, int b, double raio, u_char valor)
+{
+  const int altura = desenho.pixels.size();
+  const int largura = altura ? desenho.pixels[0].size() : 0;
+  const int r = static_cast<int>(raio);
+
+  Retangulo mudou;
+
+  for (int y = std::max(b - r, 0); y <= std::min(b + r, altura - 1); ++y)
+  for (int x = std::max(a - r, 0); x <= std::min(a + r, largura - 1); ++x)
   {
     // Verifica se o ponto (x, y) esta dentro do circulo
-    if ((x - a) * (x - a) + (y - b) * (y - b) <= raio * raio)
-    {
-      tela[y][x] = 0;
-    }
+    if ((x - a) * (x - a) + (y - b) * (y - b) > raio * raio || desenho.pixels[y][x] == valor)
+      continue;
+
+    desenho.pixels[y][x] = valor;
+    mudou.unir({x, y, x + 1, y + 1});
+
+    // Atualiza só a célula da entrada que contém o pixel
+    if (desenho.celula_y[y] < 0 || desenho.celula_x[x] < 0)
+      continue;
+
+    int celula = desenho.celula_y[y] * Desenho::TARGET_DIM + desenho.celula_x[x];
+    desenho.pintados[celula] += valor ? 1 : -1;
+    desenho.entrada[celula] = static_cast<double>(desenho.pintados[celula]) / desenho.tamanho_celula[celula];
   }
+
+  return mudou;
+}
+
+Retangulo insertCircle (Desenho& desenho, int a, int b, double raio)
+{
+  return pintarCirculo(desenho, a, b, raio, 1);
 }
 
-nn::Vetor padronizar(const matriz& tela)
+Retangulo deleteCircle (Desenho& desenho, int a, int b, double raio)
 {
-    const int TARGET_DIM = 28;
-    nn::Vetor saida(TARGET_DIM * TARGET_DIM, 0.0); // Vetor já com o tamanho final
+  return pintarCirculo(desenho, a, b, raio, 0);
+}
 
-    const double source_height = tela.size();
-    // Garante que não haverá erro se a tela estiver vazia
-    const double source_width = tela.empty() ? 0 : tela[0].size();
+void limpar (Desenho& desenho)
+{
+  for (auto& linha : desenho.pixels)
+    std::fill(linha.begin(), linha.end(), 0);
 
-    if (source_width == 0 || source_height == 0) {
-        return saida; // Retorna o vetor zerado se a tela não tiver dimensões
-    }
-    
-    // Calcula a proporção entre a imagem original e a imagem de destino
-    const double ratio_y = source_height / TARGET_DIM;
-    const double ratio_x = source_width / TARGET_DIM;
-
-    // Itera sobre a grade de destino de 28x28
-    for (int target_y = 0; target_y < TARGET_DIM; ++target_y) {
-        for (int target_x = 0; target_x < TARGET_DIM; ++target_x) {
-            
-            // Calcula qual "bloco" na imagem original corresponde a este pixel de destino
-            int source_y_start = static_cast<int>(target_y * ratio_y);
-            int source_x_start = static_cast<int>(target_x * ratio_x);
-            int source_y_end = static_cast<int>((target_y + 1) * ratio_y);
-            int source_x_end = static_cast<int>((target_x + 1) * ratio_x);
-
-            double soma = 0.0;
-            int num_pixels_no_bloco = 0;
-
-            // Itera sobre o bloco correspondente na imagem original
-            for (int y = source_y_start; y < source_y_end; ++y) {
-                for (int x = source_x_start; x < source_x_end; ++x) {
-                    // Verificação de segurança para não acessar fora dos limites
-                    if (y < source_height && x < source_width) {
-                        soma += tela[y][x];
-                        num_pixels_no_bloco++;
-                    }
-                }
-            }
-            
-            // Calcula a média e a atribui à posição correta no vetor de saída
-            if (num_pixels_no_bloco > 0) {
-                saida[target_y * TARGET_DIM + target_x] = soma / num_pixels_no_bloco;
-            }
-        }
-    }
+  std::fill(desenho.pintados.begin(), desenho.pintados.end(), 0);
+  std::fill(desenho.entrada.begin(), desenho.entrada.end(), 0.0);
 
-    return saida;
-}
\ No newline at end of file
+  int altura = desenho.pixels.size();
+  int largura = altura ? desenho.pixels[0].size() : 0;
+  desenho.sujo = {0, 0, largura, altura};
+}
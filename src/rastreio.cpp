@@ -0,0 +1,171 @@
+#include "rastreio.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace nn;
+
+namespace
+{
+    struct Evento
+    {
+        const char *nome;
+        int64_t argumento;
+        uint64_t inicio, fim;
+    };
+
+    /*
+    Buffer circular de uma thread. Só a dona escreve nele: cada evento é
+    gravado na posição 'escritos' (módulo a capacidade) e só então
+    'escritos' avança, com release. Quem lê usa acquire em 'escritos' e
+    vê todos os eventos anteriores completos.
+    */
+    struct BufferThread
+    {
+        static constexpr size_t CAPACIDADE = size_t(1) << 16; // potência de 2
+
+        std::unique_ptr<Evento[]> eventos{new Evento[CAPACIDADE]};
+        std::atomic<uint64_t> escritos{0};
+        uint64_t descartados = 0; // eventos anteriores a 'limpar'
+
+        uint32_t id;
+        std::string nome; // protegido pela trava do registro
+    };
+
+    // Buffers de todas as threads que já gravaram algo (inclusive as que já
+    // terminaram: os eventos delas continuam no rastreio)
+    struct Registro
+    {
+        std::mutex trava;
+        std::vector<std::shared_ptr<BufferThread>> buffers;
+        std::chrono::steady_clock::time_point inicio = std::chrono::steady_clock::now();
+
+        ~Registro()
+        {
+            if (const char *arquivo = std::getenv("NN_RASTREIO_ARQUIVO"))
+                rastreio::salvar(arquivo);
+        }
+    };
+
+    Registro &registro()
+    {
+        static Registro r;
+        return r;
+    }
+
+    BufferThread &buffer_local()
+    {
+        thread_local std::shared_ptr<BufferThread> buffer = []
+        {
+            auto novo = std::make_shared<BufferThread>();
+
+            Registro &r = registro();
+            std::lock_guard<std::mutex> lock(r.trava);
+            novo->id = static_cast<uint32_t>(r.buffers.size() + 1);
+            novo->nome = "thread " + std::to_string(novo->id);
+            r.buffers.push_back(novo);
+            return novo;
+        }();
+
+        return *buffer;
+    }
+
+    // Nomes são literais do código, mas as threads podem ter qualquer nome
+    void escrever_texto(FILE *arquivo, const std::string &texto)
+    {
+        std::fputc('"', arquivo);
+        for (char c : texto)
+        {
+            if (c == '"' || c == '\\')
+                std::fputc('\\', arquivo);
+
+            if (static_cast<unsigned char>(c) >= 0x20)
+                std::fputc(c, arquivo);
+        }
+        std::fputc('"', arquivo);
+    }
+}
+
+uint64_t rastreio::agora_ns()
+{
+    auto decorrido = std::chrono::steady_clock::now() - registro().inicio;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(decorrido).count();
+}
+
+void rastreio::registrar(const char *nome, int64_t argumento, uint64_t inicio_ns, uint64_t fim_ns)
+{
+    BufferThread &b = buffer_local();
+
+    uint64_t i = b.escritos.load(std::memory_order_relaxed);
+    b.eventos[i & (BufferThread::CAPACIDADE - 1)] = {nome, argumento, inicio_ns, fim_ns};
+    b.escritos.store(i + 1, std::memory_order_release);
+}
+
+void rastreio::nomear_thread(const std::string &nome)
+{
+    BufferThread &b = buffer_local();
+
+    std::lock_guard<std::mutex> lock(registro().trava);
+    b.nome = nome;
+}
+
+bool rastreio::salvar(const std::string &caminho)
+{
+    FILE *arquivo = std::fopen(caminho.c_str(), "w");
+    if (!arquivo)
+        return false;
+
+    Registro &r = registro();
+    std::lock_guard<std::mutex> lock(r.trava);
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", arquivo);
+    std::fputs("{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"rede_neural\"}}", arquivo);
+
+    for (const auto &b : r.buffers)
+    {
+        std::fprintf(arquivo, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", b->id);
+        escrever_texto(arquivo, b->nome);
+        std::fputs("}}", arquivo);
+
+        // Só os últimos CAPACIDADE eventos ainda estão no buffer
+        uint64_t fim = b->escritos.load(std::memory_order_acquire);
+        uint64_t inicio = fim > BufferThread::CAPACIDADE ? fim - BufferThread::CAPACIDADE : 0;
+        if (inicio < b->descartados)
+            inicio = b->descartados;
+
+        for (uint64_t i = inicio; i < fim; i++)
+        {
+            const Evento &e = b->eventos[i & (BufferThread::CAPACIDADE - 1)];
+
+            // Duração completa ("X"), em microssegundos
+            std::fputs(",\n{\"ph\":\"X\",\"pid\":1,", arquivo);
+            std::fprintf(arquivo, "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", b->id,
+                         e.inicio / 1e3, (e.fim - e.inicio) / 1e3);
+            escrever_texto(arquivo, e.nome);
+
+            if (e.argumento >= 0)
+                std::fprintf(arquivo, ",\"args\":{\"i\":%lld}", static_cast<long long>(e.argumento));
+
+            std::fputc('}', arquivo);
+        }
+    }
+
+    std::fputs("\n]}\n", arquivo);
+
+    bool ok = !std::ferror(arquivo);
+    return std::fclose(arquivo) == 0 && ok;
+}
+
+void rastreio::limpar()
+{
+    Registro &r = registro();
+    std::lock_guard<std::mutex> lock(r.trava);
+
+    for (auto &b : r.buffers)
+        b->descartados = b->escritos.load(std::memory_order_acquire);
+}
@@ -1,9 +1,12 @@
 #include "rede_neural.h"
+#include "convolucao.h"
 
 #include <fstream>
 #include <vector>
 #include <iostream>
 #include <random>
+#include <memory>
+#include <string>
 
 using namespace std;
 
@@ -13,8 +16,15 @@ const char* images_file_path = "data/dataset/train-images.idx3-ubyte";
 const int numero_imagens  = 60000;
 const int tamanho_imagem = 28 * 28;
 
-int main()
+/*
+Uso:
+  ./rec_nums         rede densa {784, 32, 32, 10} -> data/models/number_rec_model.txt
+  ./rec_nums --cnn   rede convolucional            -> data/models/number_rec_cnn.txt
+*/
+int main(int argc, char** argv)
 {
+    bool convolucional = argc > 1 && string(argv[1]) == "--cnn";
+
     ifstream labels_file (labels_file_path, ios::binary);
     ifstream images_file (images_file_path, ios::binary);
 
@@ -65,56 +75,41 @@ int main()
 
     cout << "Leitura concluída!" << endl << endl;
 
-    cout << "Embaralhando imagens..." << endl;
+    // Embaralha e separa só os índices: as imagens ficam onde foram lidas
+    nn::VisaoDados todos = nn::VisaoDados(todas_imagens, todos_rotulos).permutada(random_device{}());
 
-    vector<int> indices(numero_imagens);
-    iota(indices.begin(), indices.end(), 0);
+    size_t n_validacao = numero_imagens * 0.2;
+    nn::VisaoDados validacao = todos.fatia(0, n_validacao);
+    nn::VisaoDados treino = todos.fatia(n_validacao, todos.tamanho());
 
-    random_device rd;
-    mt19937 g(rd());
-    shuffle(indices.begin(), indices.end(), g);
+    unique_ptr<nn::Sequencial> numbr_rec;
 
-    vector<vector<double>> imagens_embaralhadas;
-    vector<vector<double>> rotulos_embaralhados;
-    imagens_embaralhadas.reserve(numero_imagens);
-    rotulos_embaralhados.reserve(numero_imagens);
-    
-    for (int i : indices)
+    if (convolucional)
     {
-        imagens_embaralhadas.push_back(todas_imagens[i]);
-        rotulos_embaralhados.push_back(todos_rotulos[i]);
+        // 1x28x28 -> 8x26x26 -> 8x13x13 -> 16x11x11 -> 16x5x5 -> 400 -> 32 -> 10
+        vector<unique_ptr<nn::CamadaImagem>> extrator;
+        extrator.push_back(make_unique<nn::Conv2D>(8, 3));
+        extrator.push_back(make_unique<nn::MaxPool2D>(2));
+        extrator.push_back(make_unique<nn::Conv2D>(16, 3));
+        extrator.push_back(make_unique<nn::MaxPool2D>(2));
+        extrator.push_back(make_unique<nn::Flatten>());
+
+        numbr_rec = make_unique<nn::Sequencial>(nn::Formato3D{1, 28, 28}, std::move(extrator),
+                                                vector<size_t>{32, 10}, "SCE", nn::ReLU);
     }
-
-    todas_imagens = imagens_embaralhadas;
-    todos_rotulos = rotulos_embaralhados;
-
-    imagens_embaralhadas.clear();
-    rotulos_embaralhados.clear();
-
-    cout << "Embaralhamento concluído!" << endl << endl;
-
-    nn::Matriz entradas_treino, saidas_treino, entradas_validacao, saidas_validacao;
-
-    // separando os dados em entradas de treino e entradas de validação
-    for (int i = 0; i < numero_imagens * 0.2; ++i)
-    {
-        entradas_validacao.push_back(todas_imagens[i]);
-        saidas_validacao.push_back(todos_rotulos[i]);
-    }
-    
-    for (size_t i = entradas_validacao.size(); i < numero_imagens; ++i)
+    else
     {
-        entradas_treino.push_back(todas_imagens[i]);
-        saidas_treino.push_back(todos_rotulos[i]);
+        numbr_rec = make_unique<nn::Sequencial>(vector<size_t>{tamanho_imagem, 32, 32, 10}, "SCE", nn::ReLU);
     }
 
-    todas_imagens.clear();
-    todos_rotulos.clear();
-
-    nn::Sequencial numbr_rec({tamanho_imagem, 32, 32, 10}, "SCE", nn::ReLU);
+    nn::ConfigTreino config;
+    config.taxa_aprendizagem = 0.001;
+    config.janela_analise = 10;
+    config.target_loss = 0.2;
+    config.threshold = 1e-5;
 
-    numbr_rec.train(entradas_treino, saidas_treino, entradas_validacao, saidas_validacao, 0.001, 10, 0.2, 1e-5);
-    numbr_rec.salvar_rede("data/models/number_rec_model.txt");
+    numbr_rec->train(treino, validacao, config);
+    numbr_rec->salvar_rede(convolucional ? "data/models/number_rec_cnn.txt" : "data/models/number_rec_model.txt");
 
     return 0;
 }
\ No newline at end of file
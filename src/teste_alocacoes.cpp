@@ -0,0 +1,180 @@
+#include "rede_neural.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+Teste: depois do aquecimento, feed_forward e train_step não alocam memória
+(com pesos em double e em BF16, e no pipeline), e as épocas do train não
+alocam nada por amostra.
+
+Substitui o operator new global por um que conta as chamadas enquanto
+'contando' está ligado. A primeira chamada de cada caminho aloca a área de
+trabalho, os gradientes e os momentos do Adam; as seguintes devem reusar
+tudo. Retorna 1 (falha no ctest) se algum caminho falhar.
+*/
+
+namespace
+{
+    atomic<bool> contando{false};
+    atomic<size_t> alocacoes{0};
+
+    // Fora de linha: inlinado nos delete, o GCC avisa (falsamente) que o
+    // free recebe um ponteiro do operator new
+    [[gnu::noinline]] void liberar(void *p) noexcept
+    {
+        free(p);
+    }
+}
+
+void *operator new(size_t tamanho)
+{
+    if (contando.load(memory_order_relaxed))
+        alocacoes.fetch_add(1, memory_order_relaxed);
+
+    if (void *p = malloc(tamanho ? tamanho : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void *operator new[](size_t tamanho)
+{
+    return operator new(tamanho);
+}
+
+void operator delete(void *p) noexcept
+{
+    liberar(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    liberar(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    liberar(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    liberar(p);
+}
+
+// Alocações feitas por 'fn' repetida 'vezes' vezes
+template <typename F>
+size_t contar(size_t vezes, const F &fn)
+{
+    alocacoes = 0;
+    contando = true;
+    for (size_t i = 0; i < vezes; i++)
+        fn();
+    contando = false;
+    return alocacoes;
+}
+
+// Mostra as alocações do caminho e retorna se ele passou (nenhuma)
+bool verificar(const char *caminho, size_t n)
+{
+    cout << "alocações " << caminho << ": " << n << endl;
+    return n == 0;
+}
+
+// feed_forward e train_step de uma rede já configurada
+bool verificar_rede(const char *nome, nn::Sequencial &rede, const vector<nn::Vetor> &entradas,
+                    const vector<nn::Vetor> &saidas)
+{
+    // Aquecimento: aloca a área de trabalho e o estado do treino
+    rede.feed_forward(entradas[0]);
+    rede.train_step(entradas, saidas, 1e-3);
+
+    size_t no_forward = contar(100, [&]() { rede.feed_forward(entradas[0]); });
+    size_t no_treino = contar(100, [&]() { rede.train_step(entradas, saidas, 1e-3); });
+
+    string caminho = nome;
+    bool ok = verificar((caminho + " no feed_forward").c_str(), no_forward);
+    return verificar((caminho + " no train_step").c_str(), no_treino) && ok;
+}
+
+/*
+Uma época de train com as primeiras 'n' amostras e com 4 * n. O train aloca
+um pouco por chamada (a ordem embaralhada, a cópia dos melhores pesos, as
+áreas do calc_loss da validação), mas nada por amostra: as duas contagens
+devem ser iguais.
+*/
+bool verificar_train(const char *nome, nn::Sequencial &rede, const nn::VisaoDados &dados, size_t n)
+{
+    nn::ConfigTreino config;
+    config.max_epocas = 1;
+    config.verbose = false;
+    config.semente = 42;
+
+    nn::VisaoDados validacao = dados.fatia(0, n);
+    auto epoca = [&](size_t amostras) { rede.train(dados.fatia(0, amostras), validacao, config); };
+
+    // Aquecimento
+    epoca(4 * n);
+
+    size_t com_n = contar(1, [&]() { epoca(n); });
+    size_t com_4n = contar(1, [&]() { epoca(4 * n); });
+
+    cout << "alocações " << nome << " no train: " << com_n << " (" << n << " amostras), " << com_4n << " ("
+         << 4 * n << " amostras)" << endl;
+    return com_n == com_4n;
+}
+
+int main()
+{
+    mt19937 gerador(42);
+    uniform_real_distribution<double> distribuicao(-1.0, 1.0);
+
+    const size_t n_amostras = 128, tamanho_lote = 8;
+    vector<nn::Vetor> todas_entradas(n_amostras, nn::Vetor(16));
+    vector<nn::Vetor> todas_saidas(n_amostras, nn::Vetor(4, 0.0));
+    for (size_t s = 0; s < n_amostras; s++)
+    {
+        for (double &x : todas_entradas[s])
+            x = distribuicao(gerador);
+        todas_saidas[s][s % 4] = 1.0;
+    }
+
+    nn::VisaoDados dados(todas_entradas, todas_saidas);
+    vector<nn::Vetor> entradas(todas_entradas.begin(), todas_entradas.begin() + tamanho_lote);
+    vector<nn::Vetor> saidas(todas_saidas.begin(), todas_saidas.begin() + tamanho_lote);
+
+    bool ok = true;
+
+    nn::Sequencial rede({16, 32, 16, 4}, "SCE", nn::ReLU);
+    ok &= verificar_rede("(double)", rede, entradas, saidas);
+
+    // Pesos em 16 bits: o otimizador refaz a cópia em BF16 a cada passo
+    nn::Sequencial rede_bf16({16, 32, 16, 4}, "SCE", nn::ReLU);
+    rede_bf16.set_precisao_pesos(nn::PrecisaoPesos::BF16);
+    ok &= verificar_rede("(BF16)", rede_bf16, entradas, saidas);
+
+    // Pipeline: cada amostra do lote na sua área, em 4 micro-lotes
+    nn::Sequencial rede_pipeline({16, 32, 16, 4}, "SCE", nn::ReLU);
+    rede_pipeline.configurar_pipeline(tamanho_lote, 4);
+    ok &= verificar_rede("(pipeline)", rede_pipeline, entradas, saidas);
+
+    // Épocas amostra por amostra, em lotes, em pipeline e com pesos em BF16
+    nn::Sequencial por_amostra({16, 32, 16, 4}, "SCE", nn::ReLU);
+    ok &= verificar_train("(amostra por amostra)", por_amostra, dados, n_amostras / 4);
+
+    nn::Sequencial em_lotes({16, 32, 16, 4}, "SCE", nn::ReLU);
+    em_lotes.configurar_pipeline(tamanho_lote, 1);
+    ok &= verificar_train("(lotes)", em_lotes, dados, n_amostras / 4);
+
+    ok &= verificar_train("(pipeline)", rede_pipeline, dados, n_amostras / 4);
+    ok &= verificar_train("(BF16)", rede_bf16, dados, n_amostras / 4);
+
+    return ok ? 0 : 1;
+}
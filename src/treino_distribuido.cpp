@@ -0,0 +1,116 @@
+#include "rede_neural.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+/*
+Treino distribuído de um classificador "dentro/fora do círculo".
+
+Uso:
+  ./treino_distribuido [n_processos] [shm|tcp]
+
+Sem NN_RANK no ambiente, o programa se lança N vezes nesta máquina (memória
+compartilhada ou TCP pelo loopback). Para várias máquinas, rode um processo
+em cada uma com NN_RANK, NN_N_PROCESSOS, NN_TRANSPORTE=tcp e NN_ENDERECOS.
+*/
+
+const int numero_amostras = 8000;
+
+int lancar_processos(const char *programa, int n_processos, const string &transporte)
+{
+    string enderecos;
+    for (int i = 0; i < n_processos; i++)
+        enderecos += (i ? "," : "") + string("127.0.0.1:") + to_string(29500 + i);
+
+    string sessao = "nn_" + to_string(getpid());
+
+    vector<pid_t> filhos;
+    for (int rank = 0; rank < n_processos; rank++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            setenv("NN_RANK", to_string(rank).c_str(), 1);
+            setenv("NN_N_PROCESSOS", to_string(n_processos).c_str(), 1);
+            setenv("NN_TRANSPORTE", transporte.c_str(), 1);
+            setenv("NN_ENDERECOS", enderecos.c_str(), 1);
+            setenv("NN_SESSAO", sessao.c_str(), 1);
+            execl(programa, programa, (char *)nullptr);
+            _exit(127);
+        }
+        filhos.push_back(pid);
+    }
+
+    int falhas = 0;
+    for (pid_t pid : filhos)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) falhas++;
+    }
+
+    if (falhas) cerr << "ERRO: " << falhas << " processo(s) falharam" << endl;
+    return falhas ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (!getenv("NN_RANK"))
+    {
+        int n_processos = argc > 1 ? atoi(argv[1]) : 2;
+        string transporte = argc > 2 ? argv[2] : "shm";
+        return lancar_processos(argv[0], n_processos, transporte);
+    }
+
+    nn::GrupoProcessos grupo(nn::config_do_ambiente());
+
+    // Mesma semente em todos os processos: todos geram o mesmo conjunto e
+    // cada um fica só com a sua fatia
+    mt19937 gen(42);
+    uniform_real_distribution<double> coord(-1.0, 1.0);
+
+    nn::Matriz entradas, saidas;
+    for (int i = 0; i < numero_amostras; i++)
+    {
+        double x = coord(gen), y = coord(gen);
+        bool dentro = x * x + y * y < 0.5;
+        entradas.push_back({x, y});
+        saidas.push_back({dentro ? 1.0 : 0.0, dentro ? 0.0 : 1.0});
+    }
+
+    // 20% para validação, o resto é dividido entre os processos
+    size_t n_validacao = numero_amostras / 5;
+    nn::VisaoDados todos(entradas, saidas);
+    nn::VisaoDados validacao = todos.fatia(0, n_validacao);
+
+    auto [inicio, fim] = nn::fatia_dados(numero_amostras - n_validacao, grupo.get_rank(), grupo.get_n_processos());
+    nn::VisaoDados treino = todos.fatia(n_validacao + inicio, n_validacao + fim);
+
+    nn::Sequencial rede({2, 16, 16, 2}, "SCE", nn::tanh);
+    rede.configurar_pipeline(32);
+    rede.set_grupo_processos(&grupo);
+
+    nn::ConfigTreino config;
+    config.taxa_aprendizagem = 0.01;
+    config.janela_analise = 10;
+    config.target_loss = 0.05;
+    config.threshold = 1e-4;
+
+    rede.train(treino, validacao, config);
+
+    if (grupo.get_rank() == 0)
+    {
+        cout << "PRECISÃO NA VALIDAÇÃO: " << rede.calc_accuracy(validacao) * 100.0 << "%" << endl;
+        rede.salvar_rede("data/circle_distribuido_model.txt");
+    }
+
+    return 0;
+}